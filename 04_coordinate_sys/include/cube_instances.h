@@ -0,0 +1,123 @@
+#ifndef CUBE_INSTANCES_H
+#define CUBE_INSTANCES_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+#include <cmath>
+#include <vector>
+
+// Cubes kept as structure-of-arrays. Model matrices are rebuilt in one tight
+// loop and drawn either with a single glDrawArraysInstanced or, for
+// comparison, with one uniform upload and draw call per cube.
+class CubeInstances {
+    public:
+        std::vector<float> posX;
+        std::vector<float> posY;
+        std::vector<float> posZ;
+        std::vector<float> baseAngle;
+        std::vector<float> angleSpeed;
+        std::vector<glm::mat4> models;
+
+    explicit CubeInstances(glm::vec3 rotationAxis) : axis(glm::normalize(rotationAxis)), instanceVBO(0) {}
+
+    int count() const {
+        return static_cast<int>(posX.size());
+    }
+
+    void clear() {
+        posX.clear();
+        posY.clear();
+        posZ.clear();
+        baseAngle.clear();
+        angleSpeed.clear();
+    }
+
+    void add(glm::vec3 pos, float angle, float speed) {
+        posX.push_back(pos.x);
+        posY.push_back(pos.y);
+        posZ.push_back(pos.z);
+        baseAngle.push_back(angle);
+        angleSpeed.push_back(speed);
+    }
+
+    // Deterministic spread of cubes through a box in front of the camera.
+    void scatter(int n, float extent) {
+        clear();
+        unsigned int seed = 12345u;
+        auto next = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+        };
+
+        for(int i = 0; i < n; i++) {
+            glm::vec3 pos((next() - 0.5f) * extent, (next() - 0.5f) * extent, -next() * extent - 3.f);
+            add(pos, 0.f, 20.f * static_cast<float>(i % 7 + 1));
+        }
+    }
+
+    // Same result as translate(pos) * rotate(angle, axis), written out so the
+    // loop only streams through the arrays.
+    void update(float time) {
+        int n = count();
+        models.resize(n);
+
+        for(int i = 0; i < n; i++) {
+            float a = glm::radians(baseAngle[i] + angleSpeed[i] * time);
+            float c = std::cos(a);
+            float s = std::sin(a);
+            glm::vec3 t = (1.f - c) * axis;
+
+            glm::mat4& m = models[i];
+            m[0] = glm::vec4(c + t.x * axis.x, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y, 0.f);
+            m[1] = glm::vec4(t.y * axis.x - s * axis.z, c + t.y * axis.y, t.y * axis.z + s * axis.x, 0.f);
+            m[2] = glm::vec4(t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, c + t.z * axis.z, 0.f);
+            m[3] = glm::vec4(posX[i], posY[i], posZ[i], 1.f);
+        }
+    }
+
+    // Adds the per-instance mat4 (locations 2-5) to the currently bound VAO.
+    void setupAttributes() {
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+        for(int col = 0; col < 4; col++) {
+            glVertexAttribPointer(2 + col, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(col * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(2 + col);
+            glVertexAttribDivisor(2 + col, 1);
+        }
+    }
+
+    void drawInstanced() const {
+        GLsizeiptr size = static_cast<GLsizeiptr>(models.size() * sizeof(glm::mat4));
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, models.data());
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, count());
+    }
+
+    void drawEach(unsigned int modelLoc, float time) const {
+        for(int i = 0; i < count(); i++) {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(posX[i], posY[i], posZ[i]));
+            model = glm::rotate(model, glm::radians(baseAngle[i] + angleSpeed[i] * time), axis);
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+    }
+
+    void release() {
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    private:
+        glm::vec3 axis;
+        unsigned int instanceVBO;
+};
+
+#endif //CUBE_INSTANCES_H
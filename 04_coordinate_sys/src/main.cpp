@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm.hpp>
@@ -9,6 +10,7 @@
 #include <stb_image.h>
 
 #include "shader.h"
+#include "cube_instances.h"
 
 float vertices[] = {
     -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -64,8 +66,56 @@ glm::vec3 cubePos[] = {
     glm::vec3( 1.3f, -2.0f, -2.5f),
 };
 
-int main()
+// Renders each scene size with both paths and prints the CPU time spent
+// building and submitting one frame.
+void runSweep(GLFWwindow* window, CubeInstances& cubes, const Shader& shader, const Shader& instancedShader, unsigned int modelLoc)
 {
+    const int sizes[] = { 10, 100, 1000, 10000, 100000 };
+    const int frames = 100;
+
+    glfwSwapInterval(0);
+
+    for(int n : sizes)
+    {
+        cubes.scatter(n, 60.f);
+        double cpuMs[2];
+
+        for(int path = 0; path < 2; path++)
+        {
+            double total = 0.0;
+            for(int f = 0; f < frames; f++)
+            {
+                double start = glfwGetTime();
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                if(path == 0)
+                {
+                    shader.use();
+                    cubes.drawEach(modelLoc, (float)start);
+                }
+                else
+                {
+                    instancedShader.use();
+                    cubes.update((float)start);
+                    cubes.drawInstanced();
+                }
+
+                total += glfwGetTime() - start;
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            cpuMs[path] = total * 1000.0 / frames;
+        }
+
+        std::cout << n << " cubes: per-cube " << cpuMs[0] << " ms, instanced " << cpuMs[1] << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool isSweep = argc > 1 && std::string(argv[1]) == "--sweep";
+    bool isClassic = argc > 1 && std::string(argv[1]) == "--classic";
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -98,6 +148,11 @@ int main()
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
 
+    CubeInstances cubes(glm::vec3(0.5f, 1.0f, 0.0f));
+    for(unsigned int i = 0; i < 7; i++)
+        cubes.add(cubePos[i], 0.f, 20.0f * (i + 1));
+    cubes.setupAttributes();
+
     int width, height, nrChannels;
     unsigned char *data = stbi_load("../images/container.jpg", &width, &height, &nrChannels, 0);
 
@@ -150,22 +205,39 @@ int main()
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
+    Shader instancedShader("../src_shader/vertex_instanced", "../src_shader/fragment");
+    instancedShader.use();
+
+    instancedShader.setInt("tex1", 0);
+    instancedShader.setInt("tex2", 1);
+    glUniformMatrix4fv(glGetUniformLocation(instancedShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(instancedShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
     glEnable(GL_DEPTH_TEST);
 
+    if(isSweep)
+    {
+        runSweep(window, cubes, shader, instancedShader, modelLoc);
+        cubes.release();
+        glfwTerminate();
+        return 0;
+    }
+
     while(!glfwWindowShouldClose(window))
     {
         glClearColor(1.f, 1.f, 1.f, 1.f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        for(unsigned int i = 0; i < 7; i++)
+        if(isClassic)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos[i]);
-            float angle = 20.0f * (i + 1);
-            model = glm::rotate(model, (float)glfwGetTime() * glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            shader.use();
+            cubes.drawEach(modelLoc, (float)glfwGetTime());
+        }
+        else
+        {
+            instancedShader.use();
+            cubes.update((float)glfwGetTime());
+            cubes.drawInstanced();
         }
 
         glfwSwapBuffers(window);
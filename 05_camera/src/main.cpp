@@ -5,11 +5,13 @@
 #include <gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #include "shader.h"
+#include "cube_instances.h"
 
 float vertices[] = {
     -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -116,8 +118,56 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     cameraFront = glm::normalize(direction);
 }
 
-int main()
+// Renders each scene size with both paths and prints the CPU time spent
+// building and submitting one frame.
+void runSweep(GLFWwindow* window, CubeInstances& cubes, const Shader& shader, const Shader& instancedShader, unsigned int modelLoc)
 {
+    const int sizes[] = { 10, 100, 1000, 10000, 100000 };
+    const int frames = 100;
+
+    glfwSwapInterval(0);
+
+    for(int n : sizes)
+    {
+        cubes.scatter(n, 60.f);
+        double cpuMs[2];
+
+        for(int path = 0; path < 2; path++)
+        {
+            double total = 0.0;
+            for(int f = 0; f < frames; f++)
+            {
+                double start = glfwGetTime();
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                if(path == 0)
+                {
+                    shader.use();
+                    cubes.drawEach(modelLoc, (float)start);
+                }
+                else
+                {
+                    instancedShader.use();
+                    cubes.update((float)start);
+                    cubes.drawInstanced();
+                }
+
+                total += glfwGetTime() - start;
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            cpuMs[path] = total * 1000.0 / frames;
+        }
+
+        std::cout << n << " cubes: per-cube " << cpuMs[0] << " ms, instanced " << cpuMs[1] << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool isSweep = argc > 1 && std::string(argv[1]) == "--sweep";
+    bool isClassic = argc > 1 && std::string(argv[1]) == "--classic";
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -186,6 +236,10 @@ int main()
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
 
+    CubeInstances cubes(glm::vec3(1.0f, 1.0f, 0.0f));
+    cubes.add(glm::vec3(0.0f), -55.0f, 0.0f);
+    cubes.setupAttributes();
+
     Shader shader("../src_shader/vertex", "../src_shader/fragment");
     shader.use();
 
@@ -205,22 +259,55 @@ int main()
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
     glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
+    Shader instancedShader("../src_shader/vertex_instanced", "../src_shader/fragment");
+    instancedShader.use();
+
+    instancedShader.setInt("tex1", 0);
+    instancedShader.setInt("tex2", 1);
+
+    unsigned int instancedViewLoc = glGetUniformLocation(instancedShader.ID, "view");
+    glUniformMatrix4fv(glGetUniformLocation(instancedShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
     glEnable(GL_DEPTH_TEST);
+
+    if(isSweep)
+    {
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        shader.use();
+        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+        instancedShader.use();
+        glUniformMatrix4fv(instancedViewLoc, 1, GL_FALSE, glm::value_ptr(view));
+
+        runSweep(window, cubes, shader, instancedShader, modelLoc);
+        cubes.release();
+        glfwTerminate();
+        return 0;
+    }
     while(!glfwWindowShouldClose(window))
     {
         glClearColor(1.f, 1.f, 1.f, 1.f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shader.use();
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput(window);
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        if(isClassic)
+        {
+            shader.use();
+            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+            cubes.drawEach(modelLoc, currentFrame);
+        }
+        else
+        {
+            instancedShader.use();
+            glUniformMatrix4fv(instancedViewLoc, 1, GL_FALSE, glm::value_ptr(view));
+            cubes.update(currentFrame);
+            cubes.drawInstanced();
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
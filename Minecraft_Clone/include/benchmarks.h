@@ -0,0 +1,26 @@
+#pragma once
+
+// The --bench-* modes. Each builds its own worlds, prints its timings to
+// stdout and, where there is a reference to compare against, whether the
+// results matched it. Those returning bool fail the run when they return
+// false.
+void runSnapshotBenchmark();
+bool runRegionBenchmark();
+void runJournalBenchmark();
+void runCopyOnWriteBenchmark();
+void runJobBenchmark();
+void runEntityBenchmark();
+void runBroadphaseBenchmark();
+void runPhysicsBenchmark();
+bool runRaycastBenchmark();
+void runVoxelTreeBenchmark();
+void runBlockTickBenchmark();
+void runRandomTickBenchmark();
+void runFluidBenchmark();
+void runWorldEditBenchmark();
+void runEditHistoryBenchmark();
+void runBlockAccessBenchmark();
+void runChunkLayoutBenchmark();
+bool runCullBenchmark();
+void runUploadRingBenchmark();
+void runVertexArenaBenchmark();
@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm.hpp>
+
+// A scheduled update as saved with its chunk: the cell in World::getChunk
+// order and how many ticks are left until it is due.
+struct PendingTick
+{
+    uint32_t cell;
+    uint32_t delay;
+};
+
+// The scheduled ticks of one chunk in a hierarchical timing wheel. Level k
+// has SLOTS slots, each SLOTS^k ticks wide. A tick is filed in the lowest
+// level whose span reaches its due time, and moves down a level whenever the
+// level below comes round to it, so scheduling and each advance are O(1) per
+// tick regardless of how many are pending.
+class TickWheel
+{
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    // About three days at 60 ticks a second; longer delays are cut to this.
+    static constexpr uint32_t MAX_DELAY = (1u << (SLOT_BITS * LEVELS)) - 1;
+
+    // A delay of 0 is treated as 1, the next advance.
+    void schedule(uint32_t cell, uint32_t delay);
+    // Moves one tick on and appends the cells that are now due.
+    void advance(std::vector<uint32_t>& due);
+
+    void getPending(std::vector<PendingTick>& out) const;
+    // Only while empty: sets the wheel's own clock, which is otherwise free
+    // running.
+    void restart(uint32_t tick) { now = tick; }
+    size_t getCount() const { return count; }
+
+private:
+    struct Entry
+    {
+        uint32_t cell;
+        uint32_t due;
+    };
+
+    uint32_t now = 0;
+    size_t count = 0;
+    std::array<std::vector<Entry>, SLOTS * LEVELS> slots;
+
+    void insert(Entry entry);
+    void cascade(int level);
+};
+
+// Block updates requested for a number of ticks ahead, kept per chunk column
+// so a chunk's pending ticks can be saved and restored with its blocks. Only
+// chunks with something pending are advanced each tick.
+class BlockTicks
+{
+public:
+    BlockTicks(int sizeX, int sizeY, int sizeZ);
+
+    const int SIZE_X;
+    const int SIZE_Y;
+    const int SIZE_Z;
+
+    void schedule(int x, int y, int z, uint32_t delay);
+    // One simulation tick: fills due with the cells whose tick has come,
+    // chunk by chunk in a fixed order. Ticks scheduled while handling them
+    // are due on a later advance.
+    void advance(std::vector<glm::ivec3>& due);
+
+    void getPending(int chunkX, int chunkZ, std::vector<PendingTick>& out) const;
+    // Replaces whatever the chunk had pending.
+    void setPending(int chunkX, int chunkZ, const std::vector<PendingTick>& ticks);
+
+    size_t getPendingCount() const;
+    int getActiveChunkCount() const { return static_cast<int>(activeChunks.size()); }
+    long getDispatchedCount() const { return dispatched; }
+
+private:
+    uint32_t tick = 0;
+    int chunksX;
+    // Created the first time a chunk schedules anything.
+    std::vector<std::unique_ptr<TickWheel>> wheels;
+    std::vector<int> activeChunks;
+    std::vector<char> isActive;
+    std::vector<uint32_t> dueCells;
+    long dispatched = 0;
+
+    TickWheel& activate(int chunk);
+};
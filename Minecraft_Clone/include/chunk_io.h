@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "region.h"
+#include "spsc_queue.h"
+#include "world.h"
+
+struct LatencyHistogram
+{
+    // Bucket i counts requests that took less than 2^i ms; the last one is open ended.
+    static constexpr int BUCKETS = 12;
+
+    std::array<int, BUCKETS> counts{};
+    int total = 0;
+    double maxMs = 0.0;
+
+    void record(double ms);
+};
+
+// Owns the only WorldStorage and runs every disk access on its own thread.
+// The main thread queues requests and drains finished ones once per frame.
+class ChunkIO
+{
+public:
+    enum Request_Type {
+        LOAD,
+        SAVE
+    };
+
+    struct Completion
+    {
+        Request_Type type = LOAD;
+        int chunkX = 0;
+        int chunkZ = 0;
+        bool isFound = false;
+        std::vector<int> blocks;
+        std::vector<PendingTick> ticks;
+        double latencyMs = 0.0;
+        std::string error;
+        // Position of the request in submission order, and whether every
+        // region file had been synced to disk when it completed. A sync that
+        // failed leaves its reason in flushError instead.
+        size_t sequence = 0;
+        bool isFlushed = false;
+        std::string flushError;
+    };
+
+    ChunkIO(std::string directory, int chunkHeight);
+    ~ChunkIO();
+
+    void requestLoad(int chunkX, int chunkZ);
+    // A save replacing one that is still queued for the same chunk is merged
+    // into it, keeping the original queue position.
+    void requestSave(int chunkX, int chunkZ, ChunkSnapshot snapshot, std::vector<PendingTick> ticks = {});
+
+    void drainCompletions(const std::function<void(const Completion&)>& handler);
+
+    // Finishes every queued request, then stops the thread. Completions that
+    // arrive meanwhile go to handler if one is given.
+    void shutdown(const std::function<void(const Completion&)>& handler = nullptr);
+
+    int getQueueDepth() const;
+    // Number of requests submitted so far, not counting saves merged into queued ones.
+    size_t getRequestCount() const;
+    int getMaxQueueDepth() const { return maxQueueDepth; }
+    int getCoalescedSaves() const { return coalescedSaves; }
+    const LatencyHistogram& getLoadLatency() const { return loadLatency; }
+    const LatencyHistogram& getSaveLatency() const { return saveLatency; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request
+    {
+        Request_Type type;
+        int chunkX;
+        int chunkZ;
+        ChunkSnapshot snapshot;
+        std::vector<PendingTick> ticks;
+        Clock::time_point queuedAt;
+    };
+
+    WorldStorage storage;
+    int chunkHeight;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    std::map<std::pair<int, int>, size_t> queuedSaves;
+    size_t popped = 0;
+    bool isStopping = false;
+
+    SpscQueue<Completion> completions{ 1024 };
+    std::thread worker;
+
+    int maxQueueDepth = 0;
+    int coalescedSaves = 0;
+    LatencyHistogram loadLatency;
+    LatencyHistogram saveLatency;
+
+    void enqueue(Request request);
+    void run();
+    Completion process(Request& request);
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// How the cells of a chunk follow each other in memory. Linear runs x first,
+// then y, then z, so whole rows of x are contiguous. Morton interleaves the
+// bits of x, y and z (a Z-order curve), so cells that are near each other
+// along any axis are mostly near each other in memory too.
+enum Block_Order {
+    ORDER_LINEAR,
+    ORDER_MORTON
+};
+
+// Index maths for a block array with power-of-two edges. Everything is
+// constexpr on compile-time edges, so indices, neighbour steps and
+// coordinate conversions come down to shifts and masks, plus bit deposits
+// and extracts for Morton order: BMI2 pdep and pext where the target has
+// them, small lookup tables otherwise.
+template<int SizeX, int SizeY, int SizeZ, Block_Order Order = ORDER_LINEAR>
+struct ChunkLayout
+{
+    static_assert(std::has_single_bit(static_cast<unsigned>(SizeX)) && std::has_single_bit(static_cast<unsigned>(SizeY)) &&
+                  std::has_single_bit(static_cast<unsigned>(SizeZ)), "Chunk edges must be powers of two");
+
+    static constexpr int SIZE_X = SizeX;
+    static constexpr int SIZE_Y = SizeY;
+    static constexpr int SIZE_Z = SizeZ;
+    static constexpr int SHIFT_X = std::countr_zero(static_cast<unsigned>(SizeX));
+    static constexpr int SHIFT_Y = std::countr_zero(static_cast<unsigned>(SizeY));
+    static constexpr int SHIFT_Z = std::countr_zero(static_cast<unsigned>(SizeZ));
+    static constexpr int VOLUME = SizeX * SizeY * SizeZ;
+    static constexpr Block_Order ORDER = Order;
+
+    static_assert(Order == ORDER_LINEAR || (SHIFT_X <= 10 && SHIFT_Y <= 10 && SHIFT_Z <= 10), "Morton chunks are at most 1024 across");
+
+    // Index bits of each axis in Morton order: x, y and z take turns from
+    // the lowest bit up, and an axis that runs out of bits drops out.
+    static constexpr uint32_t getLaneMask(int axis)
+    {
+        const int shifts[3] = { SHIFT_X, SHIFT_Y, SHIFT_Z };
+        int used[3] = { 0, 0, 0 };
+        uint32_t mask = 0;
+        int bit = 0;
+        while (bit < SHIFT_X + SHIFT_Y + SHIFT_Z)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                if (used[a] == shifts[a])
+                    continue;
+                if (a == axis)
+                    mask |= 1u << bit;
+                used[a]++;
+                bit++;
+            }
+        }
+        return mask;
+    }
+    static constexpr uint32_t MASK_X = getLaneMask(0);
+    static constexpr uint32_t MASK_Y = getLaneMask(1);
+    static constexpr uint32_t MASK_Z = getLaneMask(2);
+
+    // For cells inside the chunk.
+    static constexpr int getIndex(int x, int y, int z)
+    {
+        if constexpr (Order == ORDER_MORTON)
+        {
+#ifdef __BMI2__
+            if (!std::is_constant_evaluated())
+                return static_cast<int>(_pdep_u32(static_cast<uint32_t>(x), MASK_X) | _pdep_u32(static_cast<uint32_t>(y), MASK_Y) |
+                                        _pdep_u32(static_cast<uint32_t>(z), MASK_Z));
+#endif
+            return static_cast<int>(SPREAD_X[x] | SPREAD_Y[y] | SPREAD_Z[z]);
+        }
+        else
+        {
+            return x | (y << SHIFT_X) | (z << (SHIFT_X + SHIFT_Y));
+        }
+    }
+    static constexpr int getX(int index)
+    {
+        if constexpr (Order == ORDER_MORTON)
+            return static_cast<int>(compact<0>(static_cast<uint32_t>(index)));
+        else
+            return index & (SizeX - 1);
+    }
+    static constexpr int getY(int index)
+    {
+        if constexpr (Order == ORDER_MORTON)
+            return static_cast<int>(compact<1>(static_cast<uint32_t>(index)));
+        else
+            return (index >> SHIFT_X) & (SizeY - 1);
+    }
+    static constexpr int getZ(int index)
+    {
+        if constexpr (Order == ORDER_MORTON)
+            return static_cast<int>(compact<2>(static_cast<uint32_t>(index)));
+        else
+            return index >> (SHIFT_X + SHIFT_Y);
+    }
+
+    // Any coordinates: the chunk a block is in and where, rounding towards
+    // negative infinity, and back again.
+    static constexpr int toLocalX(int x) { return x & (SizeX - 1); }
+    static constexpr int toLocalY(int y) { return y & (SizeY - 1); }
+    static constexpr int toLocalZ(int z) { return z & (SizeZ - 1); }
+    static constexpr int toChunkX(int x) { return x >> SHIFT_X; }
+    static constexpr int toChunkY(int y) { return y >> SHIFT_Y; }
+    static constexpr int toChunkZ(int z) { return z >> SHIFT_Z; }
+    static constexpr int toGlobalX(int chunk, int local) { return (chunk << SHIFT_X) | local; }
+    static constexpr int toGlobalY(int chunk, int local) { return (chunk << SHIFT_Y) | local; }
+    static constexpr int toGlobalZ(int chunk, int local) { return (chunk << SHIFT_Z) | local; }
+
+    static constexpr bool isInside(int x, int y, int z)
+    {
+        return static_cast<unsigned>(x) < static_cast<unsigned>(SizeX) && static_cast<unsigned>(y) < static_cast<unsigned>(SizeY) &&
+               static_cast<unsigned>(z) < static_cast<unsigned>(SizeZ);
+    }
+
+    // What to add to an index to reach the cell DX, DY, DZ away, when that
+    // cell is in the same chunk. Linear order only.
+    template<int DX, int DY, int DZ>
+        requires(Order == ORDER_LINEAR)
+    static constexpr int NEIGHBOUR_OFFSET = DX + DY * SizeX + DZ * SizeX * SizeY;
+
+    // The index of the cell DX, DY, DZ away, when that cell is in the same
+    // chunk. In Morton order each axis is stepped on its own bits: filling
+    // the other bits with ones carries the add straight across them.
+    template<int DX, int DY, int DZ>
+    static constexpr int getNeighbourIndex(int index)
+    {
+        if constexpr (Order == ORDER_MORTON)
+        {
+            uint32_t i = static_cast<uint32_t>(index);
+            i = stepLane(i, MASK_X, deposit(static_cast<uint32_t>(DX & (SizeX - 1)), MASK_X));
+            i = stepLane(i, MASK_Y, deposit(static_cast<uint32_t>(DY & (SizeY - 1)), MASK_Y));
+            i = stepLane(i, MASK_Z, deposit(static_cast<uint32_t>(DZ & (SizeZ - 1)), MASK_Z));
+            return static_cast<int>(i);
+        }
+        else
+        {
+            return index + NEIGHBOUR_OFFSET<DX, DY, DZ>;
+        }
+    }
+
+private:
+    // Software pdep and pext, for building the tables.
+    static constexpr uint32_t deposit(uint32_t value, uint32_t mask)
+    {
+        uint32_t result = 0;
+        for (uint32_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1)
+            if (value & bit)
+                result |= mask & (~mask + 1);
+        return result;
+    }
+    static constexpr uint32_t extract(uint32_t value, uint32_t mask)
+    {
+        uint32_t result = 0;
+        for (uint32_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1)
+            if (value & mask & (~mask + 1))
+                result |= bit;
+        return result;
+    }
+
+    static constexpr uint32_t stepLane(uint32_t index, uint32_t mask, uint32_t step)
+    {
+        if (step == 0)
+            return index;
+        return (((index | ~mask) + step) & mask) | (index & ~mask);
+    }
+
+    template<int Size>
+    static constexpr std::array<uint32_t, Size> makeSpread(uint32_t mask)
+    {
+        std::array<uint32_t, Size> table{};
+        for (int v = 0; v < Size; v++)
+            table[v] = deposit(static_cast<uint32_t>(v), mask);
+        return table;
+    }
+    static constexpr std::array<uint32_t, SizeX> SPREAD_X = makeSpread<SizeX>(MASK_X);
+    static constexpr std::array<uint32_t, SizeY> SPREAD_Y = makeSpread<SizeY>(MASK_Y);
+    static constexpr std::array<uint32_t, SizeZ> SPREAD_Z = makeSpread<SizeZ>(MASK_Z);
+
+    // For each byte of an index, x, y and z packed 10 bits apart.
+    static constexpr int INDEX_BYTES = (SHIFT_X + SHIFT_Y + SHIFT_Z + 7) / 8;
+    static constexpr std::array<std::array<uint32_t, 256>, INDEX_BYTES> makeCompact()
+    {
+        std::array<std::array<uint32_t, 256>, INDEX_BYTES> table{};
+        for (int b = 0; b < INDEX_BYTES; b++)
+        {
+            for (uint32_t v = 0; v < 256; v++)
+            {
+                uint32_t index = v << (b * 8);
+                table[b][v] = extract(index, MASK_X) | extract(index, MASK_Y) << 10 | extract(index, MASK_Z) << 20;
+            }
+        }
+        return table;
+    }
+    static constexpr auto COMPACT = makeCompact();
+
+    template<int Axis>
+    static constexpr uint32_t compact(uint32_t index)
+    {
+#ifdef __BMI2__
+        if (!std::is_constant_evaluated())
+            return _pext_u32(index, Axis == 0 ? MASK_X : Axis == 1 ? MASK_Y : MASK_Z);
+#endif
+        uint32_t packed = 0;
+        for (int b = 0; b < INDEX_BYTES; b++)
+            packed |= COMPACT[b][(index >> (b * 8)) & 0xFF];
+        return (packed >> (Axis * 10)) & 1023;
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <future>
+#include <vector>
+#include <glm.hpp>
+
+#include "mesher.h"
+#include "vertex_arena.h"
+#include "upload_ring.h"
+#include "job_system.h"
+
+class World;
+class OcclusionCuller;
+
+class ChunkRenderer
+{
+public:
+    static constexpr int LOD_LEVELS = 4;
+    static constexpr int INITIAL_ARENA_VERTICES = 1 << 16;
+    static constexpr size_t STAGING_BYTES = 2 << 20;
+    static constexpr size_t UPLOAD_BUDGET_BYTES = 1 << 20;
+
+    ChunkRenderer(const World& world, JobSystem& jobs);
+
+    // Chunks farther than lodDistances[i] (horizontal, in blocks) use lod i + 1.
+    void setLodDistances(float lod1, float lod2, float lod3);
+
+    void markDirty(int x, int z);
+    // Whole column replaced: remesh it and the neighbours that border it.
+    void markChunkDirty(int chunkX, int chunkZ);
+
+    // Starts rebuilds for edited chunks and chunks that crossed a lod band,
+    // and uploads meshes whose background build has finished.
+    void update(glm::vec3 cameraPos);
+    void draw(const OcclusionCuller& culler, const unsigned int texture[FACE_TEXTURE_COUNT]);
+
+    // GL objects must be freed while the context is still alive.
+    void release();
+
+    const std::array<int, LOD_LEVELS>& getTrianglesPerLod() const { return trianglesPerLod; }
+    const std::array<int, LOD_LEVELS>& getChunksPerLod() const { return chunksPerLod; }
+    const VertexArena& getArena() const { return arena; }
+    const UploadRing& getUploadRing() const { return uploadRing; }
+    void setUploadBudget(size_t bytes) { uploadRing.setFrameBudget(bytes); }
+
+private:
+    struct Chunk
+    {
+        int handle = VertexArena::INVALID_HANDLE;
+        int first[FACE_TEXTURE_COUNT]{};
+        int count[FACE_TEXTURE_COUNT]{};
+        int triangles = 0;
+        int lod = -1;
+        bool isDirty = true;
+        bool hasReadyMesh = false;
+        ChunkMesh readyMesh;
+        std::future<ChunkMesh> pending;
+    };
+
+    const World& world;
+    JobSystem& jobs;
+    int chunksX;
+    int chunksZ;
+    std::vector<Chunk> chunks;
+
+    // All chunk meshes share one VAO/VBO and are drawn with one
+    // glMultiDrawArrays per texture.
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    VertexArena arena{ INITIAL_ARENA_VERTICES };
+    // Holds a block that defragmenting slides over its own old range.
+    unsigned int moveVBO = 0;
+    int moveCapacity = 0;
+    std::vector<int> drawFirsts;
+    std::vector<int> drawCounts;
+
+    GLUploadBackend uploadBackend;
+    UploadRing uploadRing{ uploadBackend, STAGING_BYTES, UPLOAD_BUDGET_BYTES };
+    std::vector<float> uploadScratch;
+
+    std::array<float, LOD_LEVELS - 1> lodDistances{ 24.f, 48.f, 96.f };
+    std::array<int, LOD_LEVELS> trianglesPerLod{};
+    std::array<int, LOD_LEVELS> chunksPerLod{};
+
+    int selectLod(int chunkX, int chunkZ, glm::vec3 cameraPos) const;
+    bool upload(Chunk& chunk, const ChunkMesh& mesh);
+    void createBuffer();
+    int allocateVertices(int size);
+    void applyMoves(const std::vector<VertexArena::Move>& moves);
+    void resizeBuffer(int newCapacity);
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+
+// Consecutive chunk-local block indices that all went from oldBlock to
+// newBlock in the same edit, and how many single changes of the same chunk
+// were recorded before it.
+struct EditRun
+{
+    uint32_t start;
+    uint32_t length;
+    int32_t oldBlock;
+    int32_t newBlock;
+    uint32_t cellsBefore;
+};
+
+struct EditPair
+{
+    int32_t oldBlock;
+    int32_t newBlock;
+};
+
+// Undo and redo for edits grouped into steps. A step keeps, per chunk
+// column it touched, a log of changes rather than a copy of the blocks.
+// Two or more neighbouring blocks that changed alike make a run, so a box
+// fill costs a few runs per row or column. A block changed on its own takes
+// three bytes: its 16-bit chunk-local index and which entry of the chunk's
+// palette of (old, new) pairs it took. Undoing walks a chunk's changes
+// backwards, redoing walks them forwards, and each chunk is written once
+// through World::editChunks.
+//
+// When the history grows past its memory cap the oldest steps are dropped.
+class EditHistory
+{
+public:
+    static constexpr size_t DEFAULT_MAX_BYTES = 64u << 20;
+
+    explicit EditHistory(int sizeY, size_t maxBytes = DEFAULT_MAX_BYTES)
+        : SIZE_Y(sizeY), maxBytes(maxBytes), isSparse(World::getColumnVolume(sizeY) <= 65536) {}
+
+    const int SIZE_Y;
+
+    // Edits recorded between the outermost begin and end make one step.
+    // Recording a new step drops everything that was undone.
+    void beginStep();
+    void endStep();
+    bool isRecording() const { return depth > 0; }
+
+    // Ignored unless a step is being recorded.
+    void record(int x, int y, int z, int oldBlock, int newBlock);
+    // Records a chunk column edited in place. before and after are the whole
+    // chunk before and after the edit; only the rows minY to maxY are compared.
+    void recordChunk(int chunkX, int chunkZ, const int* before, const int* after, int minY, int maxY);
+
+    // Reverts the newest applied step, or applies again the oldest undone
+    // one, listing each chunk column written in touched. False when there is
+    // nothing to undo or redo.
+    bool undo(World& world, std::vector<glm::ivec2>& touched);
+    bool redo(World& world, std::vector<glm::ivec2>& touched);
+
+    // Calls visit(x, y, z, from, to) for every block the last undo or redo
+    // wrote, in the order it wrote them.
+    template<typename Visit>
+    void forEachLastChange(Visit visit) const;
+
+    void setMaxBytes(size_t bytes);
+    size_t getMaxBytes() const { return maxBytes; }
+    size_t getBytes() const { return bytes; }
+    size_t getStepCount() const { return steps.size(); }
+    size_t getUndoneCount() const { return steps.size() - applied; }
+    size_t getEvictedCount() const { return evicted; }
+
+private:
+    struct ChunkDiff
+    {
+        int chunkX;
+        int chunkZ;
+        int minY;
+        int maxY;
+        std::vector<EditRun> runs;
+        std::vector<uint16_t> cells;
+        std::vector<uint8_t> cellPairs;
+        std::vector<EditPair> pairs;
+    };
+
+    struct Step
+    {
+        std::vector<ChunkDiff> chunks;
+        size_t bytes = 0;
+    };
+
+    size_t maxBytes;
+    // Columns taller than 256 blocks have indices past 16 bits, so every
+    // change there is a run.
+    const bool isSparse;
+    size_t bytes = 0;
+    size_t evicted = 0;
+    int depth = 0;
+    // Steps before applied are in the world, the rest have been undone.
+    std::deque<Step> steps;
+    size_t applied = 0;
+    Step recording;
+    // The step the last undo or redo wrote, and which way.
+    const Step* lastStep = nullptr;
+    bool wasUndo = false;
+
+    ChunkDiff& getDiff(int chunkX, int chunkZ);
+    void addRun(ChunkDiff& diff, uint32_t start, uint32_t length, int oldBlock, int newBlock);
+    // Calls fill(start, length, from, to) for each run and single change of
+    // a diff, in the order undoing or redoing writes them.
+    template<typename Fill>
+    static void forEachChange(const ChunkDiff& diff, bool isUndo, Fill fill);
+    void write(World& world, const Step& step, bool isUndo, std::vector<glm::ivec2>& touched);
+    void evict();
+    static size_t getStepBytes(const Step& step);
+};
+
+template<typename Fill>
+void EditHistory::forEachChange(const ChunkDiff& diff, bool isUndo, Fill fill)
+{
+    if (isUndo)
+    {
+        size_t c = diff.cells.size();
+        for (auto run = diff.runs.rbegin(); run != diff.runs.rend(); ++run)
+        {
+            for (; c > run->cellsBefore; c--)
+            {
+                const EditPair& pair = diff.pairs[diff.cellPairs[c - 1]];
+                fill(diff.cells[c - 1], 1u, pair.newBlock, pair.oldBlock);
+            }
+            fill(run->start, run->length, run->newBlock, run->oldBlock);
+        }
+        for (; c > 0; c--)
+        {
+            const EditPair& pair = diff.pairs[diff.cellPairs[c - 1]];
+            fill(diff.cells[c - 1], 1u, pair.newBlock, pair.oldBlock);
+        }
+    }
+    else
+    {
+        size_t c = 0;
+        for (const EditRun& run : diff.runs)
+        {
+            for (; c < run.cellsBefore; c++)
+            {
+                const EditPair& pair = diff.pairs[diff.cellPairs[c]];
+                fill(diff.cells[c], 1u, pair.oldBlock, pair.newBlock);
+            }
+            fill(run.start, run.length, run.oldBlock, run.newBlock);
+        }
+        for (; c < diff.cells.size(); c++)
+        {
+            const EditPair& pair = diff.pairs[diff.cellPairs[c]];
+            fill(diff.cells[c], 1u, pair.oldBlock, pair.newBlock);
+        }
+    }
+}
+
+template<typename Visit>
+void EditHistory::forEachLastChange(Visit visit) const
+{
+    if (lastStep == nullptr)
+        return;
+
+    const int size = World::CHUNK_SIZE;
+    for (size_t c = 0; c < lastStep->chunks.size(); c++)
+    {
+        const ChunkDiff& diff = lastStep->chunks[wasUndo ? lastStep->chunks.size() - 1 - c : c];
+        forEachChange(diff, wasUndo, [&](uint32_t start, uint32_t length, int from, int to) {
+            for (uint32_t i = start; i < start + length; i++)
+            {
+                int x = diff.chunkX * size + World::getColumnX(static_cast<int>(i));
+                int y = World::getColumnY(static_cast<int>(i), SIZE_Y);
+                int z = diff.chunkZ * size + World::getColumnZ(static_cast<int>(i), SIZE_Y);
+                visit(x, y, z, from, to);
+            }
+        });
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BlockEdit
+{
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    int32_t oldId;
+    int32_t newId;
+    uint32_t tick;
+    uint32_t check;
+};
+
+struct ReplayStats
+{
+    int segments = 0;
+    size_t edits = 0;
+    // Records after a torn or corrupt tail, which a crash mid-write leaves behind.
+    size_t discarded = 0;
+    double seconds = 0.0;
+};
+
+// Append-only log of block edits, split into numbered segment files. Edits
+// are buffered and written by a background thread that commits everything
+// gathered during one interval with a single fsync. Once the chunks they
+// touched are safely in the region files, whole segments are retired.
+class EditJournal
+{
+public:
+    static constexpr uint32_t MAGIC = 0x4C4A434D; // "MCJL"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int COMMIT_INTERVAL_MS = 20;
+
+    explicit EditJournal(std::string directory);
+    ~EditJournal();
+
+    // Replays every segment left over from earlier runs, oldest first.
+    ReplayStats replay(const std::function<void(const BlockEdit&)>& handler) const;
+
+    void append(int x, int y, int z, int oldId, int newId, uint32_t tick);
+    // Blocks until everything appended so far is on disk. False when the
+    // write or sync failed, in which case the segment is cut back to its
+    // last commit and the edits stay pending for the next one.
+    bool sync();
+
+    // Commits pending edits, then starts a new segment. Returns the number of
+    // the segment that was closed; all edits made before the call are in it
+    // or in an older one. When the commit fails nothing is closed and the
+    // segment before the open one is returned.
+    int rotate();
+    // Deletes the given segment and every older one.
+    void retire(int segment);
+
+    void close();
+
+    size_t getCommittedEdits() const { return committedEdits; }
+    int getCommits() const { return commits; }
+    int getLargestBatch() const { return largestBatch; }
+    int getFailedCommits() const { return failedCommits; }
+
+private:
+    std::string directory;
+    int fd = -1;
+    int segment = 0;
+
+    // fileMutex is held for a whole commit so batches reach the file in the
+    // order they were appended, even across a rotate.
+    std::mutex fileMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<BlockEdit> pending;
+    std::vector<BlockEdit> batch;
+    size_t segmentEdits = 0;
+    bool isFailing = false;
+    bool isStopping = false;
+    std::thread writer;
+
+    std::atomic<size_t> committedEdits{ 0 };
+    std::atomic<int> commits{ 0 };
+    std::atomic<int> largestBatch{ 0 };
+    std::atomic<int> failedCommits{ 0 };
+
+    std::string segmentPath(int number) const;
+    std::vector<int> listSegments() const;
+    void openSegment(int number);
+    // Caller holds fileMutex.
+    bool commitLocked();
+    void run();
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+#include "spatial_hash.h"
+#include "job_system.h"
+
+using Entity = uint32_t;
+
+// Every moving body in the world, the player included. Components live in
+// parallel arrays indexed by a dense slot, so each update pass walks plain
+// float arrays front to back. Removing an entity moves the last one into its
+// slot; Entity handles stay valid through that.
+class EntitySystem
+{
+public:
+    static constexpr Entity INVALID_ENTITY = 0xFFFFFFFFu;
+
+    static constexpr float GRAVITY = -10.f;
+    static constexpr float TERMINAL_VELOCITY = -20.f;
+
+    static constexpr size_t ENTITIES_PER_JOB = 1024;
+    static constexpr size_t PAIR_SLOTS_PER_JOB = 8192;
+
+    // position is the centre of the entity's feet; the box reaches halfWidth
+    // to each side and height upwards.
+    Entity create(glm::vec3 position, float halfWidth, float height);
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+    void clear();
+
+    // Moves every entity by one step: overlapping entities pushed apart and
+    // horizontal movement stopped by solid blocks, then landing, gravity and
+    // vertical movement. Given a job system the work is spread over it, with
+    // results bit-identical to running on one thread.
+    void update(const World& world, float deltaTime, JobSystem* jobs = nullptr);
+
+    glm::vec3 getPosition(Entity entity) const;
+    void setPosition(Entity entity, glm::vec3 position);
+    glm::vec3 getVelocity(Entity entity) const;
+    void setVelocity(Entity entity, glm::vec3 velocity);
+    bool isGrounded(Entity entity) const { return grounded[slots[entity]] != 0; }
+    // Gives a grounded entity the upward speed and leaves it in the air.
+    void jump(Entity entity, float speed);
+
+    // True if the box at position overlaps a solid block.
+    static bool isColliding(const World& world, glm::vec3 position, float halfWidth, float height);
+
+    // True if placing a block at the cell would put it inside an entity.
+    bool isBlockOccupied(int x, int y, int z) const;
+
+    int getCount() const { return static_cast<int>(posX.size()); }
+    int getGroundedCount() const;
+    int getPairCount() const { return static_cast<int>(pairs.size()); }
+    const SpatialHash& getBroadphase() const { return broadphase; }
+
+private:
+    // Dense component arrays.
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> velX, velY, velZ;
+    std::vector<float> halfWidths, heights;
+    std::vector<uint8_t> grounded;
+    std::vector<Entity> owners;
+
+    // Entity to slot, with freed handles reused.
+    std::vector<uint32_t> slots;
+    std::vector<Entity> freeEntities;
+
+    // Built from the boxes at the end of each update and used until anything
+    // is created, destroyed or moved from outside.
+    SpatialHash broadphase;
+    bool isBroadphaseStale = true;
+    std::vector<Aabb> boxes;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> pairBatches;
+    // Indices into pairs for each entity: pairLinks[pairLinkStarts[i], pairLinkStarts[i + 1]).
+    std::vector<uint32_t> pairLinkStarts;
+    std::vector<uint32_t> pairLinks;
+    std::vector<uint32_t> pairLinkFill;
+    std::vector<float> pushX, pushZ;
+
+    void rebuildBroadphase();
+    void findPairs(JobSystem* jobs);
+    void linkPairs();
+
+    // The per-entity passes, each over the slots [begin, end).
+    void separate(size_t begin, size_t end);
+    void moveHorizontal(const World& world, float deltaTime, size_t begin, size_t end);
+    void landGrounded(const World& world, size_t begin, size_t end);
+    void applyGravity(float deltaTime, size_t begin, size_t end);
+    void moveVertical(float deltaTime, size_t begin, size_t end);
+
+    static bool isOnGround(const World& world, float x, float y, float z, float halfWidth);
+    bool coversBlock(uint32_t slot, int x, int y, int z) const;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+#include "job_system.h"
+
+// Water and lava as a cellular automaton. A fluid block carries a level
+// above its type bits: SOURCE_LEVEL for sources, which stay put, and lower
+// levels for flowing fluid, which every cell works out afresh from its
+// neighbours each step:
+// - Fluid above makes a falling cell at FALLING_LEVEL.
+// - A neighbour at the same height feeds the cell if it is a source or
+//   rests on something, one level lower for water and two for lava.
+// - Flowing fluid with nothing left feeding it drains away.
+// Lava touching water turns to stone.
+//
+// Only cells queued by a change next to them are looked at. The queue is
+// kept per chunk column, and a step runs the chunks in four rounds of a 2x2
+// checkerboard: a cell reads and writes no further than its neighbours, so
+// chunks of the same colour never touch each other's cells and each round
+// can run as one job per chunk. Each chunk walks its cells in order and
+// anything queued across a border is handed over after the step, so the
+// result is the same on any number of threads.
+class FluidSimulator
+{
+public:
+    static constexpr int SOURCE_LEVEL = 8;
+    static constexpr int FALLING_LEVEL = SOURCE_LEVEL - 1;
+
+    static int makeFluid(int type, int level) { return type | (level << World::BLOCK_TYPE_BITS); }
+    static bool isFluid(int block)
+    {
+        int type = World::getBlockType(block);
+        return type == BLOCK_WATER || type == BLOCK_LAVA;
+    }
+    static int getLevel(int block) { return block >> World::BLOCK_TYPE_BITS; }
+
+    FluidSimulator(int sizeX, int sizeY, int sizeZ);
+
+    const int SIZE_X;
+    const int SIZE_Y;
+    const int SIZE_Z;
+
+    // For blocks changed from outside the simulation: queues the cell and
+    // every cell whose next state depends on it.
+    void activate(int x, int y, int z);
+    // Activates every fluid cell in the chunk, for chunks loaded from disk.
+    void activateChunk(const World& world, int chunkX, int chunkZ);
+    // A frozen chunk keeps its queued cells but is not stepped, for chunks
+    // whose saved copy has not loaded yet.
+    void setChunkFrozen(int chunkX, int chunkZ, bool isFrozen);
+
+    // Moves every queued cell on one step, writing straight into the world.
+    void step(World& world, JobSystem* jobs = nullptr);
+    // Chunks with blocks changed by the last step, for remeshing and saving.
+    const std::vector<glm::ivec2>& getChangedChunks() const { return changedChunks; }
+
+    size_t getQueuedCount() const;
+    // Counts for the last step.
+    size_t getSteppedCount() const { return stepped; }
+    size_t getChangedCount() const { return changed; }
+    int getSteppedChunkCount() const { return steppedChunks; }
+
+private:
+    struct ChunkCells
+    {
+        std::vector<uint32_t> queued;
+        std::vector<uint32_t> cells;
+        // Written only by the job running this chunk.
+        std::vector<std::pair<int, uint32_t>> handOver;
+        size_t changed = 0;
+    };
+
+    int chunksX;
+    std::vector<ChunkCells> chunks;
+    std::vector<int> queuedChunks;
+    std::vector<int> heldChunks;
+    std::vector<char> isQueued;
+    std::vector<char> isFrozen;
+    std::vector<int> phaseChunks[4];
+    std::vector<glm::ivec2> changedChunks;
+
+    size_t stepped = 0;
+    size_t changed = 0;
+    int steppedChunks = 0;
+
+    void queue(int chunk, uint32_t cell);
+    // Calls visit(chunk, cell) for the cell and the cells that read it.
+    template<typename Visit>
+    void forEachDependent(glm::ivec3 p, Visit visit) const;
+    void stepChunk(World& world, int chunk);
+    int getNextBlock(const World& world, glm::ivec3 p, int block) const;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+
+// What the render thread samples from the window for the simulation.
+struct InputState
+{
+    bool isForward = false;
+    bool isBackward = false;
+    bool isLeft = false;
+    bool isRight = false;
+    bool isJump = false;
+    bool isBreak = false;
+    bool isPlace = false;
+    bool isStats = false;
+    bool isUndo = false;
+    bool isRedo = false;
+    // What placing puts down, picked with the number keys.
+    int selectedBlock = BLOCK_DIRT;
+    // Accumulated since the simulation last took the input.
+    float mouseX = 0.f;
+    float mouseY = 0.f;
+};
+
+struct ChunkUpdate
+{
+    int chunkX;
+    int chunkZ;
+    ChunkSnapshot snapshot;
+};
+
+// Everything the render thread needs from one simulation tick. The change
+// lists are only cleared once the render thread has picked them up.
+struct RenderState
+{
+    uint32_t tick = 0;
+    double tickTime = 0.0;
+
+    // Position at the previous and at this tick, for interpolating between them.
+    glm::vec3 previousPosition{ 0.f };
+    glm::vec3 position{ 0.f };
+    glm::vec3 front{ 0.f, 0.f, -1.f };
+    glm::vec3 up{ 0.f, 1.f, 0.f };
+
+    bool hasTarget = false;
+    glm::ivec3 targetedBlock{ -1 };
+
+    // Block columns (x, z) whose meshes and occluders are stale.
+    std::vector<glm::ivec2> dirtyBlocks;
+    // Chunks (x, z) replaced as a whole.
+    std::vector<glm::ivec2> dirtyChunks;
+    std::vector<ChunkUpdate> chunkUpdates;
+};
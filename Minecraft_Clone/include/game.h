@@ -1,44 +1,173 @@
 #pragma once
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "world.h"
 #include "physics.h"
+#include "entity_system.h"
+#include "block_ticks.h"
+#include "random_ticks.h"
+#include "fluids.h"
+#include "edit_history.h"
 #include "camera.h"
 #include "shader.h"
+#include "occlusion.h"
+#include "chunk_renderer.h"
+#include "chunk_io.h"
+#include "edit_journal.h"
+#include "job_system.h"
+#include "triple_buffer.h"
+#include "frame_state.h"
 
 class Game {
 public:
+    static constexpr const char* SAVE_DIR = "../saves/world";
+    static constexpr const char* SNAPSHOT_PATH = "../saves/world.snap";
+    static constexpr const char* JOURNAL_DIR = "../saves/world/journal";
+
+    static constexpr int TICK_RATE = 60;
+    static constexpr size_t UNDO_HISTORY_BYTES = 16u << 20;
+    static constexpr float TICK_SECONDS = 1.f / TICK_RATE;
+
     Game();
+    // Renders on the calling thread while the simulation ticks on its own.
     void run(GLFWwindow* window);
+    // Same split without a window: holds forward for the given time while a
+    // stand-in render loop takes frameMs per frame, then prints both rates.
+    void runHeadless(float seconds, float frameMs);
 
-    void processMouseInput(float xOffset, float yOffset) { camera.processMouseInput(xOffset, yOffset); }
+    void processMouseInput(float xOffset, float yOffset);
     void processInput(GLFWwindow *window);
 
-    void setBlock(int x, int y, int z, int value) { world.setBlock(x, y, z, value); }
+    void setBlock(int x, int y, int z, int value);
+    // Asks for updateBlock to run on the cell delay ticks from now.
+    void scheduleBlockTick(int x, int y, int z, uint32_t delay);
     bool isBlockSolid(int x, int y, int z) const { return world.isBlockSolid(x, y, z); }
     bool isOutOfWorld(int x, int y, int z) { return world.isOutOfWorld(x, y, z); }
+    bool isBlockOccupied(int x, int y, int z) const { return entities.isBlockOccupied(x, y, z); }
+    const World& getWorld() const { return world; }
 
     int getSizeX() const { return world.WORLD_X; }
     int getSizeY() const { return world.WORLD_Y; }
     int getSizeZ() const { return world.WORLD_Z; }
 
     void setShader(Shader shaderProg);
-    void setTexture(const unsigned int tex[3]);
+    void setTexture(const unsigned int tex[FACE_TEXTURE_COUNT]);
+    void setProjection(const glm::mat4& proj);
+    void setBlockVAO(unsigned int vao) { blockVAO = vao; }
+    void setLodDistances(float lod1, float lod2, float lod3) { chunkRenderer.setLodDistances(lod1, lod2, lod3); }
 
 private:
+    // Declared first so it outlives everything that submits jobs.
+    JobSystem jobs;
+
+    // Simulation thread. world is only touched here once the thread runs.
     Physics physics;
     World world;
     Camera camera;
+    // The player is an entity like any other; the camera sits PLAYER_HEIGHT
+    // above its feet.
+    EntitySystem entities;
+    Entity player = EntitySystem::INVALID_ENTITY;
+    BlockTicks blockTicks;
+    std::vector<glm::ivec3> dueTicks;
+    std::vector<PendingTick> pendingTicks;
+    RandomTicks randomTicks;
+    std::vector<BlockChange> blockChanges;
+    FluidSimulator fluids;
+    // Player edits, one step per tick that changed anything.
+    EditHistory history;
+    std::vector<glm::ivec2> historyChunks;
+    ChunkIO chunkIO;
+    std::vector<char> unsavedChunks;
+    EditJournal journal;
+    // Journaled edits from an earlier run, applied once their chunk has loaded.
+    std::vector<std::vector<BlockEdit>> recoveredEdits;
+    // Chunks whose saved copy has arrived or turned out not to exist. Until
+    // then random ticks and fluids leave a chunk alone, and edits made to it
+    // are kept to replay over the saved copy. Autosaves wait for every load.
+    std::vector<char> loadedChunks;
+    std::vector<std::vector<BlockEdit>> earlyEdits;
+    int pendingLoads = 0;
+    // The segment that can be deleted once the request with this number has
+    // completed and no save failed on the way.
+    int retireSegment = -1;
+    size_t retireAfterRequest = 0;
+    bool hasSaveFailed = false;
+    uint32_t tick = 0;
+    float autosaveTimer = 0.f;
+    glm::vec3 previousPosition{ 0.f };
+    // Chunks to send to the render thread with the next published state.
+    std::vector<char> changedChunks;
+    int droppedStates = 0;
+    int tickCount = 0;
+    double tickMsTotal = 0.0;
+    double tickMsMax = 0.0;
+    double entityMsTotal = 0.0;
+    double randomTickMsTotal = 0.0;
+    double fluidMsTotal = 0.0;
+
+    // Shared between the threads.
+    TripleBuffer<RenderState> frames;
+    std::mutex inputMutex;
+    InputState input;
+    std::thread simThread;
+    std::atomic<bool> isSimRunning{ false };
 
+    // Render thread. renderWorld follows world through the published chunk
+    // snapshots, so culling and meshing never read the simulation's copy.
+    World renderWorld;
+    OcclusionCuller culler;
+    ChunkRenderer chunkRenderer;
     Shader shader;
-    unsigned int texture[3]{};
+    unsigned int texture[FACE_TEXTURE_COUNT]{};
+    glm::mat4 projection{1.f};
+    unsigned int blockVAO = 0;
 
     float deltaTime = 0.f;
     float lastFrame = 0.f;
+    bool isStatsKeyDown = false;
+    bool isUndoKeyDown = false;
+    bool isRedoKeyDown = false;
+    int frameCount = 0;
+    double frameMsTotal = 0.0;
+    double frameMsMax = 0.0;
 
     static constexpr float PLAYER_HEIGHT = 1.2f;
     static constexpr float PLAYER_RADIUS = 0.2f;
+    static constexpr float PLAYER_JUMP_SPEED = 5.5f;
+    static constexpr float AUTOSAVE_INTERVAL = 10.f;
+
+    void startSimulation();
+    void stopSimulation();
+    void runSimulation();
+    void tickSimulation(const InputState& in);
+    void applyInput(const InputState& in);
+    void runBlockTicks();
+    void runRandomTicks();
+    // Steps the fluids and remeshes each chunk they changed once per tick.
+    // Fluid changes are not journaled: they follow again from the sources.
+    void runFluids();
+    // Undoes or redoes one step of player edits, journaling every block it writes.
+    void applyHistory(bool isUndo);
+    void updateBlock(int x, int y, int z);
+    void publishRenderState();
+    void markBlockChanged(int x, int z);
+    void markChunkChanged(int chunkX, int chunkZ);
+
+    void applyRenderState(const RenderState& state);
+    void shutdown();
+
+    // Each thread prints its own half when F3 is pressed.
+    void printSimStats();
+    void printRenderStats();
 
-    void renderBlock(int x, int y, int z) const;
+    void handleIOCompletion(const ChunkIO::Completion& done);
+    void saveUnsavedChunks();
+    // Writes the edits into a chunk that has just loaded and clears them.
+    void applyEdits(std::vector<BlockEdit>& edits, int chunkX, int chunkZ);
+    void recordEarlyEdit(int x, int y, int z, int from, int to);
 };
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "work_stealing_deque.h"
+
+// Counts unfinished jobs. Submitting with a counter increments it and the
+// job decrements it when done, so a counter doubles as a dependency on a
+// whole group of jobs.
+class JobCounter
+{
+public:
+    bool isDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> count{ 0 };
+};
+
+struct WorkerStats
+{
+    long jobs = 0;
+    long steals = 0;
+    // Fraction of the time since the last reset spent running jobs.
+    double utilisation = 0.0;
+};
+
+// One pool of worker threads for all CPU work. Each worker owns a
+// work-stealing deque per priority; idle workers steal from the others and
+// sleep once there is nothing left anywhere. Jobs submitted from outside the
+// pool go through a shared injection queue.
+class JobSystem
+{
+public:
+    enum Priority {
+        HIGH,
+        NORMAL,
+        PRIORITY_COUNT
+    };
+
+    static constexpr size_t DEQUE_CAPACITY = 4096;
+
+    // 0 picks one worker per hardware thread, minus the main thread.
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> task, Priority priority = NORMAL, JobCounter* counter = nullptr);
+
+    template <typename F>
+    auto async(Priority priority, F&& f) -> std::future<std::invoke_result_t<F>>
+    {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> result = task->get_future();
+        submit([task] { (*task)(); }, priority);
+        return result;
+    }
+
+    // Runs other jobs until the counter reaches zero, so it is safe to call
+    // from inside a job. A thread outside the pool only runs jobs it finds
+    // queued under this counter, so waiting on the simulation thread never
+    // picks up meshing or culling meant for the render thread.
+    void wait(const JobCounter& counter);
+
+    int getWorkerCount() const { return static_cast<int>(workers.size()); }
+    std::vector<WorkerStats> getWorkerStats() const;
+    void resetStats();
+
+private:
+    struct Job
+    {
+        std::function<void()> task;
+        JobCounter* counter;
+    };
+
+    struct alignas(64) Worker
+    {
+        std::unique_ptr<WorkStealingDeque<Job>> deques[PRIORITY_COUNT];
+        std::thread thread;
+        std::atomic<long> jobs{ 0 };
+        std::atomic<long> steals{ 0 };
+        std::atomic<long long> busyNs{ 0 };
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex injectMutex;
+    std::deque<Job*> injected[PRIORITY_COUNT];
+
+    // Jobs queued but not yet picked up, used to decide when to sleep.
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> sleepers{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> isStopping{ false };
+
+    std::atomic<long long> statsStartNs{ 0 };
+
+    int currentWorker() const;
+    Job* findJob(int self);
+    Job* findInjected(const JobCounter& counter);
+    void execute(Job* job, int self);
+    void run(int self);
+};
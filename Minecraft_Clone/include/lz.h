@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Small self-contained LZ77 codec using the LZ4 block layout: a token byte with
+// literal/match length nibbles, the literals, then a 16-bit match offset.
+namespace lz
+{
+    std::vector<uint8_t> compress(const uint8_t* data, size_t size);
+
+    // Throws std::runtime_error if the input is corrupt or does not expand to
+    // exactly rawSize bytes.
+    std::vector<uint8_t> decompress(const uint8_t* data, size_t size, size_t rawSize);
+}
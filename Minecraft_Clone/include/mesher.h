@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "world.h"
+
+// Fluid textures come last and are drawn after all the others, blended and
+// without writing depth.
+enum Face_Texture {
+    DIRT_TEX,
+    GRASS_TOP_TEX,
+    GRASS_SIDE_TEX,
+    STONE_TEX,
+    WATER_TEX,
+    LAVA_TEX,
+    FACE_TEXTURE_COUNT,
+    FIRST_FLUID_TEX = WATER_TEX
+};
+
+// Block types (World::getBlockType) of one chunk column plus a one block
+// border, so meshing can run off the main thread while the world keeps
+// being edited.
+struct ChunkVolume
+{
+    int originX = 0;
+    int originZ = 0;
+    int sizeX = 0;
+    int sizeY = 0;
+    int sizeZ = 0;
+    std::vector<uint8_t> types;
+
+    int getType(int x, int y, int z) const
+    {
+        return types[(x + 1) + (y + 1) * (sizeX + 2) + (z + 1) * (sizeX + 2) * (sizeY + 2)];
+    }
+    bool isSolid(int x, int y, int z) const { return World::isSolidBlock(getType(x, y, z)); }
+};
+
+// A chunk and its eight neighbours, snapshotted on the main thread so the
+// volume can be captured on a worker without locking the world.
+struct ChunkNeighbourhood
+{
+    int chunkX = 0;
+    int chunkZ = 0;
+    int worldX = 0;
+    int worldY = 0;
+    int worldZ = 0;
+    ChunkSnapshot chunks[3][3];
+};
+
+// Interleaved position (3) + uv (2), grouped by texture so each group is one draw.
+struct ChunkMesh
+{
+    int lod = 0;
+    std::vector<float> vertices[FACE_TEXTURE_COUNT];
+
+    int vertexCount(int tex) const { return static_cast<int>(vertices[tex].size() / 5); }
+    int triangleCount() const;
+};
+
+class ChunkMesher
+{
+public:
+    static constexpr int FLOATS_PER_VERTEX = 5;
+
+    static ChunkNeighbourhood snapshot(const World& world, int chunkX, int chunkZ);
+    static ChunkVolume capture(const ChunkNeighbourhood& area);
+    static ChunkVolume capture(const World& world, int chunkX, int chunkZ) { return capture(snapshot(world, chunkX, chunkZ)); }
+
+    // lod 0 meshes single blocks, lod n meshes 2^n cells built by majority
+    // vote, each taking the commonest type among its blocks. Fluids hide
+    // only faces of the same fluid, so whatever lies under them is meshed.
+    // Border faces of downsampled meshes are always emitted as skirts so they
+    // hide cracks against neighbours meshed at a different lod.
+    static ChunkMesh build(const ChunkVolume& volume, int lod);
+
+private:
+    static int getCellType(const ChunkVolume& volume, int x0, int y0, int z0, int scale);
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+class World;
+
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+class OcclusionCuller
+{
+public:
+    static constexpr int DEPTH_W = 256;
+    static constexpr int DEPTH_H = 128;
+
+    explicit OcclusionCuller(const World& world);
+
+    // Main thread: re-extract occluders of chunks touched since the last call.
+    void markDirty(int x, int z);
+    void updateOccluders();
+
+    // Worker thread: only reads the cached occluders, never the world.
+    void cull(const glm::mat4& viewProj);
+    // With testing off, cull keeps every section in the frustum, to compare against.
+    void setOcclusionTesting(bool isEnabled) { isTesting = isEnabled; }
+
+    // A chunk column is visible when any of its 16x16x16 sections is.
+    bool isVisible(int chunkX, int chunkZ) const { return visibleColumns[chunkX + chunkZ * chunksX] != 0; }
+    bool isSectionVisible(int chunkX, int sectionY, int chunkZ) const { return visible[getSectionIndex(chunkX, sectionY, chunkZ)] != 0; }
+    AABB getSectionBounds(int chunkX, int sectionY, int chunkZ) const;
+
+    int getVisibleCount() const { return visibleCount; }
+    int getVisibleSectionCount() const { return visibleSectionCount; }
+    int getOccluderCount() const { return occluderCount; }
+
+private:
+    // A rectangle looking along +axis or -axis: its corner with the least b
+    // and c, the next two axes round, and its size along them.
+    struct Face
+    {
+        glm::vec3 corner;
+        uint8_t axis;
+        int8_t side;
+        uint8_t sizeB;
+        uint8_t sizeC;
+    };
+
+    // A face on screen, clipped to the near plane, with its edge functions
+    // and the plane its depth lies on.
+    struct ScreenPolygon
+    {
+        int count = 0;
+        float edgeA[5], edgeB[5], edgeC[5];
+        float dzdx, dzdy, depthAtOrigin;
+        float minX, maxX, minY, maxY;
+    };
+
+    const World& world;
+    int chunksX;
+    int chunksZ;
+    int sectionsY;
+    bool isTesting = true;
+
+    // Per section, like everything below.
+    std::vector<std::vector<Face>> occluders;
+    std::vector<char> dirty;
+    // Sections without a single block in them have nothing to draw.
+    std::vector<char> isSectionEmpty;
+    // Sections in the frustum, nearest first, and how near each one gets.
+    std::vector<int> cullOrder;
+    std::vector<float> sectionDepth;
+    std::vector<char> visible;
+    std::vector<char> visibleColumns;
+    int visibleCount = 0;
+    int visibleSectionCount = 0;
+    int occluderCount = 0;
+
+    // Occluders are drawn into rasterDepth. levels[0] is that buffer eroded,
+    // each next level halves both sides.
+    std::vector<float> rasterDepth;
+    std::vector<std::vector<float>> maxDepth;
+    std::vector<std::vector<float>> minDepth;
+    std::vector<float> filterScratch;
+
+    int getSectionIndex(int chunkX, int sectionY, int chunkZ) const { return (chunkX + chunkZ * chunksX) * sectionsY + sectionY; }
+
+    void extractOccluders(int chunkX, int chunkZ);
+    void extractSection(int chunkX, int sectionY, int chunkZ);
+
+    static bool projectFace(const Face& face, const glm::mat4& viewProj, ScreenPolygon& polygon);
+    void rasterizeFace(const Face& face, const glm::mat4& viewProj, const glm::vec3& eye);
+    void erodeDepth();
+    void buildHierarchy();
+    bool isBoxInFrustum(const AABB& box, const glm::mat4& viewProj, float& nearestW) const;
+    bool testBox(const AABB& box, const glm::mat4& viewProj) const;
+    bool testRegion(int level, int tx, int ty, int x0, int y0, int x1, int y1, float boxDepth) const;
+    bool testFaces(const AABB& box, const glm::mat4& viewProj) const;
+
+    int levelWidth(int level) const { return DEPTH_W >> level; }
+    int levelHeight(int level) const { return DEPTH_H >> level; }
+};
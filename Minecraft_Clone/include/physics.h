@@ -1,6 +1,9 @@
 #pragma once
+#include <vector>
 #include <glm.hpp>
 
+#include "raycast.h"
+
 class Game;
 
 class Physics
@@ -12,13 +15,8 @@ public:
 
     void breakBlock();
 
-    void placeBlock(glm::vec3 cameraPos, float playerHeight, float playerRadius);
-
-    void jump();
-
-    bool checkCollision(float playerHeight, float playerRadius, glm::vec3 cameraPos);
-
-    float applyGravity(glm::vec3& cameraPos, float playerRadius, float playerHeight, float deltaTime);
+    // Refuses cells that any entity, the player included, stands in.
+    void placeBlock(int block);
 
     void targetBlock(glm::vec3 cameraPos, glm::vec3 cameraFront);
 
@@ -29,19 +27,18 @@ public:
 
 private:
     const float MAX_RAY_DIST = 8.f;
-    const float RAY_STEP = 0.05f;
-    const float GRAVITY = -10.f;
-    const float TERMINAL_VELOCITY = -20.f;
-    const float JUMP_FORCE = 5.5f;
     const float BREAK_COOLDOWN = 1.f;
     const float PLACE_COOLDOWN = 0.5f;
 
     Game* game;
 
-    float yVelocity;
     glm::ivec3 prevAirBlock;
     bool isBlockPlaceable;
-    bool isGrounded;
 
-    bool checkGrounded(glm::vec3 cameraPos, float playerRadius, float playerHeight);
+    // The targeting ray goes through the same batched caster as everything
+    // else, as a batch of one.
+    VoxelRaycaster raycaster;
+    std::vector<glm::vec3> rayOrigins;
+    std::vector<glm::vec3> rayDirections;
+    RaycastResults rayHits;
 };
\ No newline at end of file
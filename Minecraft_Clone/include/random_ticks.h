@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+
+struct BlockChange
+{
+    glm::ivec3 cell;
+    int value;
+};
+
+// Random block ticks. Each pass picks TICKS_PER_SECTION cells at random in
+// every 16x16x16 section of the world and runs the behaviour of the
+// tickable blocks among them. Sections the world counts no tickable blocks
+// in are passed over without reading a block, so the cost follows how much
+// tickable content there is rather than how big the world is.
+class RandomTicks
+{
+public:
+    static constexpr int TICKS_PER_SECTION = 3;
+
+    explicit RandomTicks(uint32_t seed = 1) : state(seed != 0 ? seed : 1) {}
+
+    // Fills changes with the blocks to write. Nothing is written during the
+    // pass, so every block in it sees the world as it was at the start.
+    void run(const World& world, std::vector<BlockChange>& changes);
+
+    // Counts for the last pass.
+    int getSectionsTicked() const { return sectionsTicked; }
+    int getSectionsSkipped() const { return sectionsSkipped; }
+    int getBlocksTicked() const { return blocksTicked; }
+
+private:
+    uint32_t state;
+    int sectionsTicked = 0;
+    int sectionsSkipped = 0;
+    int blocksTicked = 0;
+
+    uint32_t nextRandom();
+    // Grass under a solid block dies back to dirt. Otherwise it tries one
+    // cell within a step sideways, three down and one up, and spreads onto
+    // it if it is dirt with nothing solid above.
+    void tickGrass(const World& world, glm::ivec3 cell, std::vector<BlockChange>& changes);
+};
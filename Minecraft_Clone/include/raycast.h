@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+
+// The side of a block a ray came in through.
+enum Block_Face {
+    FACE_NEG_X,
+    FACE_POS_X,
+    FACE_NEG_Y,
+    FACE_POS_Y,
+    FACE_NEG_Z,
+    FACE_POS_Z,
+    // The ray started inside the block.
+    FACE_NONE
+};
+
+// One entry per ray, in the order the rays were given. The cell and face
+// only mean something for rays that hit.
+struct RaycastResults
+{
+    std::vector<char> isHit;
+    std::vector<glm::ivec3> cells;
+    std::vector<uint8_t> faces;
+    // Along the normalised direction, so in blocks.
+    std::vector<float> distances;
+
+    void resize(size_t count);
+};
+
+// Casts many rays through the world in one call. Rays are taken in runs of
+// RUN_SIZE, small enough that a run's rays and results stay in cache. Each
+// run is sorted by the chunk its rays start in and copied once into plain
+// float arrays in that order, set up in one pass, then walked cell by cell
+// (blocks are centred on integer coordinates) front to back, so rays from
+// the same area keep reading the same chunk column. Cells outside the world
+// count as air.
+//
+// With skipping on, solidity comes from the world's occupancy masks instead
+// of the blocks, and a ray crosses an empty chunk or 4x4x4 brick in a single
+// jump. Results are the same either way.
+class VoxelRaycaster
+{
+public:
+    static constexpr size_t RUN_SIZE = 1024;
+
+    void cast(const World& world, const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& directions,
+              float maxDistance, RaycastResults& out);
+
+    static glm::ivec3 getFaceNormal(int face);
+
+    void setEmptySpaceSkipping(bool isEnabled) { isSkipping = isEnabled; }
+
+    // Totals since construction.
+    long getRayCount() const { return rayCount; }
+    long getStepCount() const { return stepCount; }
+    long getChunkSwitches() const { return chunkSwitches; }
+    long getChunkSkips() const { return chunkSkips; }
+    long getBrickSkips() const { return brickSkips; }
+
+private:
+    // Per ray setup for the current run, in bucket order.
+    std::vector<float> originX, originY, originZ;
+    std::vector<float> dirX, dirY, dirZ;
+    std::vector<int> cellX, cellY, cellZ;
+    std::vector<float> nextX, nextY, nextZ;
+    std::vector<float> deltaX, deltaY, deltaZ;
+
+    // The run's rays grouped by starting chunk, as offsets from its first ray.
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> bucketStarts;
+
+    bool isSkipping = true;
+
+    long rayCount = 0;
+    long stepCount = 0;
+    long chunkSwitches = 0;
+    long chunkSkips = 0;
+    long brickSkips = 0;
+
+    void setup(size_t count);
+    void sortByChunk(const World& world, const glm::vec3* origins, size_t count);
+    void castRun(const World& world, const glm::vec3* origins, const glm::vec3* directions, size_t count,
+                 float maxDistance, RaycastResults& out, size_t first);
+};
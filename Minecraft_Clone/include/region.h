@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_ticks.h"
+
+class World;
+
+// One file per REGION_SIZE x REGION_SIZE chunk columns. The header holds an
+// offset table that is read once on open, so loading a chunk afterwards is a
+// single seek and a single read of its compressed payload. Space a rewritten
+// chunk leaves behind is reused once the table no longer points at it.
+class RegionFile
+{
+public:
+    static constexpr int REGION_SIZE = 32;
+    static constexpr uint32_t MAGIC = 0x4752434D; // "MCRG"
+    static constexpr uint32_t VERSION = 1;
+
+    RegionFile(const std::string& path, int chunkHeight);
+    ~RegionFile();
+
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    bool hasChunk(int localX, int localZ) const { return table[slot(localX, localZ)].rawSize != 0; }
+    bool readChunk(int localX, int localZ, std::vector<int>& blocks);
+
+    // Returns the compressed size. The payload never goes where the table on
+    // disk still points, and the table itself is only written by flush, so a
+    // crash before then leaves the previous copy of the chunk readable.
+    size_t writeChunk(int localX, int localZ, const int* blocks, size_t count);
+
+    // Syncs the payloads written since the last flush, then writes the table
+    // and syncs again. Throws if anything did not reach the disk.
+    void flush();
+    size_t getLastReadSize() const { return readBuffer.size(); }
+    size_t getFileSize() const { return endOffset; }
+    size_t getFreeBytes() const;
+
+private:
+    struct Entry
+    {
+        uint32_t offset;
+        uint32_t compressedSize;
+        uint32_t capacity;
+        uint32_t rawSize;
+    };
+
+    static constexpr size_t HEADER_BYTES = 3 * sizeof(uint32_t);
+
+    // The chunk height, with World::BLOCK_ORDER above it. Files from before
+    // block orders hold just the height, which reads as linear order.
+    static uint32_t getLayout(int chunkHeight);
+
+    uint32_t allocate(uint32_t size);
+    void release(uint32_t offset, uint32_t size);
+
+    int fd = -1;
+    std::vector<Entry> table;
+    uint32_t endOffset;
+    bool isTableDirty = false;
+    // Unused extents by offset, merged with their neighbours. Space given up
+    // by a write waits in releasedSpace until flush has synced the table.
+    std::map<uint32_t, uint32_t> freeSpace;
+    std::vector<std::pair<uint32_t, uint32_t>> releasedSpace;
+    std::vector<uint8_t> readBuffer;
+
+    static int slot(int localX, int localZ) { return localX + localZ * REGION_SIZE; }
+    static size_t tableBytes() { return REGION_SIZE * REGION_SIZE * sizeof(Entry); }
+};
+
+struct StorageStats
+{
+    int chunks = 0;
+    size_t rawBytes = 0;
+    size_t compressedBytes = 0;
+    double seconds = 0.0;
+
+    double ratio() const { return compressedBytes ? static_cast<double>(rawBytes) / compressedBytes : 0.0; }
+    double megabytesPerSecond() const { return seconds > 0.0 ? rawBytes / (1024.0 * 1024.0) / seconds : 0.0; }
+};
+
+class WorldStorage
+{
+public:
+    explicit WorldStorage(std::string directory);
+
+    void save(const World& world);
+    // Returns false when no saved chunk exists, leaving the world untouched.
+    bool load(World& world);
+
+    // Returns the compressed size written.
+    size_t saveChunk(const World& world, int chunkX, int chunkZ);
+    bool loadChunk(World& world, int chunkX, int chunkZ);
+
+    // Same as above on a detached copy of the column, for callers that must
+    // not touch the live world. Pending block ticks are stored after the
+    // blocks in the same payload; chunks saved without any read back none.
+    size_t saveChunkData(int chunkX, int chunkZ, int chunkHeight, const int* blocks,
+                         const std::vector<PendingTick>& ticks = {});
+    bool loadChunkData(int chunkX, int chunkZ, int chunkHeight, std::vector<int>& blocks,
+                       std::vector<PendingTick>* ticks = nullptr);
+
+    // Makes everything written so far durable, including the directory
+    // entries of region files created since the last flush.
+    void flush();
+
+    const StorageStats& getLastSave() const { return lastSave; }
+    const StorageStats& getLastLoad() const { return lastLoad; }
+
+private:
+    std::string directory;
+    std::map<std::pair<int, int>, std::unique_ptr<RegionFile>> regions;
+    std::vector<int> chunkBuffer;
+    std::vector<int> tickBuffer;
+    size_t lastChunkCompressed = 0;
+    bool hasNewRegions = false;
+
+    StorageStats lastSave;
+    StorageStats lastLoad;
+
+    // Returns nullptr if the region file does not exist and create is false.
+    RegionFile* getRegion(int regionX, int regionZ, int chunkHeight, bool create);
+};
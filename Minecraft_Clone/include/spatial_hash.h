@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    bool overlaps(const Aabb& other) const
+    {
+        return min.x < other.max.x && other.min.x < max.x &&
+               min.y < other.max.y && other.min.y < max.y &&
+               min.z < other.max.z && other.min.z < max.z;
+    }
+};
+
+// Uniform grid over a set of boxes for overlap queries. Each box is filed
+// under the cell holding its centre, and cells are sized to the largest box
+// so overlapping boxes are always in the same or neighbouring cells.
+//
+// Cells live in one open-addressing table that points into a single array
+// of box indices grouped by cell, so a rebuild reuses the previous storage
+// and allocates nothing once the sizes have settled. Results are indices into
+// the boxes passed to build, and every result really overlaps the query.
+class SpatialHash
+{
+public:
+    void build(const std::vector<Aabb>& boxes);
+    void clear();
+
+    // Each overlapping pair once, lower index first.
+    void findPairs(std::vector<std::pair<uint32_t, uint32_t>>& out) const { findPairs(out, 0, keys.size()); }
+    // Only the pairs found from cells in table slots [firstSlot, lastSlot).
+    // Splitting the table into runs and joining the results in slot order
+    // gives the same list as searching it whole.
+    void findPairs(std::vector<std::pair<uint32_t, uint32_t>>& out, size_t firstSlot, size_t lastSlot) const;
+    void queryAabb(const Aabb& box, std::vector<uint32_t>& out) const;
+    // Boxes with any point within radius of centre.
+    void queryRadius(glm::vec3 centre, float radius, std::vector<uint32_t>& out) const;
+
+    bool isEmpty() const { return sorted.empty(); }
+    size_t getTableSize() const { return keys.size(); }
+    float getCellSize() const { return cellSize; }
+    int getCellCount() const { return cellCount; }
+    int getMaxCellOccupancy() const { return maxOccupancy; }
+    // Average number of table slots looked at to place a box during the last build.
+    float getAverageProbes() const { return averageProbes; }
+
+private:
+    static constexpr uint64_t EMPTY_KEY = ~0ull;
+    static constexpr int KEY_BITS = 21;
+
+    float cellSize = 1.f;
+    float inverseCellSize = 1.f;
+    uint64_t tableMask = 0;
+
+    // The table. A cell's boxes are sorted[cellStarts[slot], cellStarts[slot] + cellSizes[slot]).
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> cellStarts;
+    std::vector<uint32_t> cellSizes;
+
+    // Box indices grouped by cell, with the boxes copied alongside in the
+    // same order so a cell is read front to back.
+    std::vector<uint32_t> sorted;
+    std::vector<Aabb> sortedBoxes;
+    std::vector<uint32_t> boxSlots;
+
+    int cellCount = 0;
+    int maxOccupancy = 0;
+    float averageProbes = 0.f;
+
+    glm::ivec3 getCell(glm::vec3 point) const;
+    static uint64_t packKey(glm::ivec3 cell);
+    // Slot holding the key, or the empty slot where it would go.
+    uint64_t findSlot(uint64_t key, int* probes = nullptr) const;
+    template<typename Visit>
+    void forEachCandidate(const Aabb& box, Visit visit) const;
+};
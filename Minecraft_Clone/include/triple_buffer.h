@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+
+// Hands the latest state from one writer thread to one reader thread without
+// either waiting on the other. The writer fills its buffer and swaps it into
+// the middle slot; the reader swaps the middle slot out when it is fresh.
+template <typename T>
+class TripleBuffer
+{
+public:
+    T& getWriteBuffer() { return buffers[writeIndex]; }
+    const T& getReadBuffer() const { return buffers[readIndex]; }
+
+    // Returns true if the buffer handed back to the writer was published
+    // earlier but never read, so whatever only it carried has not arrived.
+    bool publish()
+    {
+        int old = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = old & INDEX_MASK;
+        return (old & FRESH_BIT) != 0;
+    }
+
+    // Returns false if nothing new was published since the last call.
+    bool consume()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+            return false;
+
+        int old = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = old & INDEX_MASK;
+        return true;
+    }
+
+private:
+    static constexpr int FRESH_BIT = 4;
+    static constexpr int INDEX_MASK = 3;
+
+    T buffers[3];
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle{ 2 };
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+
+// The handful of GL calls the upload ring needs. Kept behind an interface so
+// the ring bookkeeping can run against a fake without a GL context.
+class UploadBackend
+{
+public:
+    virtual ~UploadBackend() = default;
+
+    virtual unsigned int createBuffer(size_t size) = 0;
+    virtual void deleteBuffer(unsigned int buffer) = 0;
+    virtual void orphan(unsigned int buffer, size_t size) = 0;
+
+    // Unsynchronized map of a range; may return nullptr, in which case the ring
+    // falls back to write().
+    virtual void* map(unsigned int buffer, size_t offset, size_t size) = 0;
+    virtual void unmap(unsigned int buffer) = 0;
+    virtual void write(unsigned int buffer, size_t offset, const void* data, size_t size) = 0;
+
+    virtual void copy(unsigned int src, unsigned int dst, size_t srcOffset, size_t dstOffset, size_t size) = 0;
+
+    virtual void* insertFence() = 0;
+    virtual bool isFenceSignaled(void* fence) = 0;
+    virtual void deleteFence(void* fence) = 0;
+};
+
+class GLUploadBackend : public UploadBackend
+{
+public:
+    unsigned int createBuffer(size_t size) override;
+    void deleteBuffer(unsigned int buffer) override;
+    void orphan(unsigned int buffer, size_t size) override;
+    void* map(unsigned int buffer, size_t offset, size_t size) override;
+    void unmap(unsigned int buffer) override;
+    void write(unsigned int buffer, size_t offset, const void* data, size_t size) override;
+    void copy(unsigned int src, unsigned int dst, size_t srcOffset, size_t dstOffset, size_t size) override;
+    void* insertFence() override;
+    bool isFenceSignaled(void* fence) override;
+    void deleteFence(void* fence) override;
+};
+
+// One staging buffer per in-flight frame. Data is written into the current
+// frame's buffer and copied GPU-side into its destination, so the render
+// thread never waits for the driver to release a buffer it still reads from.
+class UploadRing
+{
+public:
+    static constexpr int FRAMES = 3;
+
+    UploadRing(UploadBackend& backend, size_t segmentBytes, size_t frameBudget);
+
+    void beginFrame();
+    void endFrame();
+
+    // Returns false (and counts a deferral) when size more bytes do not fit
+    // this frame's budget; the caller should retry next frame. The first
+    // upload of a frame is always accepted, growing the staging buffer if needed.
+    bool reserve(size_t size);
+    // Writes size bytes that reserve has just accepted.
+    void upload(unsigned int dstBuffer, size_t dstOffset, const void* data, size_t size);
+
+    void release();
+
+    size_t getFrameBudget() const { return frameBudget; }
+    void setFrameBudget(size_t bytes) { frameBudget = bytes; }
+
+    size_t getBytesThisFrame() const { return bytesThisFrame; }
+    size_t getTotalBytes() const { return totalBytes; }
+    int getDeferredCount() const { return deferredCount; }
+    int getOrphanCount() const { return orphanCount; }
+    int getMapFallbackCount() const { return mapFallbackCount; }
+    int getCurrentSegment() const { return current; }
+
+private:
+    struct Segment
+    {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        void* fence = nullptr;
+    };
+
+    UploadBackend& backend;
+    Segment segments[FRAMES];
+    size_t segmentBytes;
+    size_t frameBudget;
+
+    int current = FRAMES - 1;
+    size_t cursor = 0;
+    size_t bytesThisFrame = 0;
+    size_t totalBytes = 0;
+    int deferredCount = 0;
+    int orphanCount = 0;
+    int mapFallbackCount = 0;
+};
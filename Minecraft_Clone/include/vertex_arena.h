@@ -0,0 +1,57 @@
+#pragma once
+#include <map>
+#include <vector>
+
+// CPU-side bookkeeping for one large GPU vertex buffer. Offsets and sizes are
+// in vertices, so they can be passed straight to glMultiDrawArrays.
+class VertexArena
+{
+public:
+    static constexpr int INVALID_HANDLE = -1;
+
+    struct Move
+    {
+        int from;
+        int to;
+        int size;
+    };
+
+    explicit VertexArena(int capacity);
+
+    int allocate(int size);
+    void release(int handle);
+
+    int getOffset(int handle) const { return allocations[handle].offset; }
+    int getSize(int handle) const { return allocations[handle].size; }
+
+    // Packs all live allocations towards offset 0, one move per allocation.
+    // The returned moves must be applied in order. Each goes downwards and
+    // may overlap its own source range, so copy it the way memmove would.
+    std::vector<Move> defragment();
+    void grow(int newCapacity);
+
+    int getCapacity() const { return capacity; }
+    int getUsed() const { return used; }
+    int getFreeBlockCount() const { return static_cast<int>(freeBlocks.size()); }
+    int getLargestFreeBlock() const;
+
+    // 0 when all free space is one block, approaching 1 as it splinters.
+    float getFragmentation() const;
+
+private:
+    struct Allocation
+    {
+        int offset = 0;
+        int size = 0;
+        bool isLive = false;
+    };
+
+    int capacity;
+    int used = 0;
+
+    std::map<int, int> freeBlocks;
+    std::vector<Allocation> allocations;
+    std::vector<int> freeHandles;
+
+    void addFreeBlock(int offset, int size);
+};
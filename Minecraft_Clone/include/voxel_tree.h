@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+// Blocks of one region as a 64-tree: every node splits its cube into 4x4x4
+// children, and a child that is a single block type all the way through is
+// stored as that block instead of as a node. Solid rock and open sky collapse
+// to a few entries however much of the region they fill, so the tree suits
+// chunks that are unloaded or far away and tools working on whole saves.
+//
+// The tree covers [0, size) on each axis, size being the smallest power of 4
+// of at least 64 that holds the extent. As in World, single blocks outside
+// the extent are out of range, and chunk cells past it read as air and are
+// ignored on write.
+class VoxelTree
+{
+public:
+    static constexpr int BRANCH = 4;
+    static constexpr int CHILDREN = BRANCH * BRANCH * BRANCH;
+    // Chunk columns are stacks of 16x16x16 sections, each a whole subtree,
+    // so setChunk builds and swaps in one section at a time.
+    static constexpr int SECTION_SIZE = 16;
+
+    VoxelTree(int sizeX, int sizeY, int sizeZ, int fill = 0);
+
+    const int SIZE_X;
+    const int SIZE_Y;
+    const int SIZE_Z;
+
+    int getBlock(int x, int y, int z) const;
+    void setBlock(int x, int y, int z, int value);
+
+    // Whole chunk columns in World::getChunk order, with SIZE_Y as the height.
+    void setChunk(int chunkX, int chunkZ, const std::vector<int>& blocks);
+    void getChunk(int chunkX, int chunkZ, std::vector<int>& out) const;
+
+    // Calls visit(min, max, block) for every uniform box in the tree that
+    // overlaps [lo, hi], clipped to it. Bounds are inclusive. The boxes cover
+    // the part of [lo, hi] inside the tree exactly once.
+    template<typename Visit>
+    void forEachInBox(glm::ivec3 lo, glm::ivec3 hi, Visit visit) const;
+
+    int getSize() const { return 1 << (2 * depth); }
+    int getDepth() const { return depth; }
+    size_t getNodeCount() const { return nodes.size() - freeNodes.size(); }
+    size_t getMemoryBytes() const { return getNodeCount() * sizeof(Node); }
+
+private:
+    // A child is a node index when its bit in subtrees is set, a block otherwise.
+    struct Node
+    {
+        uint64_t subtrees = 0;
+        int32_t children[CHILDREN];
+    };
+
+    int depth;
+    // The root is always node 0 and is never collapsed, even when uniform.
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+
+    static int getChildIndex(int x, int y, int z, int shift)
+    {
+        return ((x >> shift) & 3) | (((y >> shift) & 3) << 2) | (((z >> shift) & 3) << 4);
+    }
+    bool isOutOfTree(int x, int y, int z) const
+    {
+        return x < 0 || x >= SIZE_X || y < 0 || y >= SIZE_Y || z < 0 || z >= SIZE_Z;
+    }
+
+    uint32_t allocateNode(int fill);
+    void freeSubtree(uint32_t node);
+    // Puts child (a node if isNode, else a block) in place of the cube of
+    // edge 1 << shift at corner, then collapses any ancestor left uniform.
+    void replace(glm::ivec3 corner, int shift, bool isNode, int32_t child);
+    // Builds the cube of edge 1 << shift at corner from one chunk column.
+    // Returns true and sets child to a node index if the cube is not uniform.
+    bool buildFromChunk(glm::ivec3 corner, int shift, glm::ivec3 chunkCorner, const std::vector<int>& blocks, int32_t& child);
+
+    template<typename Visit>
+    void visitNode(uint32_t node, glm::ivec3 corner, int shift, glm::ivec3 lo, glm::ivec3 hi, Visit& visit) const;
+};
+
+template<typename Visit>
+void VoxelTree::forEachInBox(glm::ivec3 lo, glm::ivec3 hi, Visit visit) const
+{
+    lo = glm::max(lo, glm::ivec3(0));
+    hi = glm::min(hi, glm::ivec3(getSize() - 1));
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z)
+        return;
+
+    visitNode(0, glm::ivec3(0), 2 * (depth - 1), lo, hi, visit);
+}
+
+// shift is log2 of the edge of this node's children.
+template<typename Visit>
+void VoxelTree::visitNode(uint32_t node, glm::ivec3 corner, int shift, glm::ivec3 lo, glm::ivec3 hi, Visit& visit) const
+{
+    const Node& n = nodes[node];
+    const int edge = 1 << shift;
+
+    // Only the children the box reaches.
+    glm::ivec3 first = (lo - corner) >> shift;
+    glm::ivec3 last = (hi - corner) >> shift;
+    first = glm::clamp(first, glm::ivec3(0), glm::ivec3(BRANCH - 1));
+    last = glm::clamp(last, glm::ivec3(0), glm::ivec3(BRANCH - 1));
+
+    for (int cz = first.z; cz <= last.z; cz++)
+    {
+        for (int cy = first.y; cy <= last.y; cy++)
+        {
+            for (int cx = first.x; cx <= last.x; cx++)
+            {
+                int c = cx | (cy << 2) | (cz << 4);
+                glm::ivec3 childCorner = corner + glm::ivec3(cx, cy, cz) * edge;
+                if (n.subtrees & (1ull << c))
+                {
+                    visitNode(static_cast<uint32_t>(n.children[c]), childCorner, shift - 2, lo, hi, visit);
+                    continue;
+                }
+
+                visit(glm::max(childCorner, lo), glm::min(childCorner + edge - 1, hi), static_cast<int>(n.children[c]));
+            }
+        }
+    }
+}
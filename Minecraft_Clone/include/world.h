@@ -1,21 +1,298 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
+#include "chunk_layout.h"
+
+class WorldSnapshot;
+
+enum Block_Type {
+    BLOCK_AIR,
+    BLOCK_DIRT,
+    BLOCK_GRASS,
+    BLOCK_STONE,
+    BLOCK_WATER,
+    BLOCK_LAVA
+};
+
+// Immutable view of one chunk column in World::getChunk order. Holding it
+// keeps the blocks alive and unchanged whatever the world does afterwards.
+struct ChunkSnapshot
+{
+    std::shared_ptr<const void> owner;
+    const int* blocks = nullptr;
+    uint32_t version = 0;
+
+    // Chunks outside the world have no blocks and read as air.
+    bool isValid() const { return blocks != nullptr; }
+};
+
+// The part of an edit box inside one chunk column: x and z are chunk-local,
+// y is world height. All bounds are inclusive.
+struct ChunkSpan
+{
+    int chunkX;
+    int chunkZ;
+    int minX, minY, minZ;
+    int maxX, maxY, maxZ;
+};
+
 class World
 {
 public:
     World(int sizeX = 64, int sizeY = 8, int sizeZ = 64);
+    // Reads blocks in place from the mapped snapshot. A chunk is copied into
+    // private memory the first time anything writes to it.
+    explicit World(std::shared_ptr<const WorldSnapshot> snapshot);
 
     const int WORLD_X;
     const int WORLD_Y;
     const int WORLD_Z;
 
-    bool isBlockSolid(int x, int y, int z) const;
+    // Block order inside chunk columns, fixed at compile time. Define
+    // MORTON_CHUNKS for Morton-ordered sections.
+#ifdef MORTON_CHUNKS
+    static constexpr Block_Order BLOCK_ORDER = ORDER_MORTON;
+#else
+    static constexpr Block_Order BLOCK_ORDER = ORDER_LINEAR;
+#endif
+
+    // Chunk columns are 16 blocks across and as tall as the world, which
+    // differs between worlds; a 16x16x16 section is the part of a column a
+    // chunk high.
+    using Section = ChunkLayout<16, 16, 16, BLOCK_ORDER>;
+    // The 4x4x4 bricks whose occupancy is tracked for skipping empty space.
+    using Brick = ChunkLayout<4, 4, 4>;
+    static constexpr int CHUNK_SIZE = Section::SIZE_X;
+    static constexpr int BRICK_SIZE = Brick::SIZE_X;
+
+    int getChunksX() const { return chunksX; }
+    int getChunksZ() const { return (WORLD_Z + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    int getChunkVolume() const { return getColumnVolume(WORLD_Y); }
+
+    // A linear column runs x first, then y all the way up, then z. A Morton
+    // column is its sections one above the other, each in Morton order, and
+    // is padded to whole sections; the padding is always air.
+    static int getColumnVolume(int height)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return (height + CHUNK_SIZE - 1) / CHUNK_SIZE * Section::VOLUME;
+        else
+            return CHUNK_SIZE * height * CHUNK_SIZE;
+    }
+    // Index of a block in its chunk column's blocks, for any block in the world.
+    int getColumnIndex(int x, int y, int z) const
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return getColumnIndex(x, y, z, WORLD_Y);
+        else
+            return Section::toLocalX(x) + (y << Section::SHIFT_X) + Section::toLocalZ(z) * columnStride;
+    }
+    // The same for a column of the given height, and back to chunk-local x
+    // and z and world y.
+    static int getColumnIndex(int x, int y, int z, [[maybe_unused]] int height)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return Section::toChunkY(y) * Section::VOLUME + Section::getIndex(Section::toLocalX(x), Section::toLocalY(y), Section::toLocalZ(z));
+        else
+            return Section::toLocalX(x) + (y << Section::SHIFT_X) + Section::toLocalZ(z) * CHUNK_SIZE * height;
+    }
+    static int getColumnX(int index)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return Section::getX(index % Section::VOLUME);
+        else
+            return index % CHUNK_SIZE;
+    }
+    static int getColumnY(int index, [[maybe_unused]] int height)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return index / Section::VOLUME * CHUNK_SIZE + Section::getY(index % Section::VOLUME);
+        else
+            return index / CHUNK_SIZE % height;
+    }
+    static int getColumnZ(int index, [[maybe_unused]] int height)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return Section::getZ(index % Section::VOLUME);
+        else
+            return index / (CHUNK_SIZE * height);
+    }
+    // The column index of the block DX, DY, DZ away in a column of the given
+    // height, when that block is in the same section.
+    template<int DX, int DY, int DZ>
+    static int getNeighbourIndex(int index, [[maybe_unused]] int height)
+    {
+        if constexpr (BLOCK_ORDER == ORDER_MORTON)
+            return index - index % Section::VOLUME + Section::template getNeighbourIndex<DX, DY, DZ>(index % Section::VOLUME);
+        else
+            return index + DX + DY * CHUNK_SIZE + DZ * CHUNK_SIZE * height;
+    }
+
+    // Whole chunk columns in getColumnIndex order. Cells past the world edge
+    // read as air and are ignored on write.
+    void getChunk(int chunkX, int chunkZ, std::vector<int>& out) const;
+    void setChunk(int chunkX, int chunkZ, const std::vector<int>& data);
+    // The chunk's blocks in place, in the same order. Valid until the chunk is
+    // next written, so only for the thread that owns the world.
+    const int* getChunkBlocks(int chunkX, int chunkZ) const { return chunkData[chunkX + chunkZ * getChunksX()]; }
+
+    // A block value is its type in the low BLOCK_TYPE_BITS, with anything
+    // above that belonging to the type, like the level of a fluid.
+    static constexpr int BLOCK_TYPE_BITS = 8;
+    static int getBlockType(int block) { return block & ((1 << BLOCK_TYPE_BITS) - 1); }
+    // Fluids and air are not solid: nothing collides with them and rays pass through.
+    static bool isSolidBlock(int block)
+    {
+        int type = getBlockType(block);
+        return type != BLOCK_AIR && type != BLOCK_WATER && type != BLOCK_LAVA;
+    }
+
+    int getBlock(int x, int y, int z) const
+    {
+        // Bounds first: the chunk index of a block outside the world is not a chunk.
+        int i = getIndex(x, y, z);
+        return chunkData[getChunkIndex(x, z)][i];
+    }
+    bool isBlockSolid(int x, int y, int z) const { return isSolidBlock(getBlock(x, y, z)); }
     void setBlock(int x, int y, int z, int value);
-    bool isOutOfWorld(int x, int y, int z) const;
+    bool isOutOfWorld(int x, int y, int z) const
+    {
+        return static_cast<unsigned>(x) >= static_cast<unsigned>(WORLD_X) ||
+               static_cast<unsigned>(y) >= static_cast<unsigned>(WORLD_Y) ||
+               static_cast<unsigned>(z) >= static_cast<unsigned>(WORLD_Z);
+    }
+    // No bounds check, for inner loops that have already kept to the world.
+    int getBlockUnchecked(int x, int y, int z) const { return chunkData[getChunkIndex(x, z)][getColumnIndex(x, y, z)]; }
+    bool isBlockSolidUnchecked(int x, int y, int z) const { return isSolidBlock(getBlockUnchecked(x, y, z)); }
+
+    // Main thread only. The snapshot can then be read from any thread without
+    // locking; the next write to the chunk copies it instead.
+    ChunkSnapshot snapshotChunk(int chunkX, int chunkZ) const;
+    uint32_t getChunkVersion(int chunkX, int chunkZ) const { return versions[chunkX + chunkZ * getChunksX()]; }
+    // Points the chunk at a snapshot taken from another World, so a read-only
+    // copy can follow the original. Snapshots older than the chunk are ignored.
+    void adoptChunk(int chunkX, int chunkZ, const ChunkSnapshot& chunk);
+    // Copies the chunk into private memory now if it is shared. Writes to a
+    // private chunk touch nothing outside it, so jobs can then write
+    // different chunks at the same time.
+    void makeChunkPrivate(int chunkX, int chunkZ) { getPrivateChunk(chunkX + chunkZ * getChunksX()); }
+
+    // Writes a box a chunk column at a time. The box runs from min to max
+    // inclusive and is clipped to the world; edit(blocks, span) is called
+    // once per chunk it reaches, with the chunk's blocks in private memory
+    // to change in place. Occupancy and tickable counts are then rebuilt
+    // once for the rows the box covers.
+    template<typename Edit>
+    void editChunks(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, Edit edit)
+    {
+        minX = std::max(minX, 0);
+        minY = std::max(minY, 0);
+        minZ = std::max(minZ, 0);
+        maxX = std::min(maxX, WORLD_X - 1);
+        maxY = std::min(maxY, WORLD_Y - 1);
+        maxZ = std::min(maxZ, WORLD_Z - 1);
+        if (minX > maxX || minY > maxY || minZ > maxZ)
+            return;
+
+        for (int chunkZ = minZ / CHUNK_SIZE; chunkZ <= maxZ / CHUNK_SIZE; chunkZ++)
+        {
+            for (int chunkX = minX / CHUNK_SIZE; chunkX <= maxX / CHUNK_SIZE; chunkX++)
+            {
+                int chunk = chunkX + chunkZ * getChunksX();
+                ChunkSpan span{ chunkX, chunkZ,
+                                std::max(minX - chunkX * CHUNK_SIZE, 0), minY, std::max(minZ - chunkZ * CHUNK_SIZE, 0),
+                                std::min(maxX - chunkX * CHUNK_SIZE, CHUNK_SIZE - 1), maxY,
+                                std::min(maxZ - chunkZ * CHUNK_SIZE, CHUNK_SIZE - 1) };
+                edit(getPrivateChunk(chunk), span);
+                rebuildBricks(chunk, minY, maxY);
+                rebuildTickables(chunk, minY, maxY);
+            }
+        }
+    }
+
+    // Occupancy kept up to date by every write. A brick mask has bit
+    // x + y * 4 + z * 16 set for each solid cell, in brick-local coordinates.
+    bool isChunkEmpty(int chunkX, int chunkZ) const { return occupiedBricks[chunkX + chunkZ * getChunksX()] == 0; }
+    uint64_t getBrickMask(int x, int y, int z) const { return brickMasks[getBrickIndex(x, y, z)]; }
+    // Where the brick holding a block sits in getChunkBrickMasks.
+    int getBrickIndexInChunk(int x, int y, int z) const
+    {
+        const int across = CHUNK_SIZE / BRICK_SIZE;
+        return Brick::toChunkX(Section::toLocalX(x)) + Brick::toChunkY(y) * across +
+               Brick::toChunkZ(Section::toLocalZ(z)) * across * getBricksY();
+    }
+    int getBricksPerChunk() const { return getBricksPerChunk(WORLD_Y); }
+    static constexpr int getBricksPerChunk(int height)
+    {
+        return (CHUNK_SIZE / BRICK_SIZE) * ((height + BRICK_SIZE - 1) / BRICK_SIZE) * (CHUNK_SIZE / BRICK_SIZE);
+    }
+    // A chunk's brick masks in the order WorldSnapshot stores them.
+    const uint64_t* getChunkBrickMasks(int chunkX, int chunkZ) const
+    {
+        return brickMasks.data() + static_cast<size_t>(chunkX + chunkZ * getChunksX()) * getBricksPerChunk();
+    }
+    static constexpr int getBrickBit(int x, int y, int z)
+    {
+        return Brick::getIndex(Brick::toLocalX(x), Brick::toLocalY(y), Brick::toLocalZ(z));
+    }
+
+    // Blocks that do something on a random tick. Each 16x16x16 section of a
+    // chunk column keeps a count of them so sections without any can be
+    // passed over.
+    static bool isTickable(int block) { return block == BLOCK_GRASS; }
+    int getSectionsY() const { return (WORLD_Y + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    int getTickableCount(int chunkX, int sectionY, int chunkZ) const
+    {
+        return tickableCounts[(chunkX + chunkZ * getChunksX()) * getSectionsY() + sectionY];
+    }
+    const int* getChunkTickableCounts(int chunkX, int chunkZ) const
+    {
+        return tickableCounts.data() + static_cast<size_t>(chunkX + chunkZ * getChunksX()) * getSectionsY();
+    }
+
+    bool hasSnapshot() const { return snapshot != nullptr; }
+    int getPrivateChunkCount() const;
+    int getCopyOnWriteCount() const { return copyOnWrites; }
 
 private:
-    int getIndex(int x, int y, int z) const;
+    int getIndex(int x, int y, int z) const
+    {
+        if (isOutOfWorld(x, y, z))
+            throw std::out_of_range("Block coordinates out of bounds");
+        return getColumnIndex(x, y, z);
+    }
+    int getChunkIndex(int x, int z) const { return Section::toChunkX(x) + Section::toChunkZ(z) * chunksX; }
+    int* getPrivateChunk(int chunk);
+
+    int getBricksY() const { return (WORLD_Y + BRICK_SIZE - 1) / BRICK_SIZE; }
+    int getBrickIndex(int x, int y, int z) const
+    {
+        return getChunkIndex(x, z) * getBricksPerChunk() + getBrickIndexInChunk(x, y, z);
+    }
+    void setBrickBit(int x, int y, int z, bool isSolid);
+    // Only the brick rows and sections holding minY to maxY are rescanned.
+    void rebuildBricks(int chunk, int minY = 0, int maxY = -1);
+    void rebuildTickables(int chunk, int minY = 0, int maxY = -1);
 
-    std::vector<int> blocks;
-};
\ No newline at end of file
+    int chunksX;
+    // Distance between consecutive z in a column's blocks.
+    int columnStride;
+    std::shared_ptr<const WorldSnapshot> snapshot;
+    // Each chunk column reads through chunkData, which points either into the
+    // snapshot mapping or at the chunk's entry in privateChunks. A private
+    // chunk shared with a ChunkSnapshot is copied before it is written.
+    std::vector<const int*> chunkData;
+    std::vector<std::shared_ptr<std::vector<int>>> privateChunks;
+    // Owners of adopted chunks, which are read-only like mapped ones.
+    std::vector<std::shared_ptr<const void>> adoptedChunks;
+    std::vector<uint32_t> versions;
+    std::vector<uint64_t> brickMasks;
+    // Bricks with anything solid in them, per chunk.
+    std::vector<int> occupiedBricks;
+    std::vector<int> tickableCounts;
+    int copyOnWrites = 0;
+};
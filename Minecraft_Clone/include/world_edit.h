@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <glm.hpp>
+
+#include "world.h"
+#include "edit_history.h"
+
+// Blocks copied out of the world, in x + y * size.x + z * size.x * size.y order.
+struct Clipboard
+{
+    glm::ivec3 size{ 0 };
+    std::vector<int> blocks;
+};
+
+// Edits on boxes and brush shapes, done a chunk column at a time instead of
+// a block at a time: each chunk is made private once, written a row of x at
+// a time, and has its occupancy rebuilt once. A box that covers a whole
+// chunk column is a single fill. Boxes run from min to max inclusive and
+// are clipped to the world.
+//
+// With a history, every operation is recorded as one undo step, or as part
+// of the step already being recorded.
+class WorldEdit
+{
+public:
+    explicit WorldEdit(World& world, EditHistory* history = nullptr);
+
+    void fill(glm::ivec3 min, glm::ivec3 max, int block);
+    void replace(glm::ivec3 min, glm::ivec3 max, int from, int to);
+    // Walls of block around an inside cleared to air.
+    void hollow(glm::ivec3 min, glm::ivec3 max, int block);
+    void fillSphere(glm::ivec3 centre, int radius, int block);
+
+    // Cells outside the world copy as air.
+    void copy(glm::ivec3 min, glm::ivec3 max, Clipboard& out) const;
+    // Puts the clipboard's min corner at origin. With isAirSkipped, air in
+    // the clipboard leaves the world as it was.
+    void paste(const Clipboard& clipboard, glm::ivec3 origin, bool isAirSkipped = false);
+
+    // Chunk columns written since the last call, once each, for remeshing
+    // and saving.
+    void takeTouchedChunks(std::vector<glm::ivec2>& out);
+
+private:
+    World& world;
+    EditHistory* history;
+    std::vector<char> isTouched;
+    std::vector<glm::ivec2> touched;
+    // The chunk as it was before the edit, for the history to compare against.
+    std::vector<int> before;
+
+    // World::editChunks, marking each chunk touched and recording it.
+    template<typename Edit>
+    void editChunks(glm::ivec3 min, glm::ivec3 max, Edit edit);
+
+    // Calls edit(row, x0, x1, start) for each row of x of the box in every
+    // chunk it reaches. row points at the chunk's block at local x 0, which
+    // is at start in the world, and x0 to x1 are the local cells in the box.
+    // In Morton order row is a copy that is written back afterwards.
+    template<typename Edit>
+    void editRows(glm::ivec3 min, glm::ivec3 max, Edit edit);
+    void fillMorton(int* blocks, const ChunkSpan& span, int block);
+    void touch(int chunkX, int chunkZ);
+};
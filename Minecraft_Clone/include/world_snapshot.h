@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class World;
+
+// Read-only world image that stores every chunk column uncompressed, in the
+// same layout World keeps them in memory. The file is mapped instead of read,
+// so opening it costs the same for any map size and only the chunks that are
+// actually touched get paged in. The brick masks and tickable counts World
+// keeps follow the chunks, so a World opened on the file need not scan them.
+class WorldSnapshot
+{
+public:
+    static constexpr uint32_t MAGIC = 0x4E53434D; // "MCSN"
+    static constexpr uint32_t VERSION = 1;
+    // Padded to a page so every chunk payload starts page aligned.
+    static constexpr size_t HEADER_BYTES = 4096;
+
+    // Returns nullptr if the file does not exist, throws std::runtime_error if it is invalid.
+    static std::shared_ptr<const WorldSnapshot> open(const std::string& path);
+    // Writes to a temporary file first, so a snapshot that is currently mapped is never truncated.
+    static void write(const World& world, const std::string& path);
+
+    ~WorldSnapshot();
+    WorldSnapshot(const WorldSnapshot&) = delete;
+    WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+    int getSizeX() const { return sizeX; }
+    int getSizeY() const { return sizeY; }
+    int getSizeZ() const { return sizeZ; }
+    size_t getMappedBytes() const { return mappedBytes; }
+
+    const int* getChunk(int chunkX, int chunkZ) const;
+    // Every chunk's brick masks, then every chunk's tickable counts per
+    // section, in World's order. Null for snapshots written without them.
+    const uint64_t* getBrickMasks() const { return brickMasks; }
+    const int* getTickableCounts() const { return tickableCounts; }
+
+private:
+    WorldSnapshot() = default;
+
+    void* mapping = nullptr;
+    size_t mappedBytes = 0;
+    int sizeX = 0;
+    int sizeY = 0;
+    int sizeZ = 0;
+    int chunksX = 0;
+    int chunkVolume = 0;
+    const uint64_t* brickMasks = nullptr;
+    const int* tickableCounts = nullptr;
+};
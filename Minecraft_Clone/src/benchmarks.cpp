@@ -0,0 +1,2038 @@
+#include "benchmarks.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "game.h"
+#include "mesher.h"
+#include "region.h"
+#include "edit_journal.h"
+#include "job_system.h"
+#include "entity_system.h"
+#include "spatial_hash.h"
+#include "raycast.h"
+#include "voxel_tree.h"
+#include "block_ticks.h"
+#include "random_ticks.h"
+#include "fluids.h"
+#include "world_edit.h"
+#include "edit_history.h"
+#include "world_snapshot.h"
+#include "occlusion.h"
+#include "upload_ring.h"
+#include "vertex_arena.h"
+
+namespace {
+    // Meshes the chunks around the centre of the map, which is all the first
+    // frame needs before anything can be drawn.
+    void buildFirstFrame(const World& world)
+    {
+        const int radius = 4;
+        int centerX = world.getChunksX() / 2;
+        int centerZ = world.getChunksZ() / 2;
+
+        for (int cz = std::max(0, centerZ - radius); cz < std::min(world.getChunksZ(), centerZ + radius); cz++)
+            for (int cx = std::max(0, centerX - radius); cx < std::min(world.getChunksX(), centerX + radius); cx++)
+                ChunkMesher::build(ChunkMesher::capture(world, cx, cz), 0);
+    }
+}
+
+// Saves maps of growing size in both formats, then prints the time from
+// opening each one to having the first frame meshed.
+void runSnapshotBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int sizes[] = { 128, 512, 1024 };
+    const int height = 32;
+    const std::string dir = "../saves/bench";
+
+    for (int size : sizes)
+    {
+        std::filesystem::remove_all(dir);
+        {
+            World world(size, height, size);
+            WorldStorage(dir + "/regions").save(world);
+            WorldSnapshot::write(world, dir + "/world.snap");
+        }
+
+        auto start = Clock::now();
+        {
+            World world(size, height, size);
+            WorldStorage(dir + "/regions").load(world);
+            buildFirstFrame(world);
+        }
+        double compressedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        {
+            World world(WorldSnapshot::open(dir + "/world.snap"));
+            buildFirstFrame(world);
+        }
+        double mappedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::cout << size << "x" << height << "x" << size << " (" << static_cast<size_t>(size) * height * size * sizeof(int) / (1024 * 1024)
+                  << " MB): compressed " << compressedMs << " ms, mapped " << mappedMs << " ms" << std::endl;
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+// Saves a generated 512x64x512 world of grassy hills over stone with air
+// pockets, and lakes in the hollows, to region files and loads it back
+// into a fresh world. Prints the compression
+// ratio and MB/s of raw blocks each way; the loaded blocks must match.
+bool runRegionBenchmark()
+{
+    const std::string dir = "../saves/bench_region";
+    std::filesystem::remove_all(dir);
+
+    World world(512, 64, 512);
+    std::mt19937 rng(17);
+    std::uniform_int_distribution<int> roll(0, 99);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (size_t i = 0; i < chunk.size(); i++)
+            {
+                int x = cx * World::CHUNK_SIZE + World::getColumnX(static_cast<int>(i));
+                int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                int z = cz * World::CHUNK_SIZE + World::getColumnZ(static_cast<int>(i), world.WORLD_Y);
+                int ground = 32 + static_cast<int>(8.f * std::sin(x * 0.05f) + 8.f * std::cos(z * 0.07f));
+                int block = BLOCK_AIR;
+                if (y < ground - 4)
+                    block = roll(rng) < 3 ? BLOCK_AIR : BLOCK_STONE;
+                else if (y < ground)
+                    block = BLOCK_DIRT;
+                else if (y == ground)
+                    block = BLOCK_GRASS;
+                else if (y < 28)
+                    block = BLOCK_WATER;
+                chunk[i] = block;
+            }
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    WorldStorage saver(dir);
+    saver.save(world);
+    StorageStats saved = saver.getLastSave();
+
+    World loaded(world.WORLD_X, world.WORLD_Y, world.WORLD_Z);
+    WorldStorage loader(dir);
+    bool isLoaded = loader.load(loaded);
+    StorageStats read = loader.getLastLoad();
+
+    bool isExact = isLoaded;
+    std::vector<int> other;
+    for (int cz = 0; cz < world.getChunksZ() && isExact; cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX() && isExact; cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            loaded.getChunk(cx, cz, other);
+            isExact = chunk == other;
+        }
+    }
+
+    std::cout << saved.chunks << " chunks, " << saved.rawBytes / (1024.0 * 1024.0) << " MB raw, "
+              << saved.compressedBytes / (1024.0 * 1024.0) << " MB compressed (x" << saved.ratio() << ")" << std::endl;
+    std::cout << "  save: " << saved.seconds * 1000.0 << " ms, " << saved.megabytesPerSecond() << " MB/s" << std::endl;
+    std::cout << "  load: " << read.seconds * 1000.0 << " ms, " << read.megabytesPerSecond() << " MB/s, "
+              << (isExact ? "exact" : "MISMATCH") << std::endl;
+
+    std::filesystem::remove_all(dir);
+    return isExact;
+}
+
+// Appends edits at growing rates, spread evenly over a second so the
+// writer sees some fifty commit intervals, then prints how many commits
+// per second the group commit made, how many edits each carried and how
+// long replaying the journal takes.
+void runJournalBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int rates[] = { 10000, 100000, 1000000 };
+    const int slices = 1000;
+    const std::string dir = "../saves/bench_journal";
+
+    for (int rate : rates)
+    {
+        std::filesystem::remove_all(dir);
+
+        double seconds;
+        int commits;
+        int largest;
+        int failed;
+        {
+            EditJournal journal(dir);
+            auto start = Clock::now();
+            int appended = 0;
+            for (int slice = 1; slice <= slices; slice++)
+            {
+                for (int end = static_cast<int>(static_cast<long>(rate) * slice / slices); appended < end; appended++)
+                    journal.append(appended % 64, (appended / 64) % 8, (appended / 512) % 64, 1, 0, static_cast<uint32_t>(appended));
+                std::this_thread::sleep_until(start + std::chrono::microseconds(1000000L * slice / slices));
+            }
+            journal.close();
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            commits = journal.getCommits();
+            largest = journal.getLargestBatch();
+            failed = journal.getFailedCommits();
+        }
+
+        ReplayStats stats;
+        {
+            EditJournal journal(dir);
+            stats = journal.replay([](const BlockEdit&) {});
+        }
+
+        std::cout << rate << " edits/s for " << seconds << " s: " << commits / seconds << " commits/s, "
+                  << static_cast<double>(rate) / commits << " edits per commit (largest " << largest << "), "
+                  << failed << " failed, " << stats.edits << " replayed in " << stats.seconds * 1000.0 << " ms" << std::endl;
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+// Edits random blocks for a second while reader threads mesh snapshots of
+// the edited chunks, then prints edit latency next to reader throughput.
+void runCopyOnWriteBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int readerCounts[] = { 0, 1, 2, 4 };
+
+    for (int readers : readerCounts)
+    {
+        World world(256, 32, 256);
+        std::vector<std::unique_ptr<SpscQueue<ChunkNeighbourhood>>> inboxes;
+        std::vector<std::thread> threads;
+        std::atomic<bool> isRunning{ true };
+        std::atomic<long> meshes{ 0 };
+
+        for (int r = 0; r < readers; r++)
+        {
+            inboxes.push_back(std::make_unique<SpscQueue<ChunkNeighbourhood>>(64));
+            threads.emplace_back([&, inbox = inboxes.back().get()] {
+                ChunkNeighbourhood area;
+                while (isRunning)
+                {
+                    if (!inbox->tryPop(area))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    ChunkMesher::build(ChunkMesher::capture(area), 0);
+                    meshes++;
+                }
+            });
+        }
+
+        std::mt19937 rng(42);
+        long edits = 0;
+        double totalNs = 0.0;
+        double maxNs = 0.0;
+        auto end = Clock::now() + std::chrono::seconds(1);
+
+        while (Clock::now() < end)
+        {
+            int x = static_cast<int>(rng() % world.WORLD_X);
+            int y = static_cast<int>(rng() % world.WORLD_Y);
+            int z = static_cast<int>(rng() % world.WORLD_Z);
+
+            auto start = Clock::now();
+            world.setBlock(x, y, z, world.isBlockSolid(x, y, z) ? 0 : 1);
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            totalNs += ns;
+            maxNs = std::max(maxNs, ns);
+            edits++;
+
+            if (readers > 0)
+                inboxes[edits % readers]->tryPush(ChunkMesher::snapshot(world, x / World::CHUNK_SIZE, z / World::CHUNK_SIZE));
+        }
+
+        isRunning = false;
+        for (auto& t : threads)
+            t.join();
+
+        std::cout << readers << " readers: " << edits << " edits/s, edit avg " << totalNs / edits << " ns, max " << maxNs / 1000.0
+                  << " us, " << world.getCopyOnWriteCount() << " copies on write, " << meshes << " meshes/s" << std::endl;
+    }
+}
+
+namespace {
+    // Each node spawns its children into the pool and waits on them, so most of
+    // the tree only reaches other workers by being stolen.
+    void spawnTree(JobSystem& jobs, int depth, int branching)
+    {
+        if (depth == 0)
+        {
+            volatile float sink = 0.f;
+            for (int i = 0; i < 2000; i++)
+                sink = sink + static_cast<float>(i) * 0.5f;
+            return;
+        }
+
+        JobCounter children;
+        for (int i = 0; i < branching; i++)
+            jobs.submit([&jobs, depth, branching] { spawnTree(jobs, depth - 1, branching); }, JobSystem::NORMAL, &children);
+        jobs.wait(children);
+    }
+}
+
+// Runs a synthetic job tree and a full remesh of a large world with every
+// worker count up to the hardware thread count, printing the speedup over one
+// worker and how busy each worker was.
+void runJobBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    World world(256, 32, 256);
+    int maxWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    double baseline[2] = {};
+
+    for (int workers = 1; workers <= maxWorkers; workers *= 2)
+    {
+        JobSystem jobs(workers);
+        double ms[2];
+
+        auto start = Clock::now();
+        {
+            JobCounter root;
+            jobs.submit([&jobs] { spawnTree(jobs, 5, 8); }, JobSystem::NORMAL, &root);
+            jobs.wait(root);
+        }
+        ms[0] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        {
+            JobCounter meshes;
+            for (int cz = 0; cz < world.getChunksZ(); cz++)
+                for (int cx = 0; cx < world.getChunksX(); cx++)
+                    jobs.submit([area = ChunkMesher::snapshot(world, cx, cz)] { ChunkMesher::build(ChunkMesher::capture(area), 0); },
+                                JobSystem::NORMAL, &meshes);
+            jobs.wait(meshes);
+        }
+        ms[1] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        if (workers == 1)
+        {
+            baseline[0] = ms[0];
+            baseline[1] = ms[1];
+        }
+
+        std::cout << workers << " workers: tree " << ms[0] << " ms (x" << baseline[0] / ms[0] << "), meshing "
+                  << ms[1] << " ms (x" << baseline[1] / ms[1] << ")" << std::endl;
+
+        const auto stats = jobs.getWorkerStats();
+        for (size_t i = 0; i < stats.size(); i++)
+            std::cout << "  worker " << i << ": " << stats[i].jobs << " jobs, " << stats[i].steals << " steals, "
+                      << stats[i].utilisation * 100.0 << "% busy" << std::endl;
+    }
+}
+
+// Drops entity crowds of growing size onto a flat floor and times the
+// update per tick, so the cost per entity can be read off each line.
+void runEntityBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int counts[] = { 10000, 30000, 100000 };
+    const int ticks = 120;
+
+    World world(256, 32, 256);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (size_t i = 0; i < chunk.size(); i++)
+                if (World::getColumnY(static_cast<int>(i), world.WORLD_Y) >= 4)
+                    chunk[i] = 0;
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    for (int count : counts)
+    {
+        EntitySystem entities;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> across(1.f, 254.f);
+        std::uniform_real_distribution<float> height(6.f, 30.f);
+        std::uniform_real_distribution<float> drift(-1.f, 1.f);
+
+        for (int i = 0; i < count; i++)
+        {
+            Entity e = entities.create(glm::vec3(across(rng), height(rng), across(rng)), 0.25f, 0.5f);
+            entities.setVelocity(e, glm::vec3(drift(rng), 0.f, drift(rng)));
+        }
+
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+        for (int t = 0; t < ticks; t++)
+        {
+            auto start = Clock::now();
+            entities.update(world, Game::TICK_SECONDS);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+        }
+
+        std::cout << count << " entities: tick avg " << totalMs / ticks << " ms, max " << maxMs << " ms, "
+                  << totalMs * 1e6 / ticks / count << " ns per entity, " << entities.getGroundedCount() << " grounded" << std::endl;
+    }
+}
+
+// Builds the broadphase over entity-sized boxes packed at several densities
+// and times the build, pair search and queries. For the smaller crowd the
+// pairs are also found by testing every box against every other, both to
+// check the count and to show what the grid saves.
+void runBroadphaseBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int counts[] = { 10000, 100000 };
+    const float spreads[] = { 256.f, 64.f, 16.f };
+    const int queries = 10000;
+
+    for (int count : counts)
+    {
+        for (float spread : spreads)
+        {
+            std::mt19937 rng(42);
+            std::uniform_real_distribution<float> across(0.f, spread);
+            std::uniform_real_distribution<float> height(0.f, 32.f);
+
+            std::vector<Aabb> boxes(count);
+            for (Aabb& box : boxes)
+            {
+                glm::vec3 feet(across(rng), height(rng), across(rng));
+                box = { feet - glm::vec3(0.3f, 0.f, 0.3f), feet + glm::vec3(0.3f, 1.8f, 0.3f) };
+            }
+
+            SpatialHash hash;
+            hash.build(boxes);
+            auto start = Clock::now();
+            hash.build(boxes);
+            double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            std::vector<std::pair<uint32_t, uint32_t>> pairs;
+            start = Clock::now();
+            hash.findPairs(pairs);
+            double pairMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            std::vector<uint32_t> found;
+            size_t boxHits = 0;
+            start = Clock::now();
+            for (int q = 0; q < queries; q++)
+            {
+                glm::vec3 centre(across(rng), height(rng), across(rng));
+                hash.queryAabb({ centre - 1.f, centre + 1.f }, found);
+                boxHits += found.size();
+            }
+            double boxUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+
+            size_t radiusHits = 0;
+            start = Clock::now();
+            for (int q = 0; q < queries; q++)
+            {
+                hash.queryRadius(glm::vec3(across(rng), height(rng), across(rng)), 2.f, found);
+                radiusHits += found.size();
+            }
+            double radiusUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+
+            std::cout << count << " boxes over " << spread << "x32x" << spread << ": build " << buildMs << " ms, pairs "
+                      << pairMs << " ms (" << pairs.size() << "), box query " << boxUs << " us (" << boxHits / queries
+                      << " hits), radius query " << radiusUs << " us (" << radiusHits / queries << " hits), "
+                      << hash.getCellCount() << " cells, max " << hash.getMaxCellOccupancy() << std::endl;
+
+            if (count <= 10000)
+            {
+                size_t brute = 0;
+                start = Clock::now();
+                for (int a = 0; a < count; a++)
+                    for (int b = a + 1; b < count; b++)
+                        brute += boxes[a].overlaps(boxes[b]);
+                double bruteMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                std::cout << "  all against all: " << bruteMs << " ms (" << brute << " pairs)" << std::endl;
+            }
+        }
+    }
+}
+
+// Runs one crowded scene on a single thread and then over job systems of
+// growing size. Every run has to end in exactly the same state as the
+// single-threaded one, bit for bit; the times show how the update scales.
+void runPhysicsBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int count = 50000;
+    const int ticks = 120;
+
+    World world(256, 32, 256);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (size_t i = 0; i < chunk.size(); i++)
+                if (World::getColumnY(static_cast<int>(i), world.WORLD_Y) >= 4)
+                    chunk[i] = 0;
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    auto simulate = [&](JobSystem* jobs, double& msPerTick) {
+        EntitySystem entities;
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> across(96.f, 160.f);
+        std::uniform_real_distribution<float> height(4.f, 30.f);
+        std::uniform_real_distribution<float> drift(-2.f, 2.f);
+        for (int i = 0; i < count; i++)
+        {
+            Entity e = entities.create(glm::vec3(across(rng), height(rng), across(rng)), 0.3f, 0.9f);
+            entities.setVelocity(e, glm::vec3(drift(rng), 0.f, drift(rng)));
+        }
+
+        auto start = Clock::now();
+        for (int t = 0; t < ticks; t++)
+            entities.update(world, Game::TICK_SECONDS, jobs);
+        msPerTick = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ticks;
+
+        std::vector<glm::vec3> state;
+        for (Entity e = 0; e < static_cast<Entity>(count); e++)
+        {
+            state.push_back(entities.getPosition(e));
+            state.push_back(entities.getVelocity(e));
+        }
+        return state;
+    };
+
+    double baseline;
+    std::vector<glm::vec3> expected = simulate(nullptr, baseline);
+    std::cout << count << " entities, 1 thread: " << baseline << " ms per tick" << std::endl;
+
+    int maxWorkers = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int workers = 1; workers <= maxWorkers; workers *= 2)
+    {
+        JobSystem jobs(workers);
+        double ms;
+        std::vector<glm::vec3> state = simulate(&jobs, ms);
+        bool isIdentical = std::memcmp(state.data(), expected.data(), state.size() * sizeof(glm::vec3)) == 0;
+
+        std::cout << workers << " workers: " << ms << " ms per tick (x" << baseline / ms << "), "
+                  << (isIdentical ? "identical" : "DIFFERENT") << " final state" << std::endl;
+    }
+}
+
+// Casts a million random rays through open terrain and through a solid
+// world full of caves: as a single batch with empty-space skipping off and
+// on, and a ray per call. Prints rays per second on this thread and steps
+// per ray for each. All three must agree, and the batch must be at least as
+// fast as a ray per call.
+bool runRaycastBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int rays = 1000000;
+    const float maxDistance = 64.f;
+    bool isPassing = true;
+
+    for (int terrain = 0; terrain < 2; terrain++)
+    {
+        World world(256, 64, 256);
+        std::mt19937 rng(11);
+        std::vector<glm::vec3> origins(rays);
+        std::vector<glm::vec3> directions(rays);
+        std::normal_distribution<float> gaussian;
+        for (glm::vec3& d : directions)
+            d = glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng));
+
+        std::vector<int> chunk;
+        if (terrain == 0)
+        {
+            // Rolling ground up to y 24 with the rays starting in the air above it.
+            for (int cz = 0; cz < world.getChunksZ(); cz++)
+            {
+                for (int cx = 0; cx < world.getChunksX(); cx++)
+                {
+                    world.getChunk(cx, cz, chunk);
+                    for (size_t i = 0; i < chunk.size(); i++)
+                    {
+                        int x = cx * World::CHUNK_SIZE + World::getColumnX(static_cast<int>(i));
+                        int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                        int z = cz * World::CHUNK_SIZE + World::getColumnZ(static_cast<int>(i), world.WORLD_Y);
+                        chunk[i] = y < 16 + static_cast<int>(4.f * std::sin(x * 0.1f) + 4.f * std::cos(z * 0.13f));
+                    }
+                    world.setChunk(cx, cz, chunk);
+                }
+            }
+
+            std::uniform_real_distribution<float> across(0.f, 256.f);
+            std::uniform_real_distribution<float> height(26.f, 63.f);
+            for (glm::vec3& o : origins)
+                o = glm::vec3(across(rng), height(rng), across(rng));
+        }
+        else
+        {
+            // Solid rock with spherical caves, rays starting at cave centres.
+            std::uniform_int_distribution<int> across(6, 249);
+            std::uniform_int_distribution<int> depth(6, 57);
+            std::uniform_int_distribution<int> radius(2, 5);
+            std::vector<glm::ivec3> caves(4000);
+            for (glm::ivec3& cave : caves)
+            {
+                cave = glm::ivec3(across(rng), depth(rng), across(rng));
+                int r = radius(rng);
+                for (int x = -r; x <= r; x++)
+                    for (int y = -r; y <= r; y++)
+                        for (int z = -r; z <= r; z++)
+                            if (x * x + y * y + z * z <= r * r)
+                                world.setBlock(cave.x + x, cave.y + y, cave.z + z, 0);
+            }
+
+            std::uniform_int_distribution<size_t> pick(0, caves.size() - 1);
+            for (glm::vec3& o : origins)
+                o = glm::vec3(caves[pick(rng)]);
+        }
+
+        // Skipping off is the plain cell-by-cell walk reading blocks.
+        VoxelRaycaster walked;
+        RaycastResults reference;
+        walked.setEmptySpaceSkipping(false);
+        auto start = Clock::now();
+        walked.cast(world, origins, directions, maxDistance, reference);
+        double walkSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        VoxelRaycaster batched;
+        RaycastResults batch;
+        start = Clock::now();
+        batched.cast(world, origins, directions, maxDistance, batch);
+        double batchSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        auto differs = [](const RaycastResults& a, size_t i, const RaycastResults& b, size_t j) {
+            return a.isHit[i] != b.isHit[j] ||
+                   (a.isHit[i] && (a.cells[i] != b.cells[j] || a.faces[i] != b.faces[j] || a.distances[i] != b.distances[j]));
+        };
+
+        VoxelRaycaster single;
+        RaycastResults one;
+        RaycastResults singles;
+        singles.resize(rays);
+        std::vector<glm::vec3> origin(1), direction(1);
+        start = Clock::now();
+        for (int i = 0; i < rays; i++)
+        {
+            origin[0] = origins[i];
+            direction[0] = directions[i];
+            single.cast(world, origin, direction, maxDistance, one);
+            singles.isHit[i] = one.isHit[0];
+            singles.cells[i] = one.cells[0];
+            singles.faces[i] = one.faces[0];
+            singles.distances[i] = one.distances[0];
+        }
+        double singleSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        int mismatches = 0;
+        long hits = 0;
+        for (int i = 0; i < rays; i++)
+        {
+            mismatches += differs(singles, i, batch, i) + differs(reference, i, batch, i);
+            hits += batch.isHit[i];
+        }
+        bool isBatchFaster = batchSeconds <= singleSeconds;
+        isPassing = isPassing && mismatches == 0 && isBatchFaster;
+
+        std::cout << (terrain == 0 ? "open" : "caves") << ": " << hits * 100.0 / rays << "% hit, " << mismatches << " mismatches" << std::endl;
+        std::cout << "  skipping off: " << rays / walkSeconds / 1e6 << "M rays/s, " << walkSeconds * 1e9 / rays << " ns per ray, "
+                  << static_cast<double>(walked.getStepCount()) / rays << " steps per ray, "
+                  << static_cast<double>(walked.getChunkSwitches()) / rays << " chunk switches per ray" << std::endl;
+        std::cout << "  skipping on: " << rays / batchSeconds / 1e6 << "M rays/s, " << batchSeconds * 1e9 / rays << " ns per ray, "
+                  << static_cast<double>(batched.getStepCount()) / rays << " steps per ray, "
+                  << static_cast<double>(batched.getChunkSkips()) / rays << " chunk and "
+                  << static_cast<double>(batched.getBrickSkips()) / rays << " brick jumps per ray" << std::endl;
+        std::cout << "  one ray per call: " << rays / singleSeconds / 1e6 << "M rays/s"
+                  << (isBatchFaster ? "" : ", FAILED: faster than the batch") << std::endl;
+    }
+
+    std::cout << (isPassing ? "passed" : "FAILED") << std::endl;
+    return isPassing;
+}
+
+// Copies a region-sized world into a VoxelTree, once all solid and once as
+// hilly ground with caves under it, and compares memory with the flat chunk
+// arrays and with 16x16x16 palette sections (an index per cell, just wide
+// enough for the section's distinct blocks, plus the palette). Then times
+// point lookups and 8x8x8 box scans on both.
+void runVoxelTreeBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int queries = 4000000;
+    const int boxes = 100000;
+
+    for (int terrain = 0; terrain < 2; terrain++)
+    {
+        World world(512, 128, 512);
+        std::mt19937 rng(5);
+        if (terrain == 1)
+        {
+            std::vector<int> chunk;
+            for (int cz = 0; cz < world.getChunksZ(); cz++)
+            {
+                for (int cx = 0; cx < world.getChunksX(); cx++)
+                {
+                    world.getChunk(cx, cz, chunk);
+                    for (size_t i = 0; i < chunk.size(); i++)
+                    {
+                        int x = cx * World::CHUNK_SIZE + World::getColumnX(static_cast<int>(i));
+                        int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                        int z = cz * World::CHUNK_SIZE + World::getColumnZ(static_cast<int>(i), world.WORLD_Y);
+                        chunk[i] = y < 64 + static_cast<int>(8.f * std::sin(x * 0.05f) + 8.f * std::cos(z * 0.07f));
+                    }
+                    world.setChunk(cx, cz, chunk);
+                }
+            }
+
+            std::uniform_int_distribution<int> across(8, 503);
+            std::uniform_int_distribution<int> depth(8, 50);
+            std::uniform_int_distribution<int> radius(2, 6);
+            for (int cave = 0; cave < 3000; cave++)
+            {
+                glm::ivec3 centre(across(rng), depth(rng), across(rng));
+                int r = radius(rng);
+                for (int x = -r; x <= r; x++)
+                    for (int y = -r; y <= r; y++)
+                        for (int z = -r; z <= r; z++)
+                            if (x * x + y * y + z * z <= r * r)
+                                world.setBlock(centre.x + x, centre.y + y, centre.z + z, 0);
+            }
+        }
+
+        VoxelTree tree(world.WORLD_X, world.WORLD_Y, world.WORLD_Z);
+        std::vector<int> chunk, back;
+        size_t paletteBytes = 0;
+        int roundTripErrors = 0;
+
+        auto start = Clock::now();
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                tree.setChunk(cx, cz, chunk);
+            }
+        }
+        double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                tree.getChunk(cx, cz, back);
+                world.getChunk(cx, cz, chunk);
+                roundTripErrors += back != chunk;
+            }
+        }
+        double readMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                for (int sy = 0; sy < world.WORLD_Y; sy += World::CHUNK_SIZE)
+                {
+                    std::vector<int> distinct;
+                    for (int z = 0; z < World::CHUNK_SIZE; z++)
+                        for (int y = sy; y < std::min(sy + World::CHUNK_SIZE, world.WORLD_Y); y++)
+                            for (int x = 0; x < World::CHUNK_SIZE; x++)
+                                if (std::find(distinct.begin(), distinct.end(), chunk[world.getColumnIndex(x, y, z)]) == distinct.end())
+                                    distinct.push_back(chunk[world.getColumnIndex(x, y, z)]);
+
+                    int bits = 0;
+                    while ((1u << bits) < distinct.size())
+                        bits++;
+                    paletteBytes += World::CHUNK_SIZE * World::CHUNK_SIZE * World::CHUNK_SIZE * bits / 8 + distinct.size() * sizeof(int);
+                }
+            }
+        }
+
+        std::uniform_int_distribution<int> pickX(0, world.WORLD_X - 1);
+        std::uniform_int_distribution<int> pickY(0, world.WORLD_Y - 1);
+        std::uniform_int_distribution<int> pickZ(0, world.WORLD_Z - 1);
+        std::vector<glm::ivec3> points(queries);
+        for (glm::ivec3& p : points)
+            p = glm::ivec3(pickX(rng), pickY(rng), pickZ(rng));
+
+        long worldSum = 0;
+        start = Clock::now();
+        for (const glm::ivec3& p : points)
+            worldSum += world.getBlock(p.x, p.y, p.z);
+        double worldPointNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+
+        long treeSum = 0;
+        start = Clock::now();
+        for (const glm::ivec3& p : points)
+            treeSum += tree.getBlock(p.x, p.y, p.z);
+        double treePointNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queries;
+
+        long worldSolid = 0;
+        start = Clock::now();
+        for (int b = 0; b < boxes; b++)
+        {
+            const glm::ivec3& p = points[b];
+            for (int z = p.z; z < std::min(p.z + 8, world.WORLD_Z); z++)
+                for (int y = p.y; y < std::min(p.y + 8, world.WORLD_Y); y++)
+                    for (int x = p.x; x < std::min(p.x + 8, world.WORLD_X); x++)
+                        worldSolid += world.isBlockSolid(x, y, z);
+        }
+        double worldBoxUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / boxes;
+
+        long treeSolid = 0;
+        long treeRuns = 0;
+        start = Clock::now();
+        for (int b = 0; b < boxes; b++)
+        {
+            const glm::ivec3& p = points[b];
+            glm::ivec3 hi = glm::min(p + 7, glm::ivec3(world.WORLD_X, world.WORLD_Y, world.WORLD_Z) - 1);
+            tree.forEachInBox(p, hi, [&](glm::ivec3 min, glm::ivec3 max, int block) {
+                glm::ivec3 size = max - min + 1;
+                treeSolid += block != 0 ? static_cast<long>(size.x) * size.y * size.z : 0;
+                treeRuns++;
+            });
+        }
+        double treeBoxUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / boxes;
+
+        size_t flatBytes = static_cast<size_t>(world.getChunksX()) * world.getChunksZ() * world.getChunkVolume() * sizeof(int);
+        std::cout << (terrain == 0 ? "solid" : "terrain") << " " << world.WORLD_X << "x" << world.WORLD_Y << "x" << world.WORLD_Z
+                  << ": " << roundTripErrors << " round trip errors, "
+                  << (worldSum == treeSum && worldSolid == treeSolid ? "queries agree" : "QUERIES DIFFER") << std::endl;
+        std::cout << "  memory: chunk arrays " << flatBytes / 1024 << " KB, palette sections " << paletteBytes / 1024
+                  << " KB, tree " << tree.getMemoryBytes() / 1024 << " KB (" << tree.getNodeCount() << " nodes)" << std::endl;
+        std::cout << "  conversion: " << buildMs << " ms from chunks, " << readMs << " ms back" << std::endl;
+        std::cout << "  point query: " << worldPointNs << " ns chunk arrays, " << treePointNs << " ns tree" << std::endl;
+        std::cout << "  8x8x8 box: " << worldBoxUs << " us chunk arrays, " << treeBoxUs << " us tree ("
+                  << static_cast<double>(treeRuns) / boxes << " uniform boxes each)" << std::endl;
+    }
+}
+
+// Schedules a million block ticks over a 512x64x512 world, due anywhere in
+// the next 20 minutes, then runs every simulation tick until all have fired.
+// Prints the cost of scheduling, of saving and restoring every chunk's
+// pending ticks, and of dispatch per simulation tick. Each tick must fire on
+// exactly the tick it was due, in the restored copy too.
+void runBlockTickBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int count = 1000000;
+    const uint32_t longest = 20 * 60 * Game::TICK_RATE;
+
+    BlockTicks ticks(512, 64, 512);
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> across(0, 511);
+    std::uniform_int_distribution<int> height(0, 63);
+    std::uniform_int_distribution<uint32_t> delay(1, longest);
+
+    std::vector<glm::ivec3> cells(count);
+    std::vector<uint32_t> delays(count);
+    std::vector<int> expected(longest + 1, 0);
+    for (int i = 0; i < count; i++)
+    {
+        cells[i] = glm::ivec3(across(rng), height(rng), across(rng));
+        delays[i] = delay(rng);
+        expected[delays[i]]++;
+    }
+
+    auto start = Clock::now();
+    for (int i = 0; i < count; i++)
+        ticks.schedule(cells[i].x, cells[i].y, cells[i].z, delays[i]);
+    double scheduleNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+    BlockTicks restored(512, 64, 512);
+    std::vector<PendingTick> pending;
+    start = Clock::now();
+    for (int cz = 0; cz < 32; cz++)
+    {
+        for (int cx = 0; cx < 32; cx++)
+        {
+            ticks.getPending(cx, cz, pending);
+            restored.setPending(cx, cz, pending);
+        }
+    }
+    double restoreMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << count << " pending in " << ticks.getActiveChunkCount() << " chunks: schedule " << scheduleNs
+              << " ns each, save and restore all " << restoreMs << " ms (" << restored.getPendingCount() << " restored)" << std::endl;
+
+    for (BlockTicks* run : { &ticks, &restored })
+    {
+        std::vector<glm::ivec3> due;
+        int late = 0;
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+        for (uint32_t tick = 1; tick <= longest; tick++)
+        {
+            start = Clock::now();
+            run->advance(due);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+            late += static_cast<int>(due.size()) != expected[tick];
+        }
+
+        std::cout << (run == &ticks ? "original" : "restored") << ": " << run->getDispatchedCount() << " run, "
+                  << run->getPendingCount() << " left, " << late << " ticks with the wrong count due, dispatch avg "
+                  << totalMs / longest << " ms, max " << maxMs << " ms per simulation tick ("
+                  << static_cast<double>(count) / longest << " due per tick)" << std::endl;
+    }
+}
+
+// Runs the random tick pass over a 512x64x512 world with no grass, with the
+// usual grass top, and with grass in every section, then scrapes the grass
+// off a 128x128 patch and counts how much of it has grown back after a
+// simulated minute.
+void runRandomTickBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int ticks = 600;
+
+    for (int layout = 0; layout < 3; layout++)
+    {
+        World world(512, 64, 512);
+        std::vector<int> chunk;
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                for (size_t i = 0; i < chunk.size(); i++)
+                {
+                    int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                    if (layout == 0)
+                        chunk[i] = BLOCK_DIRT;
+                    else if (layout == 2 && y % World::CHUNK_SIZE == World::CHUNK_SIZE - 1)
+                        chunk[i] = BLOCK_GRASS;
+                }
+                world.setChunk(cx, cz, chunk);
+            }
+        }
+
+        RandomTicks random;
+        std::vector<BlockChange> changes;
+        long changed = 0;
+        auto start = Clock::now();
+        for (int t = 0; t < ticks; t++)
+        {
+            random.run(world, changes);
+            for (const BlockChange& change : changes)
+                world.setBlock(change.cell.x, change.cell.y, change.cell.z, change.value);
+            changed += static_cast<long>(changes.size());
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ticks;
+
+        const char* names[] = { "no grass", "grass on top", "grass in every section" };
+        std::cout << names[layout] << ": " << ms << " ms per tick, " << random.getSectionsTicked() << " sections ticked, "
+                  << random.getSectionsSkipped() << " skipped, " << random.getBlocksTicked() << " blocks ticked, "
+                  << static_cast<double>(changed) / ticks << " changes per tick" << std::endl;
+
+        if (layout != 1)
+            continue;
+
+        // The top layer of the patch goes, leaving bare dirt one lower.
+        for (int x = 192; x < 320; x++)
+            for (int z = 192; z < 320; z++)
+                world.setBlock(x, world.WORLD_Y - 1, z, BLOCK_AIR);
+
+        for (int t = 0; t < 60 * Game::TICK_RATE; t++)
+        {
+            random.run(world, changes);
+            for (const BlockChange& change : changes)
+                world.setBlock(change.cell.x, change.cell.y, change.cell.z, change.value);
+        }
+
+        int regrown = 0;
+        for (int x = 192; x < 320; x++)
+            for (int z = 192; z < 320; z++)
+                regrown += world.getBlock(x, world.WORLD_Y - 2, z) == BLOCK_GRASS;
+        std::cout << "  scraped 128x128 patch: " << regrown * 100.0 / (128 * 128) << "% grass again after a minute" << std::endl;
+    }
+}
+
+// Floods a 256x64x256 block of rock cut through by worm tunnels from water
+// and lava sources dropped into the tunnels, stepping until the fluids
+// settle. Prints the cost per step and how much of the world each step
+// touched, on this thread and on the job system, whose final world must
+// match the single-threaded one block for block.
+void runFluidBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int maxSteps = 4000;
+
+    auto makeCaves = []() {
+        World world(256, 64, 256);
+        std::vector<int> chunk;
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                std::fill(chunk.begin(), chunk.end(), static_cast<int>(BLOCK_STONE));
+                world.setChunk(cx, cz, chunk);
+            }
+        }
+
+        std::mt19937 rng(17);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        for (int worm = 0; worm < 80; worm++)
+        {
+            glm::vec3 p(128.f + 100.f * unit(rng), 32.f + 24.f * unit(rng), 128.f + 100.f * unit(rng));
+            glm::vec3 heading(unit(rng), 0.3f * unit(rng), unit(rng));
+            for (int s = 0; s < 160; s++)
+            {
+                heading = glm::normalize(heading + 0.4f * glm::vec3(unit(rng), 0.5f * unit(rng), unit(rng)));
+                p = glm::clamp(p + heading, glm::vec3(4.f), glm::vec3(251.f, 59.f, 251.f));
+
+                const int r = 2;
+                for (int z = -r; z <= r; z++)
+                    for (int y = -r; y <= r; y++)
+                        for (int x = -r; x <= r; x++)
+                            if (x * x + y * y + z * z <= r * r + 1)
+                                world.setBlock(static_cast<int>(p.x) + x, static_cast<int>(p.y) + y, static_cast<int>(p.z) + z, BLOCK_AIR);
+            }
+        }
+
+        std::uniform_int_distribution<int> across(0, 255);
+        std::uniform_int_distribution<int> height(0, 63);
+        for (int placed = 0; placed < 400;)
+        {
+            int x = across(rng), y = height(rng), z = across(rng);
+            if (world.getBlock(x, y, z) != BLOCK_AIR)
+                continue;
+
+            int type = placed % 4 == 3 ? BLOCK_LAVA : BLOCK_WATER;
+            world.setBlock(x, y, z, FluidSimulator::makeFluid(type, FluidSimulator::SOURCE_LEVEL));
+            placed++;
+        }
+        return world;
+    };
+
+    auto flood = [&](JobSystem* jobs, std::vector<int>& blocks) {
+        World world = makeCaves();
+        FluidSimulator fluids(world.WORLD_X, world.WORLD_Y, world.WORLD_Z);
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+                fluids.activateChunk(world, cx, cz);
+
+        int steps = 0;
+        double longest = 0.0;
+        long cells = 0;
+        long changed = 0;
+        long remeshed = 0;
+        auto start = Clock::now();
+        while (steps < maxSteps && fluids.getQueuedCount() > 0)
+        {
+            auto stepStart = Clock::now();
+            fluids.step(world, jobs);
+            longest = std::max(longest, std::chrono::duration<double, std::milli>(Clock::now() - stepStart).count());
+            cells += static_cast<long>(fluids.getSteppedCount());
+            changed += static_cast<long>(fluids.getChangedCount());
+            remeshed += static_cast<long>(fluids.getChangedChunks().size());
+            steps++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / std::max(steps, 1);
+
+        long fluid = 0;
+        blocks.clear();
+        std::vector<int> chunk;
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                for (int block : chunk)
+                    fluid += FluidSimulator::isFluid(block);
+                blocks.insert(blocks.end(), chunk.begin(), chunk.end());
+            }
+        }
+
+        std::cout << steps << " steps" << (steps == maxSteps ? " (not settled)" : "") << ", avg " << ms << " ms, max "
+                  << longest << " ms, " << static_cast<double>(cells) / steps << " cells, "
+                  << static_cast<double>(changed) / steps << " changes and " << static_cast<double>(remeshed) / steps
+                  << " of " << world.getChunksX() * world.getChunksZ() << " chunks remeshed per step, "
+                  << fluid << " fluid blocks at the end";
+        return ms;
+    };
+
+    std::vector<int> expected;
+    std::cout << "1 thread: ";
+    double baseline = flood(nullptr, expected);
+    std::cout << std::endl;
+
+    int maxWorkers = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int workers = 1; workers <= maxWorkers; workers *= 2)
+    {
+        JobSystem jobs(workers);
+        std::vector<int> blocks;
+        std::cout << workers << " workers: ";
+        double ms = flood(&jobs, blocks);
+        bool isIdentical = blocks == expected;
+        std::cout << " (x" << baseline / ms << "), " << (isIdentical ? "identical" : "DIFFERENT") << " final world" << std::endl;
+    }
+}
+
+// Runs each bulk edit on a 256x256x256 world and the same edit a block at a
+// time through World::setBlock on a second one: a fill of the whole world,
+// a fill that is not chunk aligned, a sphere, a replace, a hollow box and a
+// copy and paste. Prints both times and checks the two worlds still match,
+// occupancy included.
+void runWorldEditBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int size = 256;
+    World perBlock(size, size, size);
+    World bulk(size, size, size);
+    WorldEdit edit(bulk);
+    std::vector<glm::ivec2> touched;
+
+    auto isSame = [&]() {
+        for (int cz = 0; cz < perBlock.getChunksZ(); cz++)
+            for (int cx = 0; cx < perBlock.getChunksX(); cx++)
+                if (std::memcmp(perBlock.getChunkBlocks(cx, cz), bulk.getChunkBlocks(cx, cz), perBlock.getChunkVolume() * sizeof(int)) != 0 ||
+                    perBlock.isChunkEmpty(cx, cz) != bulk.isChunkEmpty(cx, cz))
+                    return false;
+
+        for (int z = 0; z < size; z += World::BRICK_SIZE)
+            for (int y = 0; y < size; y += World::BRICK_SIZE)
+                for (int x = 0; x < size; x += World::BRICK_SIZE)
+                    if (perBlock.getBrickMask(x, y, z) != bulk.getBrickMask(x, y, z))
+                        return false;
+
+        for (int cz = 0; cz < perBlock.getChunksZ(); cz++)
+            for (int cx = 0; cx < perBlock.getChunksX(); cx++)
+                for (int sy = 0; sy < perBlock.getSectionsY(); sy++)
+                    if (perBlock.getTickableCount(cx, sy, cz) != bulk.getTickableCount(cx, sy, cz))
+                        return false;
+        return true;
+    };
+
+    auto forEachCell = [](glm::ivec3 min, glm::ivec3 max, auto visit) {
+        for (int z = min.z; z <= max.z; z++)
+            for (int y = min.y; y <= max.y; y++)
+                for (int x = min.x; x <= max.x; x++)
+                    visit(glm::ivec3(x, y, z));
+    };
+
+    auto compare = [&](const char* name, auto runPerBlock, auto runBulk) {
+        auto start = Clock::now();
+        runPerBlock();
+        double perBlockMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        runBulk();
+        double bulkMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        edit.takeTouchedChunks(touched);
+
+        std::cout << name << ": per block " << perBlockMs << " ms, bulk " << bulkMs << " ms (x" << perBlockMs / bulkMs << "), "
+                  << touched.size() << " chunks to remesh, " << (isSame() ? "identical" : "DIFFERENT") << std::endl;
+    };
+
+    glm::ivec3 all(size - 1);
+    compare("fill 256^3", [&] {
+        forEachCell(glm::ivec3(0), all, [&](glm::ivec3 p) { perBlock.setBlock(p.x, p.y, p.z, BLOCK_STONE); });
+    }, [&] { edit.fill(glm::ivec3(0), all, BLOCK_STONE); });
+
+    glm::ivec3 min(3, 5, 7), max(250, 200, 243);
+    compare("fill unaligned", [&] {
+        forEachCell(min, max, [&](glm::ivec3 p) { perBlock.setBlock(p.x, p.y, p.z, BLOCK_DIRT); });
+    }, [&] { edit.fill(min, max, BLOCK_DIRT); });
+
+    glm::ivec3 centre(128, 120, 128);
+    const int radius = 90;
+    compare("sphere r90", [&] {
+        forEachCell(centre - radius, centre + radius, [&](glm::ivec3 p) {
+            glm::ivec3 d = p - centre;
+            if (d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius && !perBlock.isOutOfWorld(p.x, p.y, p.z))
+                perBlock.setBlock(p.x, p.y, p.z, BLOCK_GRASS);
+        });
+    }, [&] { edit.fillSphere(centre, radius, BLOCK_GRASS); });
+
+    compare("replace 256^3", [&] {
+        forEachCell(glm::ivec3(0), all, [&](glm::ivec3 p) {
+            if (perBlock.getBlock(p.x, p.y, p.z) == BLOCK_DIRT)
+                perBlock.setBlock(p.x, p.y, p.z, BLOCK_AIR);
+        });
+    }, [&] { edit.replace(glm::ivec3(0), all, BLOCK_DIRT, BLOCK_AIR); });
+
+    glm::ivec3 hollowMin(20, 30, 40), hollowMax(200, 180, 220);
+    compare("hollow box", [&] {
+        forEachCell(hollowMin, hollowMax, [&](glm::ivec3 p) {
+            bool isWall = glm::any(glm::equal(p, hollowMin)) || glm::any(glm::equal(p, hollowMax));
+            perBlock.setBlock(p.x, p.y, p.z, isWall ? BLOCK_STONE : BLOCK_AIR);
+        });
+    }, [&] { edit.hollow(hollowMin, hollowMax, BLOCK_STONE); });
+
+    glm::ivec3 from(0, 100, 0), to(127, 227, 127), origin(100, 60, 90);
+    compare("copy and paste 128^3", [&] {
+        std::vector<int> copied;
+        forEachCell(from, to, [&](glm::ivec3 p) { copied.push_back(perBlock.getBlock(p.x, p.y, p.z)); });
+        size_t i = 0;
+        forEachCell(origin, origin + (to - from), [&](glm::ivec3 p) {
+            int block = copied[i++];
+            if (!perBlock.isOutOfWorld(p.x, p.y, p.z))
+                perBlock.setBlock(p.x, p.y, p.z, block);
+        });
+    }, [&] {
+        Clipboard clipboard;
+        edit.copy(from, to, clipboard);
+        edit.paste(clipboard, origin);
+    });
+}
+
+// Records bulk edits on a 256x256x256 world in an undo history, then undoes
+// and redoes each one, checking the world comes back to the same blocks
+// either way. Prints blocks per second for applying, undoing and redoing
+// and what each step costs in the history, in all and per changed block. Then records single-block steps
+// like the player's under a small cap to show the oldest being dropped.
+void runEditHistoryBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int size = 256;
+    World world(size, size, size);
+    EditHistory history(world.WORLD_Y);
+    WorldEdit edit(world, &history);
+    std::vector<glm::ivec2> touched;
+
+    auto capture = [&world](std::vector<int>& out) {
+        out.clear();
+        std::vector<int> chunk;
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                out.insert(out.end(), chunk.begin(), chunk.end());
+            }
+        }
+    };
+
+    auto run = [&](const char* name, auto apply) {
+        std::vector<int> before, after, check;
+        capture(before);
+
+        size_t bytes = history.getBytes();
+        auto start = Clock::now();
+        apply();
+        double applyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        bytes = history.getBytes() - bytes;
+        capture(after);
+
+        long changed = 0;
+        for (size_t i = 0; i < before.size(); i++)
+            changed += before[i] != after[i];
+
+        start = Clock::now();
+        history.undo(world, touched);
+        double undoMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        capture(check);
+        bool isUndone = check == before;
+
+        start = Clock::now();
+        history.redo(world, touched);
+        double redoMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        capture(check);
+        bool isRedone = check == after;
+
+        auto rate = [changed](double ms) { return changed / ms / 1000.0; };
+        std::cout << name << ": " << changed << " blocks, apply " << applyMs << " ms (" << rate(applyMs) << " M/s), undo "
+                  << undoMs << " ms (" << rate(undoMs) << " M/s), redo " << redoMs << " ms (" << rate(redoMs) << " M/s), "
+                  << bytes / 1024.0 << " KB in history (" << changed * sizeof(int) / 1024.0 << " KB of blocks, "
+                  << static_cast<double>(bytes) / changed << " bytes per changed block), "
+                  << touched.size() << " chunks, " << (isUndone && isRedone ? "exact" : "MISMATCH") << std::endl;
+    };
+
+    run("sphere r62", [&] { edit.fillSphere(glm::ivec3(128), 62, BLOCK_STONE); });
+    run("fill 256^3", [&] { edit.fill(glm::ivec3(0), glm::ivec3(size - 1), BLOCK_STONE); });
+    run("hollow box", [&] { edit.hollow(glm::ivec3(10), glm::ivec3(240), BLOCK_DIRT); });
+    run("replace", [&] { edit.replace(glm::ivec3(0), glm::ivec3(size - 1), BLOCK_STONE, BLOCK_GRASS); });
+
+    std::mt19937 rng(9);
+    std::uniform_int_distribution<int> cell(0, size - 1);
+    run("1M scattered blocks", [&] {
+        history.beginStep();
+        for (int i = 0; i < 1000000; i++)
+        {
+            int x = cell(rng), y = cell(rng), z = cell(rng);
+            history.record(x, y, z, world.getBlock(x, y, z), BLOCK_DIRT);
+            world.setBlock(x, y, z, BLOCK_DIRT);
+        }
+        history.endStep();
+    });
+
+    const int steps = 200000;
+    history.setMaxBytes(4u << 20);
+    auto start = Clock::now();
+    for (int i = 0; i < steps; i++)
+    {
+        int x = cell(rng), y = cell(rng), z = cell(rng);
+        history.beginStep();
+        history.record(x, y, z, world.getBlock(x, y, z), BLOCK_STONE);
+        world.setBlock(x, y, z, BLOCK_STONE);
+        history.endStep();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << steps << " single-block steps under a 4 MB cap: " << ms * 1e6 / steps << " ns each, "
+              << history.getStepCount() << " kept, " << history.getEvictedCount() << " evicted, "
+              << history.getBytes() / static_cast<double>(history.getStepCount()) << " bytes per step" << std::endl;
+}
+
+// Reads blocks of a 256x64x256 world of random solid and air cells, once
+// in random order and once in memory order, through the division-based
+// index maths World used before its chunk layout became compile-time (here
+// inlined, so if anything flattered), through isBlockSolid and through
+// isBlockSolidUnchecked. Prints nanoseconds per read; all three must count
+// the same solid blocks.
+void runBlockAccessBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    World world(256, 64, 256);
+    std::mt19937 rng(13);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (int& block : chunk)
+                block = rng() % 2 ? BLOCK_STONE : BLOCK_AIR;
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    auto oldIsBlockSolid = [&world](int x, int y, int z) {
+        if (x < 0 || x >= world.WORLD_X || y < 0 || y >= world.WORLD_Y || z < 0 || z >= world.WORLD_Z)
+            throw std::out_of_range("Block coordinates out of bounds");
+        int i = x % World::CHUNK_SIZE + y * World::CHUNK_SIZE + (z % World::CHUNK_SIZE) * World::CHUNK_SIZE * world.WORLD_Y;
+        return World::isSolidBlock(world.getChunkBlocks(x / World::CHUNK_SIZE, z / World::CHUNK_SIZE)[i]);
+    };
+
+    const int reads = 1 << 22;
+    std::vector<glm::ivec3> cells(reads);
+    std::uniform_int_distribution<int> across(0, 255);
+    std::uniform_int_distribution<int> height(0, 63);
+    for (glm::ivec3& c : cells)
+        c = glm::ivec3(across(rng), height(rng), across(rng));
+
+    auto measure = [&](const char* name, auto isSolid) {
+        auto start = Clock::now();
+        long randomCount = 0;
+        for (const glm::ivec3& c : cells)
+            randomCount += isSolid(c.x, c.y, c.z);
+        double randomNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / reads;
+
+        start = Clock::now();
+        long sequentialCount = 0;
+        for (int z = 0; z < world.WORLD_Z; z++)
+            for (int y = 0; y < world.WORLD_Y; y++)
+                for (int x = 0; x < world.WORLD_X; x++)
+                    sequentialCount += isSolid(x, y, z);
+        double sequentialNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+                              (static_cast<double>(world.WORLD_X) * world.WORLD_Y * world.WORLD_Z);
+
+        std::cout << name << ": random " << randomNs << " ns, sequential " << sequentialNs << " ns per read ("
+                  << randomCount << " / " << sequentialCount << " solid)" << std::endl;
+    };
+
+    // The old maths is for linear columns only.
+    if (World::BLOCK_ORDER == ORDER_LINEAR)
+        measure("old index maths", oldIsBlockSolid);
+    measure("isBlockSolid", [&world](int x, int y, int z) { return world.isBlockSolid(x, y, z); });
+    measure("isBlockSolidUnchecked", [&world](int x, int y, int z) { return world.isBlockSolidUnchecked(x, y, z); });
+}
+
+// Times the work that reads blocks next to each other on a 256x64x256 world
+// of rolling ground with caves, for whichever block order this build uses:
+// counting the solid neighbours of every block, capturing and meshing every
+// chunk, entities falling onto and walking the ground, and rays walked cell
+// by cell. Build with and without MORTON_CHUNKS to compare; the counts
+// printed must match between the two.
+void runChunkLayoutBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+#ifdef __BMI2__
+    const char* order = World::BLOCK_ORDER == ORDER_MORTON ? "morton, BMI2" : "linear";
+#else
+    const char* order = World::BLOCK_ORDER == ORDER_MORTON ? "morton, tables" : "linear";
+#endif
+    std::cout << "block order: " << order << std::endl;
+
+    World world(256, 64, 256);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (size_t i = 0; i < chunk.size(); i++)
+            {
+                int x = cx * World::CHUNK_SIZE + World::getColumnX(static_cast<int>(i));
+                int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                int z = cz * World::CHUNK_SIZE + World::getColumnZ(static_cast<int>(i), world.WORLD_Y);
+                chunk[i] = y < 32 + static_cast<int>(8.f * std::sin(x * 0.07f) + 8.f * std::cos(z * 0.05f)) ? BLOCK_STONE : BLOCK_AIR;
+            }
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    std::mt19937 rng(17);
+    std::uniform_int_distribution<int> across(6, 249);
+    std::uniform_int_distribution<int> depth(6, 40);
+    std::uniform_int_distribution<int> radius(2, 5);
+    WorldEdit edit(world);
+    std::vector<glm::ivec3> caves(3000);
+    for (glm::ivec3& cave : caves)
+    {
+        cave = glm::ivec3(across(rng), depth(rng), across(rng));
+        edit.fillSphere(cave, radius(rng), BLOCK_AIR);
+    }
+
+    // Neighbours one apart along x, y and z, the lookups meshing and
+    // collision make.
+    auto start = Clock::now();
+    long neighbours = 0;
+    for (int z = 1; z < world.WORLD_Z - 1; z++)
+    {
+        for (int y = 1; y < world.WORLD_Y - 1; y++)
+        {
+            for (int x = 1; x < world.WORLD_X - 1; x++)
+            {
+                if (!world.isBlockSolidUnchecked(x, y, z))
+                    continue;
+                neighbours += world.isBlockSolidUnchecked(x - 1, y, z) + world.isBlockSolidUnchecked(x + 1, y, z) +
+                              world.isBlockSolidUnchecked(x, y - 1, z) + world.isBlockSolidUnchecked(x, y + 1, z) +
+                              world.isBlockSolidUnchecked(x, y, z - 1) + world.isBlockSolidUnchecked(x, y, z + 1);
+            }
+        }
+    }
+    double neighbourNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+                         (static_cast<double>(world.WORLD_X - 2) * (world.WORLD_Y - 2) * (world.WORLD_Z - 2));
+    std::cout << "neighbours: " << neighbourNs << " ns per block (" << neighbours << " solid pairs)" << std::endl;
+
+    double captureMs = 0.0;
+    double buildMs = 0.0;
+    long triangles = 0;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            start = Clock::now();
+            ChunkVolume volume = ChunkMesher::capture(world, cx, cz);
+            auto captured = Clock::now();
+            ChunkMesh mesh = ChunkMesher::build(volume, 0);
+            captureMs += std::chrono::duration<double, std::milli>(captured - start).count();
+            buildMs += std::chrono::duration<double, std::milli>(Clock::now() - captured).count();
+            for (int tex = 0; tex < FACE_TEXTURE_COUNT; tex++)
+                triangles += mesh.vertexCount(tex) / 3;
+        }
+    }
+    int chunks = world.getChunksX() * world.getChunksZ();
+    std::cout << "meshing: capture " << captureMs / chunks << " ms, build " << buildMs / chunks << " ms per chunk ("
+              << triangles << " triangles)" << std::endl;
+
+    EntitySystem entities;
+    std::uniform_real_distribution<float> spread(1.f, 254.f);
+    std::uniform_real_distribution<float> drop(42.f, 62.f);
+    std::uniform_real_distribution<float> drift(-2.f, 2.f);
+    for (int i = 0; i < 30000; i++)
+    {
+        Entity e = entities.create(glm::vec3(spread(rng), drop(rng), spread(rng)), 0.3f, 1.8f);
+        entities.setVelocity(e, glm::vec3(drift(rng), 0.f, drift(rng)));
+    }
+    const int ticks = 120;
+    start = Clock::now();
+    for (int t = 0; t < ticks; t++)
+        entities.update(world, Game::TICK_SECONDS);
+    double entityMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ticks;
+    std::cout << "collision: " << entityMs << " ms per tick for 30000 entities (" << entities.getGroundedCount() << " grounded)" << std::endl;
+
+    const int rays = 1000000;
+    std::vector<glm::vec3> origins(rays);
+    std::vector<glm::vec3> directions(rays);
+    std::normal_distribution<float> gaussian;
+    std::uniform_int_distribution<size_t> pick(0, caves.size() - 1);
+    for (int i = 0; i < rays; i++)
+    {
+        origins[i] = glm::vec3(caves[pick(rng)]);
+        directions[i] = glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng));
+    }
+    VoxelRaycaster raycaster;
+    RaycastResults results;
+    raycaster.setEmptySpaceSkipping(false);
+    start = Clock::now();
+    raycaster.cast(world, origins, directions, 64.f, results);
+    double rayNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rays;
+    long hits = std::count(results.isHit.begin(), results.isHit.end(), 1);
+    std::cout << "raycast: " << rayNs << " ns per ray, " << static_cast<double>(raycaster.getStepCount()) / rays
+              << " steps per ray (" << hits << " hits)" << std::endl;
+}
+
+// Culls views of hilly ground with caves under it, from the surface, from
+// inside the caves and from high above, and checks every view against a
+// brute-force reference: a ray through each pixel of an image twice the
+// depth buffer's size, where every section a ray hits first is visible.
+// Culling one of those is a false cull. Prints the cull time against the
+// reference's, and how many chunk columns and sections were kept by the
+// frustum alone, by the culler and by the reference. Fails on any false
+// cull, or when the culler removes less than half of the sections in the
+// frustum that the reference does not see. Looking down from above, most
+// sections in the frustum really are in sight, so that is the fair bar
+// rather than a fixed share of the frustum.
+bool runCullBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+    const int imageW = 2 * OcclusionCuller::DEPTH_W;
+    const int imageH = 2 * OcclusionCuller::DEPTH_H;
+    const float farPlane = 100.f;
+    const int views = 40;
+
+    World world(256, 64, 256);
+    std::vector<int> chunk;
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            world.getChunk(cx, cz, chunk);
+            for (size_t i = 0; i < chunk.size(); i++)
+            {
+                int x = cx * World::CHUNK_SIZE + World::getColumnX(static_cast<int>(i));
+                int y = World::getColumnY(static_cast<int>(i), world.WORLD_Y);
+                int z = cz * World::CHUNK_SIZE + World::getColumnZ(static_cast<int>(i), world.WORLD_Y);
+                chunk[i] = y < 32 + static_cast<int>(12.f * std::sin(x * 0.05f) + 12.f * std::cos(z * 0.04f)) ? BLOCK_STONE : BLOCK_AIR;
+            }
+            world.setChunk(cx, cz, chunk);
+        }
+    }
+
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<int> across(6, 249);
+    std::uniform_int_distribution<int> depth(6, 30);
+    std::uniform_int_distribution<int> radius(2, 5);
+    WorldEdit edit(world);
+    std::vector<glm::ivec3> caves(3000);
+    for (glm::ivec3& cave : caves)
+    {
+        cave = glm::ivec3(across(rng), depth(rng), across(rng));
+        edit.fillSphere(cave, radius(rng), BLOCK_AIR);
+    }
+
+    OcclusionCuller culler(world);
+    auto start = Clock::now();
+    culler.updateOccluders();
+    double extractMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << culler.getOccluderCount() << " occluders in " << world.getChunksX() * world.getChunksZ() << " chunks, extracted in "
+              << extractMs << " ms" << std::endl;
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.01f, farPlane);
+    auto groundHeight = [&world](int x, int z) {
+        int y = world.WORLD_Y - 1;
+        while (y > 0 && !world.isBlockSolid(x, y, z))
+            y--;
+        return y;
+    };
+
+    std::uniform_real_distribution<float> yaw(0.f, 6.2831853f);
+    std::uniform_real_distribution<float> level(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> downward(-1.2f, -0.5f);
+    std::uniform_int_distribution<size_t> pick(0, caves.size() - 1);
+
+    VoxelRaycaster raycaster;
+    RaycastResults hits;
+    std::vector<glm::vec3> origins(static_cast<size_t>(imageW) * imageH);
+    std::vector<glm::vec3> directions(origins.size());
+    std::vector<float> rayLengths(origins.size());
+    std::vector<char> isSeen(world.getChunksX() * world.getChunksZ() * world.getSectionsY());
+    bool hasPassed = true;
+
+    const char* scenes[] = { "surface", "caves", "above" };
+    for (int scene = 0; scene < 3; scene++)
+    {
+        double cullMs = 0.0;
+        double referenceMs = 0.0;
+        long kept = 0;
+        long keptSections = 0;
+        long inFrustum = 0;
+        long inFrustumSections = 0;
+        long seen = 0;
+        long seenSections = 0;
+        int falseCulls = 0;
+
+        for (int v = 0; v < views; v++)
+        {
+            glm::vec3 eye;
+            float pitch;
+            if (scene == 0)
+            {
+                int x = across(rng);
+                int z = across(rng);
+                eye = glm::vec3(x, groundHeight(x, z) + 1.6f, z);
+                pitch = level(rng);
+            }
+            else if (scene == 1)
+            {
+                eye = glm::vec3(caves[pick(rng)]);
+                pitch = level(rng);
+            }
+            else
+            {
+                eye = glm::vec3(across(rng), world.WORLD_Y + 30.f, across(rng));
+                pitch = downward(rng);
+            }
+            float angle = yaw(rng);
+            glm::vec3 front(std::cos(angle) * std::cos(pitch), std::sin(pitch), std::sin(angle) * std::cos(pitch));
+            glm::mat4 viewProj = projection * glm::lookAt(eye, eye + front, glm::vec3(0.f, 1.f, 0.f));
+
+            culler.setOcclusionTesting(false);
+            culler.cull(viewProj);
+            inFrustum += culler.getVisibleCount();
+            inFrustumSections += culler.getVisibleSectionCount();
+
+            culler.setOcclusionTesting(true);
+            start = Clock::now();
+            culler.cull(viewProj);
+            cullMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            kept += culler.getVisibleCount();
+            keptSections += culler.getVisibleSectionCount();
+
+            // Each ray runs from the near plane to the far plane through a
+            // pixel centre, which is farther than farPlane off the axis.
+            start = Clock::now();
+            glm::mat4 inverse = glm::inverse(viewProj);
+            float longest = 0.f;
+            for (int py = 0; py < imageH; py++)
+            {
+                for (int px = 0; px < imageW; px++)
+                {
+                    float nx = (px + 0.5f) / imageW * 2.f - 1.f;
+                    float ny = (py + 0.5f) / imageH * 2.f - 1.f;
+                    glm::vec4 nearPoint = inverse * glm::vec4(nx, ny, -1.f, 1.f);
+                    glm::vec4 farPoint = inverse * glm::vec4(nx, ny, 1.f, 1.f);
+                    size_t i = static_cast<size_t>(px) + static_cast<size_t>(py) * imageW;
+                    origins[i] = glm::vec3(nearPoint) / nearPoint.w;
+                    glm::vec3 ray = glm::vec3(farPoint) / farPoint.w - origins[i];
+                    rayLengths[i] = glm::length(ray);
+                    directions[i] = ray / rayLengths[i];
+                    longest = std::max(longest, rayLengths[i]);
+                }
+            }
+            raycaster.cast(world, origins, directions, longest, hits);
+
+            std::fill(isSeen.begin(), isSeen.end(), 0);
+            for (size_t i = 0; i < origins.size(); i++)
+            {
+                if (hits.isHit[i] && hits.distances[i] <= rayLengths[i])
+                {
+                    const glm::ivec3& cell = hits.cells[i];
+                    int column = cell.x / World::CHUNK_SIZE + (cell.z / World::CHUNK_SIZE) * world.getChunksX();
+                    isSeen[column * world.getSectionsY() + cell.y / World::CHUNK_SIZE] = 1;
+                }
+            }
+            referenceMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            for (int cz = 0; cz < world.getChunksZ(); cz++)
+            {
+                for (int cx = 0; cx < world.getChunksX(); cx++)
+                {
+                    bool isColumnSeen = false;
+                    for (int sy = 0; sy < world.getSectionsY(); sy++)
+                    {
+                        bool isReference = isSeen[(cx + cz * world.getChunksX()) * world.getSectionsY() + sy] != 0;
+                        seenSections += isReference;
+                        isColumnSeen = isColumnSeen || isReference;
+                        if (isReference && !culler.isSectionVisible(cx, sy, cz))
+                        {
+                            falseCulls++;
+                            std::cout << "  false cull: " << scenes[scene] << " view " << v << ", section " << cx << ", " << sy << ", " << cz
+                                      << std::endl;
+                        }
+                    }
+                    seen += isColumnSeen;
+                }
+            }
+        }
+
+        bool isCulling = (inFrustumSections - keptSections) * 2 >= inFrustumSections - seenSections;
+        hasPassed = hasPassed && isCulling && falseCulls == 0;
+        std::cout << scenes[scene] << ": cull " << cullMs / views << " ms per view (reference " << referenceMs / views << " ms), chunks "
+                  << static_cast<double>(inFrustum) / views << " in the frustum, " << static_cast<double>(kept) / views << " kept, "
+                  << static_cast<double>(seen) / views << " seen; sections " << static_cast<double>(inFrustumSections) / views << " in the frustum, "
+                  << static_cast<double>(keptSections) / views << " kept, " << static_cast<double>(seenSections) / views << " seen; "
+                  << falseCulls << " false culls" << (isCulling ? "" : ", NOT CULLING") << std::endl;
+    }
+
+    std::cout << (hasPassed ? "passed" : "FAILED") << std::endl;
+    return hasPassed;
+}
+
+namespace {
+    // Stands in for the driver. Copies are queued with the staging storage
+    // they read from and only run once their frame's fence retires, lag
+    // frames later, so storage still in use survives an orphan just as it
+    // does on a GPU. Any write or copy outside a buffer is counted.
+    class FakeUploadBackend : public UploadBackend
+    {
+    public:
+        FakeUploadBackend(int lagFrames, bool canMap) : lag(lagFrames), isMappable(canMap) {}
+
+        unsigned int createBuffer(size_t size) override
+        {
+            buffers[nextBuffer] = std::make_shared<std::vector<uint8_t>>(size);
+            return nextBuffer++;
+        }
+        void deleteBuffer(unsigned int buffer) override { buffers.erase(buffer); }
+        void orphan(unsigned int buffer, size_t size) override { buffers[buffer] = std::make_shared<std::vector<uint8_t>>(size); }
+
+        void* map(unsigned int buffer, size_t offset, size_t size) override
+        {
+            std::vector<uint8_t>& storage = *buffers.at(buffer);
+            if (!isMappable)
+                return nullptr;
+            if (offset + size > storage.size())
+            {
+                outOfBounds++;
+                return nullptr;
+            }
+            return storage.data() + offset;
+        }
+        void unmap(unsigned int) override {}
+        void write(unsigned int buffer, size_t offset, const void* data, size_t size) override
+        {
+            std::vector<uint8_t>& storage = *buffers.at(buffer);
+            if (offset + size > storage.size())
+            {
+                outOfBounds++;
+                return;
+            }
+            std::memcpy(storage.data() + offset, data, size);
+        }
+        void copy(unsigned int src, unsigned int dst, size_t srcOffset, size_t dstOffset, size_t size) override
+        {
+            queued.push_back({ buffers.at(src), dst, srcOffset, dstOffset, size });
+        }
+
+        // A fence lives on until its frame retires, even once deleted.
+        void* insertFence() override
+        {
+            fences.push_back(std::make_shared<bool>(false));
+            inFlight.push_back({ fences.back(), std::move(queued) });
+            queued.clear();
+            return fences.back().get();
+        }
+        bool isFenceSignaled(void* fence) override { return *static_cast<bool*>(fence); }
+        void deleteFence(void* fence) override
+        {
+            std::erase_if(fences, [fence](const std::shared_ptr<bool>& f) { return f.get() == fence; });
+        }
+
+        // One frame of GPU time: retires the frame lag frames back, or every
+        // frame still in flight when finishing.
+        void advance(bool isFinishing = false)
+        {
+            while (!inFlight.empty() && (isFinishing || static_cast<int>(inFlight.size()) > lag))
+            {
+                for (const Copy& c : inFlight.front().copies)
+                {
+                    std::vector<uint8_t>& dst = *buffers.at(c.dst);
+                    if (c.srcOffset + c.size > c.src->size() || c.dstOffset + c.size > dst.size())
+                    {
+                        outOfBounds++;
+                        continue;
+                    }
+                    std::memcpy(dst.data() + c.dstOffset, c.src->data() + c.srcOffset, c.size);
+                }
+                *inFlight.front().fence = true;
+                inFlight.pop_front();
+            }
+        }
+
+        const std::vector<uint8_t>& getBuffer(unsigned int buffer) const { return *buffers.at(buffer); }
+        size_t getBufferCount() const { return buffers.size(); }
+        size_t getFenceCount() const { return fences.size(); }
+        int getOutOfBoundsCount() const { return outOfBounds; }
+
+    private:
+        struct Copy
+        {
+            std::shared_ptr<std::vector<uint8_t>> src;
+            unsigned int dst;
+            size_t srcOffset;
+            size_t dstOffset;
+            size_t size;
+        };
+        struct Frame
+        {
+            std::shared_ptr<bool> fence;
+            std::vector<Copy> copies;
+        };
+
+        int lag;
+        bool isMappable;
+        unsigned int nextBuffer = 1;
+        std::map<unsigned int, std::shared_ptr<std::vector<uint8_t>>> buffers;
+        std::vector<Copy> queued;
+        std::deque<Frame> inFlight;
+        std::vector<std::shared_ptr<bool>> fences;
+        int outOfBounds = 0;
+    };
+}
+
+// Streams random mesh-sized uploads through an UploadRing on a fake backend
+// whose copies finish a set number of frames late, the way ChunkRenderer
+// drives it: reserve, then upload, deferring the rest of the frame's queue
+// once the budget is spent. Covers a GPU that keeps up (staging buffers
+// reused once their fence has signalled), one that falls behind (buffers
+// orphaned instead of waited on), a budget smaller than one upload, uploads
+// larger than a staging buffer, and a driver that refuses to map. The
+// destination must end up holding exactly what was uploaded.
+void runUploadRingBenchmark()
+{
+    struct Scenario
+    {
+        const char* name;
+        int lag;
+        bool canMap;
+        size_t segmentBytes;
+        size_t budget;
+        size_t maxUpload;
+    };
+    const Scenario scenarios[] = {
+        { "GPU 2 frames behind", 2, true, 256 * 1024, 192 * 1024, 48 * 1024 },
+        { "GPU 5 frames behind", 5, true, 256 * 1024, 192 * 1024, 48 * 1024 },
+        { "budget under one upload", 2, true, 256 * 1024, 8 * 1024, 48 * 1024 },
+        { "uploads over a segment", 2, true, 64 * 1024, 1024 * 1024, 160 * 1024 },
+        { "no mapping", 2, false, 256 * 1024, 192 * 1024, 48 * 1024 },
+    };
+    const int uploads = 2000;
+    const size_t destinationBytes = 4 * 1024 * 1024;
+
+    for (const Scenario& s : scenarios)
+    {
+        FakeUploadBackend backend(s.lag, s.canMap);
+        unsigned int destination = backend.createBuffer(destinationBytes);
+        std::vector<uint8_t> expected(destinationBytes, 0);
+        int wrongDecisions = 0;
+        int frames = 0;
+        size_t maxFrameBytes = 0;
+
+        {
+            UploadRing ring(backend, s.segmentBytes, s.budget);
+            std::mt19937 rng(29);
+            std::uniform_int_distribution<size_t> sizes(1, s.maxUpload);
+            std::uniform_int_distribution<int> bytes(0, 255);
+            std::vector<uint8_t> data;
+
+            int done = 0;
+            std::deque<size_t> waiting;
+            while (done < uploads)
+            {
+                while (waiting.size() < 16 && done + waiting.size() < static_cast<size_t>(uploads))
+                    waiting.push_back(sizes(rng));
+
+                ring.beginFrame();
+                while (!waiting.empty())
+                {
+                    size_t size = waiting.front();
+                    // Staging buffers only ever grow, so anything within the
+                    // budget and the starting size has to fit.
+                    size_t before = ring.getBytesThisFrame();
+                    if (!ring.reserve(size))
+                    {
+                        wrongDecisions += before + size <= s.budget && before + size <= s.segmentBytes;
+                        break;
+                    }
+                    wrongDecisions += before != 0 && before + size > s.budget;
+
+                    std::uniform_int_distribution<size_t> offsets(0, destinationBytes - size);
+                    size_t offset = offsets(rng);
+                    data.resize(size);
+                    for (uint8_t& b : data)
+                        b = static_cast<uint8_t>(bytes(rng));
+                    ring.upload(destination, offset, data.data(), size);
+                    std::memcpy(expected.data() + offset, data.data(), size);
+
+                    waiting.pop_front();
+                    done++;
+                }
+                maxFrameBytes = std::max(maxFrameBytes, ring.getBytesThisFrame());
+                ring.endFrame();
+                backend.advance();
+                frames++;
+            }
+            backend.advance(true);
+
+            bool isExact = backend.getBuffer(destination) == expected && backend.getOutOfBoundsCount() == 0 && wrongDecisions == 0;
+            std::cout << s.name << ": " << uploads << " uploads in " << frames << " frames, " << ring.getDeferredCount() << " deferred, "
+                      << ring.getOrphanCount() << " orphaned, " << ring.getMapFallbackCount() << " written without a map, at most "
+                      << maxFrameBytes / 1024 << " KB in a frame, " << (isExact ? "exact" : "MISMATCH") << std::endl;
+
+            ring.release();
+        }
+
+        if (backend.getBufferCount() != 1 || backend.getFenceCount() != 0)
+            std::cout << "  leaked " << backend.getBufferCount() - 1 << " buffers and " << backend.getFenceCount() << " fences" << std::endl;
+    }
+}
+
+namespace {
+    // Counts the free runs in an ownership map and the longest of them, to
+    // hold the arena's coalescing against.
+    void countFreeRuns(const std::vector<int>& owner, int& runs, int& longest)
+    {
+        runs = 0;
+        longest = 0;
+        int length = 0;
+        for (int o : owner)
+        {
+            if (o < 0)
+            {
+                runs += length == 0;
+                longest = std::max(longest, ++length);
+            }
+            else
+            {
+                length = 0;
+            }
+        }
+    }
+}
+
+// Drives a VertexArena the way ChunkRenderer does: random mesh-sized
+// allocations and releases, defragmenting when the free space is there but
+// splintered and growing when it is not. A plain array stands in for the
+// vertex buffer, with every vertex tagged by the allocation it belongs to,
+// and defragment's moves are applied to it with memmove. Checks that no two
+// live allocations overlap, that the free blocks are always fully coalesced
+// (their count and the largest must match the gaps in the array), that there
+// is one move per moved block and that every allocation still holds its own
+// tags afterwards.
+void runVertexArenaBenchmark()
+{
+    const int operations = 20000;
+    VertexArena arena(1 << 16);
+    std::vector<int> buffer(arena.getCapacity(), 0);
+    std::vector<int> owner(arena.getCapacity(), -1);
+    std::vector<int> handles;
+    std::map<int, int> tags;
+    std::mt19937 rng(31);
+    std::uniform_int_distribution<int> sizes(1, 3000);
+    int nextTag = 1;
+
+    int overlaps = 0;
+    int badCoalesces = 0;
+    int badContents = 0;
+    int extraMoves = 0;
+    int defragments = 0;
+    int grows = 0;
+    long long moves = 0;
+    long long movedVertices = 0;
+
+    auto checkContents = [&]() {
+        for (int h : handles)
+        {
+            int offset = arena.getOffset(h);
+            for (int i = 0; i < arena.getSize(h); i++)
+                badContents += buffer[offset + i] != tags[h];
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int op = 0; op < operations; op++)
+    {
+        // Lean towards allocating while the arena is small, so it fills up,
+        // splinters and has to be packed or grown.
+        bool isAllocating = handles.empty() || rng() % 100 < (arena.getUsed() < arena.getCapacity() / 2 ? 60u : 45u);
+        if (isAllocating)
+        {
+            int size = sizes(rng);
+            int handle = arena.allocate(size);
+            if (handle == VertexArena::INVALID_HANDLE && arena.getCapacity() - arena.getUsed() >= size)
+            {
+                std::vector<VertexArena::Move> packed = arena.defragment();
+                defragments++;
+                int live = static_cast<int>(handles.size());
+                extraMoves += std::max(0, static_cast<int>(packed.size()) - live);
+                for (const VertexArena::Move& m : packed)
+                {
+                    std::memmove(buffer.data() + m.to, buffer.data() + m.from, m.size * sizeof(int));
+                    movedVertices += m.size;
+                }
+                moves += static_cast<long long>(packed.size());
+
+                checkContents();
+                std::fill(owner.begin(), owner.end(), -1);
+                for (int h : handles)
+                    std::fill_n(owner.begin() + arena.getOffset(h), arena.getSize(h), h);
+
+                handle = arena.allocate(size);
+            }
+            if (handle == VertexArena::INVALID_HANDLE)
+            {
+                int newCapacity = std::max(arena.getCapacity() * 2, arena.getUsed() + size);
+                arena.grow(newCapacity);
+                buffer.resize(newCapacity, 0);
+                owner.resize(newCapacity, -1);
+                grows++;
+                handle = arena.allocate(size);
+            }
+
+            int offset = arena.getOffset(handle);
+            for (int i = 0; i < size; i++)
+            {
+                overlaps += owner[offset + i] >= 0;
+                owner[offset + i] = handle;
+                buffer[offset + i] = nextTag;
+            }
+            tags[handle] = nextTag++;
+            handles.push_back(handle);
+        }
+        else
+        {
+            int pick = static_cast<int>(rng() % handles.size());
+            int handle = handles[pick];
+            std::fill_n(owner.begin() + arena.getOffset(handle), arena.getSize(handle), -1);
+            arena.release(handle);
+            handles[pick] = handles.back();
+            handles.pop_back();
+        }
+
+        int runs, longest;
+        countFreeRuns(owner, runs, longest);
+        badCoalesces += runs != arena.getFreeBlockCount() || longest != arena.getLargestFreeBlock();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    checkContents();
+    for (int h : handles)
+        arena.release(h);
+    badCoalesces += arena.getFreeBlockCount() != 1 || arena.getLargestFreeBlock() != arena.getCapacity() || arena.getUsed() != 0;
+
+    bool isExact = overlaps == 0 && badCoalesces == 0 && badContents == 0 && extraMoves == 0;
+    std::cout << operations << " allocations and releases in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms (with the reference checks), " << grows << " grows to " << arena.getCapacity() << " vertices, " << defragments
+              << " defragments, " << moves << " moves of " << (moves > 0 ? movedVertices / moves : 0) << " vertices on average" << std::endl;
+    std::cout << overlaps << " overlapping vertices, " << badCoalesces << " uncoalesced states, " << badContents << " misplaced vertices, "
+              << extraMoves << " extra moves, " << (isExact ? "exact" : "MISMATCH") << std::endl;
+}
@@ -0,0 +1,167 @@
+#include "block_ticks.h"
+#include <algorithm>
+#include <stdexcept>
+
+#include "world.h"
+
+void TickWheel::insert(Entry entry)
+{
+    uint32_t distance = entry.due - now;
+    int level = 0;
+    while (level < LEVELS - 1 && distance >= (1u << (SLOT_BITS * (level + 1))))
+        level++;
+
+    slots[level * SLOTS + ((entry.due >> (SLOT_BITS * level)) & (SLOTS - 1))].push_back(entry);
+}
+
+void TickWheel::schedule(uint32_t cell, uint32_t delay)
+{
+    delay = std::min(std::max(delay, 1u), MAX_DELAY);
+    insert({ cell, now + delay });
+    count++;
+}
+
+// Refiles the slot of the level that has just come round. Everything in it
+// is due within one slot of the level, so it lands lower down.
+void TickWheel::cascade(int level)
+{
+    std::vector<Entry>& slot = slots[level * SLOTS + ((now >> (SLOT_BITS * level)) & (SLOTS - 1))];
+    std::vector<Entry> moving;
+    moving.swap(slot);
+    for (const Entry& entry : moving)
+        insert(entry);
+
+    // Hand the storage back so the slot does not reallocate next time round.
+    moving.clear();
+    if (slot.empty())
+        slot.swap(moving);
+}
+
+void TickWheel::advance(std::vector<uint32_t>& due)
+{
+    now++;
+
+    // Higher levels first, so what they drop into a lower level's current
+    // slot is carried on down in the same advance.
+    int wrapped = 0;
+    while (wrapped < LEVELS - 1 && (now & ((1u << (SLOT_BITS * (wrapped + 1))) - 1)) == 0)
+        wrapped++;
+    for (int level = wrapped; level > 0; level--)
+        cascade(level);
+
+    std::vector<Entry>& slot = slots[now & (SLOTS - 1)];
+    for (const Entry& entry : slot)
+        due.push_back(entry.cell);
+    count -= slot.size();
+    slot.clear();
+}
+
+void TickWheel::getPending(std::vector<PendingTick>& out) const
+{
+    for (const std::vector<Entry>& slot : slots)
+        for (const Entry& entry : slot)
+            out.push_back({ entry.cell, entry.due - now });
+}
+
+BlockTicks::BlockTicks(int sizeX, int sizeY, int sizeZ)
+    : SIZE_X(sizeX), SIZE_Y(sizeY), SIZE_Z(sizeZ),
+      chunksX((sizeX + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE)
+{
+    int chunks = chunksX * ((sizeZ + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE);
+    wheels.resize(chunks);
+    isActive.resize(chunks, 0);
+}
+
+TickWheel& BlockTicks::activate(int chunk)
+{
+    if (!wheels[chunk])
+        wheels[chunk] = std::make_unique<TickWheel>();
+
+    // An idle wheel has not been advanced, so its clock is set again. Each
+    // chunk's clock is offset from the others so their upper levels come
+    // round on different ticks, spreading out the refiling.
+    if (!isActive[chunk])
+    {
+        wheels[chunk]->restart(tick + static_cast<uint32_t>(chunk) * 0x9E3779B9u);
+        activeChunks.push_back(chunk);
+        isActive[chunk] = 1;
+    }
+    return *wheels[chunk];
+}
+
+void BlockTicks::schedule(int x, int y, int z, uint32_t delay)
+{
+    if (x < 0 || x >= SIZE_X || y < 0 || y >= SIZE_Y || z < 0 || z >= SIZE_Z)
+        throw std::out_of_range("Block coordinates out of bounds");
+
+    int chunk = x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * chunksX;
+    uint32_t cell = x % World::CHUNK_SIZE + y * World::CHUNK_SIZE + (z % World::CHUNK_SIZE) * World::CHUNK_SIZE * SIZE_Y;
+    activate(chunk).schedule(cell, delay);
+}
+
+void BlockTicks::advance(std::vector<glm::ivec3>& due)
+{
+    due.clear();
+    tick++;
+
+    for (size_t i = 0; i < activeChunks.size();)
+    {
+        int chunk = activeChunks[i];
+        TickWheel& wheel = *wheels[chunk];
+
+        dueCells.clear();
+        wheel.advance(dueCells);
+
+        glm::ivec3 corner((chunk % chunksX) * World::CHUNK_SIZE, 0, (chunk / chunksX) * World::CHUNK_SIZE);
+        for (uint32_t cell : dueCells)
+        {
+            due.push_back(corner + glm::ivec3(cell % World::CHUNK_SIZE, (cell / World::CHUNK_SIZE) % SIZE_Y,
+                                              cell / (World::CHUNK_SIZE * SIZE_Y)));
+        }
+        dispatched += static_cast<long>(dueCells.size());
+
+        if (wheel.getCount() == 0)
+        {
+            isActive[chunk] = 0;
+            activeChunks[i] = activeChunks.back();
+            activeChunks.pop_back();
+            continue;
+        }
+        i++;
+    }
+}
+
+void BlockTicks::getPending(int chunkX, int chunkZ, std::vector<PendingTick>& out) const
+{
+    out.clear();
+    int chunk = chunkX + chunkZ * chunksX;
+    if (isActive[chunk])
+        wheels[chunk]->getPending(out);
+}
+
+void BlockTicks::setPending(int chunkX, int chunkZ, const std::vector<PendingTick>& ticks)
+{
+    int chunk = chunkX + chunkZ * chunksX;
+    if (isActive[chunk])
+    {
+        wheels[chunk] = std::make_unique<TickWheel>();
+        activeChunks.erase(std::find(activeChunks.begin(), activeChunks.end(), chunk));
+        isActive[chunk] = 0;
+    }
+    if (ticks.empty())
+        return;
+
+    const uint32_t cells = static_cast<uint32_t>(World::CHUNK_SIZE * SIZE_Y * World::CHUNK_SIZE);
+    TickWheel& wheel = activate(chunk);
+    for (const PendingTick& pending : ticks)
+        if (pending.cell < cells)
+            wheel.schedule(pending.cell, pending.delay);
+}
+
+size_t BlockTicks::getPendingCount() const
+{
+    size_t total = 0;
+    for (int chunk : activeChunks)
+        total += wheels[chunk]->getCount();
+    return total;
+}
@@ -0,0 +1,183 @@
+#include "chunk_io.h"
+
+void LatencyHistogram::record(double ms)
+{
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && ms >= static_cast<double>(1 << bucket))
+        bucket++;
+
+    counts[bucket]++;
+    total++;
+    if (ms > maxMs)
+        maxMs = ms;
+}
+
+ChunkIO::ChunkIO(std::string directory, int height)
+    : storage(std::move(directory)), chunkHeight(height)
+{
+    worker = std::thread(&ChunkIO::run, this);
+}
+
+ChunkIO::~ChunkIO()
+{
+    shutdown();
+}
+
+void ChunkIO::requestLoad(int chunkX, int chunkZ)
+{
+    enqueue({ LOAD, chunkX, chunkZ, {}, {}, Clock::now() });
+}
+
+void ChunkIO::requestSave(int chunkX, int chunkZ, ChunkSnapshot snapshot, std::vector<PendingTick> ticks)
+{
+    enqueue({ SAVE, chunkX, chunkZ, std::move(snapshot), std::move(ticks), Clock::now() });
+}
+
+void ChunkIO::enqueue(Request request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (request.type == SAVE)
+        {
+            auto key = std::make_pair(request.chunkX, request.chunkZ);
+            auto it = queuedSaves.find(key);
+            if (it != queuedSaves.end())
+            {
+                requests[it->second - popped].snapshot = std::move(request.snapshot);
+                requests[it->second - popped].ticks = std::move(request.ticks);
+                coalescedSaves++;
+                return;
+            }
+
+            queuedSaves[key] = popped + requests.size();
+        }
+
+        requests.push_back(std::move(request));
+        if (static_cast<int>(requests.size()) > maxQueueDepth)
+            maxQueueDepth = static_cast<int>(requests.size());
+    }
+
+    wake.notify_one();
+}
+
+int ChunkIO::getQueueDepth() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(requests.size());
+}
+
+size_t ChunkIO::getRequestCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return popped + requests.size();
+}
+
+void ChunkIO::run()
+{
+    while (true)
+    {
+        Request request;
+        size_t sequence;
+        bool isLast;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return isStopping || !requests.empty(); });
+            if (requests.empty())
+                break;
+
+            request = std::move(requests.front());
+            requests.pop_front();
+
+            if (request.type == SAVE)
+            {
+                auto it = queuedSaves.find(std::make_pair(request.chunkX, request.chunkZ));
+                if (it != queuedSaves.end() && it->second == popped)
+                    queuedSaves.erase(it);
+            }
+
+            sequence = popped++;
+            isLast = requests.empty();
+        }
+
+        Completion done = process(request);
+        done.sequence = sequence;
+        if (isLast)
+        {
+            try {
+                storage.flush();
+                done.isFlushed = true;
+            }
+            catch (const std::exception& e) {
+                done.flushError = e.what();
+            }
+        }
+
+        while (!completions.tryPush(std::move(done)))
+            std::this_thread::yield();
+    }
+}
+
+ChunkIO::Completion ChunkIO::process(Request& request)
+{
+    Completion done;
+    done.type = request.type;
+    done.chunkX = request.chunkX;
+    done.chunkZ = request.chunkZ;
+
+    try {
+        if (request.type == LOAD)
+        {
+            done.isFound = storage.loadChunkData(request.chunkX, request.chunkZ, chunkHeight, done.blocks, &done.ticks);
+        }
+        else
+        {
+            storage.saveChunkData(request.chunkX, request.chunkZ, chunkHeight, request.snapshot.blocks, request.ticks);
+            done.isFound = true;
+        }
+    }
+    catch (const std::exception& e) {
+        done.error = e.what();
+    }
+
+    done.latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - request.queuedAt).count();
+    return done;
+}
+
+void ChunkIO::drainCompletions(const std::function<void(const Completion&)>& handler)
+{
+    Completion done;
+    while (completions.tryPop(done))
+    {
+        (done.type == LOAD ? loadLatency : saveLatency).record(done.latencyMs);
+        handler(done);
+    }
+}
+
+void ChunkIO::shutdown(const std::function<void(const Completion&)>& handler)
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    wake.notify_one();
+
+    // The worker may be blocked on a full completion queue, so keep draining
+    // until it has finished everything.
+    auto forward = [&handler](const Completion& done) {
+        if (handler)
+            handler(done);
+    };
+
+    while (getQueueDepth() > 0 || completions.size() > 0)
+    {
+        drainCompletions(forward);
+        std::this_thread::yield();
+    }
+
+    worker.join();
+    drainCompletions(forward);
+}
@@ -0,0 +1,326 @@
+#include "chunk_renderer.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+
+#include "world.h"
+#include "occlusion.h"
+
+namespace {
+    constexpr GLsizeiptr VERTEX_BYTES = ChunkMesher::FLOATS_PER_VERTEX * sizeof(float);
+    constexpr float DEFRAG_THRESHOLD = 0.5f;
+    constexpr int DEFRAG_MIN_BLOCKS = 8;
+}
+
+ChunkRenderer::ChunkRenderer(const World& w, JobSystem& jobSystem)
+    : world(w), jobs(jobSystem), chunksX(w.getChunksX()), chunksZ(w.getChunksZ())
+{
+    chunks.resize(chunksX * chunksZ);
+}
+
+void ChunkRenderer::setLodDistances(float lod1, float lod2, float lod3)
+{
+    lodDistances = { lod1, lod2, lod3 };
+}
+
+void ChunkRenderer::markDirty(int x, int z)
+{
+    if (world.isOutOfWorld(x, 0, z))
+        return;
+
+    int cx = x / World::CHUNK_SIZE;
+    int cz = z / World::CHUNK_SIZE;
+    int lx = x % World::CHUNK_SIZE;
+    int lz = z % World::CHUNK_SIZE;
+
+    chunks[cx + cz * chunksX].isDirty = true;
+
+    if (lx == 0 && cx > 0)
+        chunks[(cx - 1) + cz * chunksX].isDirty = true;
+    if (lx == World::CHUNK_SIZE - 1 && cx < chunksX - 1)
+        chunks[(cx + 1) + cz * chunksX].isDirty = true;
+    if (lz == 0 && cz > 0)
+        chunks[cx + (cz - 1) * chunksX].isDirty = true;
+    if (lz == World::CHUNK_SIZE - 1 && cz < chunksZ - 1)
+        chunks[cx + (cz + 1) * chunksX].isDirty = true;
+}
+
+void ChunkRenderer::markChunkDirty(int chunkX, int chunkZ)
+{
+    const int offsets[5][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+    for (const auto& o : offsets)
+    {
+        int cx = chunkX + o[0];
+        int cz = chunkZ + o[1];
+        if (cx >= 0 && cx < chunksX && cz >= 0 && cz < chunksZ)
+            chunks[cx + cz * chunksX].isDirty = true;
+    }
+}
+
+int ChunkRenderer::selectLod(int chunkX, int chunkZ, glm::vec3 cameraPos) const
+{
+    float half = World::CHUNK_SIZE * 0.5f;
+    glm::vec2 center(chunkX * World::CHUNK_SIZE + half - 0.5f, chunkZ * World::CHUNK_SIZE + half - 0.5f);
+    float dist = glm::length(center - glm::vec2(cameraPos.x, cameraPos.z));
+
+    int lod = 0;
+    for (float band : lodDistances)
+        if (dist > band)
+            lod++;
+
+    return lod;
+}
+
+void ChunkRenderer::update(glm::vec3 cameraPos)
+{
+    if (VAO != 0 && arena.getFreeBlockCount() >= DEFRAG_MIN_BLOCKS && arena.getFragmentation() > DEFRAG_THRESHOLD)
+        applyMoves(arena.defragment());
+
+    uploadRing.beginFrame();
+
+    for (int cz = 0; cz < chunksZ; cz++)
+    {
+        for (int cx = 0; cx < chunksX; cx++)
+        {
+            Chunk& chunk = chunks[cx + cz * chunksX];
+
+            if (chunk.pending.valid())
+            {
+                if (chunk.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    continue;
+
+                chunk.readyMesh = chunk.pending.get();
+                chunk.hasReadyMesh = true;
+            }
+
+            if (chunk.hasReadyMesh)
+            {
+                if (!upload(chunk, chunk.readyMesh))
+                    continue;
+
+                chunk.hasReadyMesh = false;
+                chunk.readyMesh = ChunkMesh();
+            }
+
+            int lod = selectLod(cx, cz, cameraPos);
+            if (!chunk.isDirty && lod == chunk.lod)
+                continue;
+
+            // Full detail chunks are the ones around the camera, so they jump the queue.
+            chunk.isDirty = false;
+            chunk.pending = jobs.async(lod == 0 ? JobSystem::HIGH : JobSystem::NORMAL,
+                [area = ChunkMesher::snapshot(world, cx, cz), lod] { return ChunkMesher::build(ChunkMesher::capture(area), lod); });
+        }
+    }
+
+    uploadRing.endFrame();
+}
+
+void ChunkRenderer::createBuffer()
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, arena.getCapacity() * VERTEX_BYTES, nullptr, GL_DYNAMIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+}
+
+void ChunkRenderer::resizeBuffer(int newCapacity)
+{
+    unsigned int newVBO;
+    glGenBuffers(1, &newVBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * VERTEX_BYTES, nullptr, GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, arena.getCapacity() * VERTEX_BYTES);
+    glDeleteBuffers(1, &VBO);
+    VBO = newVBO;
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)nullptr);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(3 * sizeof(float)));
+
+    arena.grow(newCapacity);
+}
+
+void ChunkRenderer::applyMoves(const std::vector<VertexArena::Move>& moves)
+{
+    if (moves.empty())
+        return;
+
+    // A copy within one buffer must not overlap itself, so a block that
+    // slides by less than its own size goes out to moveVBO and back.
+    int largestOverlap = 0;
+    for (const VertexArena::Move& m : moves)
+        if (m.from - m.to < m.size)
+            largestOverlap = std::max(largestOverlap, m.size);
+
+    if (largestOverlap > moveCapacity)
+    {
+        if (moveVBO == 0)
+            glGenBuffers(1, &moveVBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, moveVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, largestOverlap * VERTEX_BYTES, nullptr, GL_DYNAMIC_COPY);
+        moveCapacity = largestOverlap;
+    }
+
+    for (const VertexArena::Move& m : moves)
+    {
+        if (m.from - m.to >= m.size)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, m.from * VERTEX_BYTES, m.to * VERTEX_BYTES, m.size * VERTEX_BYTES);
+            continue;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, moveVBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, m.from * VERTEX_BYTES, 0, m.size * VERTEX_BYTES);
+        glBindBuffer(GL_COPY_READ_BUFFER, moveVBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, m.to * VERTEX_BYTES, m.size * VERTEX_BYTES);
+    }
+}
+
+int ChunkRenderer::allocateVertices(int size)
+{
+    int handle = arena.allocate(size);
+    if (handle != VertexArena::INVALID_HANDLE)
+        return handle;
+
+    if (arena.getCapacity() - arena.getUsed() >= size)
+    {
+        applyMoves(arena.defragment());
+        handle = arena.allocate(size);
+        if (handle != VertexArena::INVALID_HANDLE)
+            return handle;
+    }
+
+    resizeBuffer(std::max(arena.getCapacity() * 2, arena.getUsed() + size));
+    return arena.allocate(size);
+}
+
+bool ChunkRenderer::upload(Chunk& chunk, const ChunkMesh& mesh)
+{
+    int total = 0;
+    for (int t = 0; t < FACE_TEXTURE_COUNT; t++)
+        total += mesh.vertexCount(t);
+
+    if (!uploadRing.reserve(total * VERTEX_BYTES))
+        return false;
+
+    if (VAO == 0)
+        createBuffer();
+
+    if (chunk.handle != VertexArena::INVALID_HANDLE)
+    {
+        arena.release(chunk.handle);
+        chunk.handle = VertexArena::INVALID_HANDLE;
+    }
+
+    uploadScratch.clear();
+    for (int t = 0; t < FACE_TEXTURE_COUNT; t++)
+    {
+        chunk.first[t] = static_cast<int>(uploadScratch.size()) / ChunkMesher::FLOATS_PER_VERTEX;
+        chunk.count[t] = mesh.vertexCount(t);
+        uploadScratch.insert(uploadScratch.end(), mesh.vertices[t].begin(), mesh.vertices[t].end());
+    }
+
+    chunk.lod = mesh.lod;
+    chunk.triangles = mesh.triangleCount();
+
+    if (total == 0)
+        return true;
+
+    chunk.handle = allocateVertices(total);
+    uploadRing.upload(VBO, arena.getOffset(chunk.handle) * VERTEX_BYTES, uploadScratch.data(), total * VERTEX_BYTES);
+    return true;
+}
+
+void ChunkRenderer::draw(const OcclusionCuller& culler, const unsigned int texture[FACE_TEXTURE_COUNT])
+{
+    trianglesPerLod.fill(0);
+    chunksPerLod.fill(0);
+
+    if (VAO == 0)
+        return;
+
+    glBindVertexArray(VAO);
+
+    for (int t = 0; t < FACE_TEXTURE_COUNT; t++)
+    {
+        if (t == FIRST_FLUID_TEX)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+
+        drawFirsts.clear();
+        drawCounts.clear();
+
+        for (int cz = 0; cz < chunksZ; cz++)
+        {
+            for (int cx = 0; cx < chunksX; cx++)
+            {
+                const Chunk& chunk = chunks[cx + cz * chunksX];
+                if (chunk.lod < 0 || !culler.isVisible(cx, cz))
+                    continue;
+
+                if (t == 0)
+                {
+                    trianglesPerLod[chunk.lod] += chunk.triangles;
+                    chunksPerLod[chunk.lod]++;
+                }
+
+                if (chunk.count[t] == 0)
+                    continue;
+
+                drawFirsts.push_back(arena.getOffset(chunk.handle) + chunk.first[t]);
+                drawCounts.push_back(chunk.count[t]);
+            }
+        }
+
+        if (drawFirsts.empty())
+            continue;
+
+        glBindTexture(GL_TEXTURE_2D, texture[t]);
+        glMultiDrawArrays(GL_TRIANGLES, drawFirsts.data(), drawCounts.data(), static_cast<GLsizei>(drawFirsts.size()));
+    }
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
+
+void ChunkRenderer::release()
+{
+    for (Chunk& chunk : chunks)
+        if (chunk.pending.valid())
+            chunk.pending.wait();
+
+    uploadRing.release();
+
+    if (VAO != 0)
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        VAO = 0;
+        VBO = 0;
+    }
+    if (moveVBO != 0)
+    {
+        glDeleteBuffers(1, &moveVBO);
+        moveVBO = 0;
+        moveCapacity = 0;
+    }
+}
@@ -0,0 +1,224 @@
+#include "edit_history.h"
+#include <algorithm>
+
+void EditHistory::beginStep()
+{
+    depth++;
+}
+
+void EditHistory::endStep()
+{
+    if (depth == 0 || --depth > 0)
+        return;
+    if (recording.chunks.empty())
+        return;
+
+    for (ChunkDiff& diff : recording.chunks)
+    {
+        diff.runs.shrink_to_fit();
+        diff.cells.shrink_to_fit();
+        diff.cellPairs.shrink_to_fit();
+        diff.pairs.shrink_to_fit();
+    }
+    recording.bytes = getStepBytes(recording);
+
+    while (steps.size() > applied)
+    {
+        bytes -= steps.back().bytes;
+        steps.pop_back();
+    }
+
+    bytes += recording.bytes;
+    steps.push_back(std::move(recording));
+    recording = Step();
+    applied = steps.size();
+    lastStep = nullptr;
+    evict();
+}
+
+size_t EditHistory::getStepBytes(const Step& step)
+{
+    size_t total = sizeof(Step) + step.chunks.capacity() * sizeof(ChunkDiff);
+    for (const ChunkDiff& diff : step.chunks)
+    {
+        total += diff.runs.capacity() * sizeof(EditRun) + diff.cells.capacity() * sizeof(uint16_t) +
+                 diff.cellPairs.capacity() * sizeof(uint8_t) + diff.pairs.capacity() * sizeof(EditPair);
+    }
+    return total;
+}
+
+void EditHistory::setMaxBytes(size_t bytes)
+{
+    maxBytes = bytes;
+    lastStep = nullptr;
+    evict();
+}
+
+// Oldest first, undone steps included once nothing applied is left. The
+// newest step stays even when it alone is over the cap, so the last edit
+// can always be undone.
+void EditHistory::evict()
+{
+    while (bytes > maxBytes && steps.size() > 1)
+    {
+        bytes -= steps.front().bytes;
+        steps.pop_front();
+        if (applied > 0)
+            applied--;
+        evicted++;
+    }
+}
+
+EditHistory::ChunkDiff& EditHistory::getDiff(int chunkX, int chunkZ)
+{
+    // Edits come in runs on the same chunk, so look from the newest.
+    for (auto it = recording.chunks.rbegin(); it != recording.chunks.rend(); ++it)
+        if (it->chunkX == chunkX && it->chunkZ == chunkZ)
+            return *it;
+
+    recording.chunks.push_back({ chunkX, chunkZ, SIZE_Y, -1, {}, {}, {}, {} });
+    return recording.chunks.back();
+}
+
+// Changes are only ever merged with the one recorded just before, so the
+// order they are written back in stays the order they were made in.
+void EditHistory::addRun(ChunkDiff& diff, uint32_t start, uint32_t length, int oldBlock, int newBlock)
+{
+    bool isRunNewest = !diff.runs.empty() && diff.runs.back().cellsBefore == diff.cells.size();
+    if (isRunNewest)
+    {
+        EditRun& last = diff.runs.back();
+        if (last.start + last.length == start && last.oldBlock == oldBlock && last.newBlock == newBlock)
+        {
+            last.length += length;
+            return;
+        }
+    }
+    else if (!diff.cells.empty() && diff.cells.back() + 1u == start)
+    {
+        // The newest single change and this one make a run.
+        const EditPair& last = diff.pairs[diff.cellPairs.back()];
+        if (last.oldBlock == oldBlock && last.newBlock == newBlock)
+        {
+            start--;
+            length++;
+            diff.cells.pop_back();
+            diff.cellPairs.pop_back();
+        }
+    }
+
+    if (length == 1 && isSparse)
+    {
+        size_t pair = 0;
+        while (pair < diff.pairs.size() && (diff.pairs[pair].oldBlock != oldBlock || diff.pairs[pair].newBlock != newBlock))
+            pair++;
+        if (pair == diff.pairs.size() && pair <= UINT8_MAX)
+            diff.pairs.push_back({ static_cast<int32_t>(oldBlock), static_cast<int32_t>(newBlock) });
+        // With the palette full, the change is kept as a run of one.
+        if (pair < diff.pairs.size())
+        {
+            diff.cells.push_back(static_cast<uint16_t>(start));
+            diff.cellPairs.push_back(static_cast<uint8_t>(pair));
+            return;
+        }
+    }
+    diff.runs.push_back({ start, length, static_cast<int32_t>(oldBlock), static_cast<int32_t>(newBlock),
+                          static_cast<uint32_t>(diff.cells.size()) });
+}
+
+void EditHistory::record(int x, int y, int z, int oldBlock, int newBlock)
+{
+    if (depth == 0 || oldBlock == newBlock)
+        return;
+
+    const int size = World::CHUNK_SIZE;
+    ChunkDiff& diff = getDiff(x / size, z / size);
+    diff.minY = std::min(diff.minY, y);
+    diff.maxY = std::max(diff.maxY, y);
+    addRun(diff, static_cast<uint32_t>(World::getColumnIndex(x, y, z, SIZE_Y)), 1, oldBlock, newBlock);
+}
+
+void EditHistory::recordChunk(int chunkX, int chunkZ, const int* before, const int* after, int minY, int maxY)
+{
+    if (depth == 0)
+        return;
+
+    const int size = World::CHUNK_SIZE;
+    const bool isMorton = World::BLOCK_ORDER == ORDER_MORTON;
+    ChunkDiff* diff = nullptr;
+    // The rows minY to maxY of one z are contiguous, and in Morton order so
+    // are all the sections they cross.
+    for (int z = 0; z < (isMorton ? 1 : size); z++)
+    {
+        uint32_t i = static_cast<uint32_t>(World::getColumnIndex(0, isMorton ? minY / size * size : minY, z, SIZE_Y));
+        uint32_t end = isMorton ? static_cast<uint32_t>(World::getColumnVolume(std::min(maxY / size * size + size, SIZE_Y)))
+                                : static_cast<uint32_t>(World::getColumnIndex(0, maxY, z, SIZE_Y) + size);
+        while (i < end)
+        {
+            if (before[i] == after[i])
+            {
+                i++;
+                continue;
+            }
+
+            uint32_t start = i;
+            while (i < end && before[i] == before[start] && after[i] == after[start])
+                i++;
+
+            if (diff == nullptr)
+                diff = &getDiff(chunkX, chunkZ);
+            // A Morton run can wander up and down its sections, so it
+            // covers them whole.
+            int runMinY = World::getColumnY(static_cast<int>(start), SIZE_Y);
+            int runMaxY = World::getColumnY(static_cast<int>(i - 1), SIZE_Y);
+            if (isMorton)
+            {
+                runMinY = runMinY / size * size;
+                runMaxY = std::min(runMaxY / size * size + size - 1, SIZE_Y - 1);
+            }
+            diff->minY = std::min(diff->minY, runMinY);
+            diff->maxY = std::max(diff->maxY, runMaxY);
+            addRun(*diff, start, i - start, before[start], after[start]);
+        }
+    }
+}
+
+void EditHistory::write(World& world, const Step& step, bool isUndo, std::vector<glm::ivec2>& touched)
+{
+    const int size = World::CHUNK_SIZE;
+    touched.clear();
+    for (const ChunkDiff& diff : step.chunks)
+    {
+        world.editChunks(diff.chunkX * size, diff.minY, diff.chunkZ * size,
+                         diff.chunkX * size + size - 1, diff.maxY, diff.chunkZ * size + size - 1,
+                         [&diff, isUndo](int* blocks, const ChunkSpan&) {
+            forEachChange(diff, isUndo, [blocks](uint32_t start, uint32_t length, int, int to) {
+                std::fill_n(blocks + start, length, to);
+            });
+        });
+        touched.emplace_back(diff.chunkX, diff.chunkZ);
+    }
+
+    lastStep = &step;
+    wasUndo = isUndo;
+}
+
+bool EditHistory::undo(World& world, std::vector<glm::ivec2>& touched)
+{
+    if (applied == 0 || depth > 0)
+        return false;
+
+    applied--;
+    write(world, steps[applied], true, touched);
+    return true;
+}
+
+bool EditHistory::redo(World& world, std::vector<glm::ivec2>& touched)
+{
+    if (applied == steps.size() || depth > 0)
+        return false;
+
+    write(world, steps[applied], false, touched);
+    applied++;
+    return true;
+}
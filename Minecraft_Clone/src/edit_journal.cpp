@@ -0,0 +1,254 @@
+#include "edit_journal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t HEADER_BYTES = 2 * sizeof(uint32_t);
+    constexpr size_t CHECKED_BYTES = offsetof(BlockEdit, check);
+
+    uint32_t checksum(const BlockEdit& edit)
+    {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&edit);
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < CHECKED_BYTES; i++)
+            h = (h ^ bytes[i]) * 16777619u;
+
+        return h;
+    }
+
+    bool writeAll(int fd, const void* data, size_t size)
+    {
+        const auto* p = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, p, size);
+            if (n <= 0)
+                return false;
+
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+
+        return true;
+    }
+}
+
+EditJournal::EditJournal(std::string dir)
+    : directory(std::move(dir))
+{
+    std::filesystem::create_directories(directory);
+
+    std::vector<int> segments = listSegments();
+    openSegment(segments.empty() ? 0 : segments.back() + 1);
+
+    writer = std::thread(&EditJournal::run, this);
+}
+
+EditJournal::~EditJournal()
+{
+    close();
+}
+
+std::string EditJournal::segmentPath(int number) const
+{
+    return directory + "/journal." + std::to_string(number) + ".log";
+}
+
+std::vector<int> EditJournal::listSegments() const
+{
+    std::vector<int> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(directory))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("journal.", 0) != 0 || entry.path().extension() != ".log")
+            continue;
+
+        try {
+            segments.push_back(std::stoi(name.substr(8)));
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void EditJournal::openSegment(int number)
+{
+    std::string path = segmentPath(number);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Could not create journal segment " + path);
+
+    uint32_t header[2] = { MAGIC, VERSION };
+    if (!writeAll(fd, header, sizeof(header)))
+        throw std::runtime_error("Could not write journal segment " + path);
+
+    segment = number;
+    segmentEdits = 0;
+}
+
+ReplayStats EditJournal::replay(const std::function<void(const BlockEdit&)>& handler) const
+{
+    auto start = std::chrono::steady_clock::now();
+    ReplayStats stats;
+
+    for (int number : listSegments())
+    {
+        if (number >= segment)
+            break;
+
+        std::ifstream in(segmentPath(number), std::ios::binary | std::ios::ate);
+        std::vector<char> data(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+        uint32_t header[2] = {};
+        if (!in || data.size() < HEADER_BYTES)
+            continue;
+        std::memcpy(header, data.data(), HEADER_BYTES);
+        if (header[0] != MAGIC || header[1] != VERSION)
+            throw std::runtime_error("Invalid journal segment " + segmentPath(number));
+
+        stats.segments++;
+
+        size_t offset = HEADER_BYTES;
+        for (; offset + sizeof(BlockEdit) <= data.size(); offset += sizeof(BlockEdit))
+        {
+            BlockEdit edit;
+            std::memcpy(&edit, data.data() + offset, sizeof(edit));
+            if (edit.check != checksum(edit))
+                break;
+
+            handler(edit);
+            stats.edits++;
+        }
+
+        stats.discarded += (data.size() - offset + sizeof(BlockEdit) - 1) / sizeof(BlockEdit);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+void EditJournal::append(int x, int y, int z, int oldId, int newId, uint32_t tick)
+{
+    BlockEdit edit{ x, y, z, oldId, newId, tick, 0 };
+    edit.check = checksum(edit);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(edit);
+}
+
+bool EditJournal::commitLocked()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+    }
+    if (batch.empty())
+        return true;
+
+    // A failed write or sync may leave part of the batch in the file, so the
+    // file goes back to its last committed length and the batch goes back in
+    // front of whatever was appended since.
+    if (fd < 0 || !writeAll(fd, batch.data(), batch.size() * sizeof(BlockEdit)) || fdatasync(fd) != 0)
+    {
+        auto committedBytes = static_cast<off_t>(HEADER_BYTES + segmentEdits * sizeof(BlockEdit));
+        if (fd >= 0 && (ftruncate(fd, committedBytes) != 0 || lseek(fd, committedBytes, SEEK_SET) != committedBytes))
+            std::cout << "ERROR::JOURNAL::TRUNCATE_FAILED\n" << segmentPath(segment) << std::endl;
+        if (!isFailing)
+            std::cout << "ERROR::JOURNAL::WRITE_FAILED\n" << segmentPath(segment) << std::endl;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.insert(pending.begin(), batch.begin(), batch.end());
+        }
+        batch.clear();
+        isFailing = true;
+        failedCommits++;
+        return false;
+    }
+
+    isFailing = false;
+    segmentEdits += batch.size();
+    committedEdits += batch.size();
+    commits++;
+    if (static_cast<int>(batch.size()) > largestBatch)
+        largestBatch = static_cast<int>(batch.size());
+
+    batch.clear();
+    return true;
+}
+
+bool EditJournal::sync()
+{
+    std::lock_guard<std::mutex> lock(fileMutex);
+    return commitLocked();
+}
+
+int EditJournal::rotate()
+{
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (!commitLocked())
+        return segment - 1;
+
+    int closed = segment;
+    ::close(fd);
+    openSegment(closed + 1);
+    return closed;
+}
+
+void EditJournal::retire(int number)
+{
+    for (int s : listSegments())
+        if (s <= number)
+            std::filesystem::remove(segmentPath(s));
+}
+
+void EditJournal::run()
+{
+    while (true)
+    {
+        bool isLast;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(COMMIT_INTERVAL_MS), [this] { return isStopping; });
+            isLast = isStopping;
+        }
+
+        sync();
+        if (isLast)
+            break;
+    }
+}
+
+void EditJournal::close()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    if (!pending.empty())
+        std::cout << "ERROR::JOURNAL::EDITS_LOST\n" << pending.size() << " edits never reached " << segmentPath(segment) << std::endl;
+
+    ::close(fd);
+    fd = -1;
+    if (segmentEdits == 0)
+        std::filesystem::remove(segmentPath(segment));
+}
@@ -0,0 +1,404 @@
+#include "entity_system.h"
+#include <algorithm>
+#include <cmath>
+
+Entity EntitySystem::create(glm::vec3 position, float halfWidth, float height)
+{
+    Entity entity;
+    if (!freeEntities.empty())
+    {
+        entity = freeEntities.back();
+        freeEntities.pop_back();
+    }
+    else
+    {
+        entity = static_cast<Entity>(slots.size());
+        slots.push_back(INVALID_ENTITY);
+    }
+
+    slots[entity] = static_cast<uint32_t>(posX.size());
+    posX.push_back(position.x);
+    posY.push_back(position.y);
+    posZ.push_back(position.z);
+    velX.push_back(0.f);
+    velY.push_back(0.f);
+    velZ.push_back(0.f);
+    halfWidths.push_back(halfWidth);
+    heights.push_back(height);
+    grounded.push_back(0);
+    owners.push_back(entity);
+    isBroadphaseStale = true;
+    return entity;
+}
+
+void EntitySystem::destroy(Entity entity)
+{
+    if (!isAlive(entity))
+        return;
+
+    uint32_t slot = slots[entity];
+    uint32_t last = static_cast<uint32_t>(posX.size()) - 1;
+
+    posX[slot] = posX[last];
+    posY[slot] = posY[last];
+    posZ[slot] = posZ[last];
+    velX[slot] = velX[last];
+    velY[slot] = velY[last];
+    velZ[slot] = velZ[last];
+    halfWidths[slot] = halfWidths[last];
+    heights[slot] = heights[last];
+    grounded[slot] = grounded[last];
+    owners[slot] = owners[last];
+    slots[owners[slot]] = slot;
+
+    posX.pop_back();
+    posY.pop_back();
+    posZ.pop_back();
+    velX.pop_back();
+    velY.pop_back();
+    velZ.pop_back();
+    halfWidths.pop_back();
+    heights.pop_back();
+    grounded.pop_back();
+    owners.pop_back();
+
+    slots[entity] = INVALID_ENTITY;
+    freeEntities.push_back(entity);
+    isBroadphaseStale = true;
+}
+
+bool EntitySystem::isAlive(Entity entity) const
+{
+    return entity < slots.size() && slots[entity] != INVALID_ENTITY;
+}
+
+void EntitySystem::clear()
+{
+    posX.clear();
+    posY.clear();
+    posZ.clear();
+    velX.clear();
+    velY.clear();
+    velZ.clear();
+    halfWidths.clear();
+    heights.clear();
+    grounded.clear();
+    owners.clear();
+    slots.clear();
+    freeEntities.clear();
+    broadphase.clear();
+    pairs.clear();
+    isBroadphaseStale = true;
+}
+
+glm::vec3 EntitySystem::getPosition(Entity entity) const
+{
+    uint32_t i = slots[entity];
+    return glm::vec3(posX[i], posY[i], posZ[i]);
+}
+
+void EntitySystem::setPosition(Entity entity, glm::vec3 position)
+{
+    uint32_t i = slots[entity];
+    posX[i] = position.x;
+    posY[i] = position.y;
+    posZ[i] = position.z;
+    isBroadphaseStale = true;
+}
+
+glm::vec3 EntitySystem::getVelocity(Entity entity) const
+{
+    uint32_t i = slots[entity];
+    return glm::vec3(velX[i], velY[i], velZ[i]);
+}
+
+void EntitySystem::setVelocity(Entity entity, glm::vec3 velocity)
+{
+    uint32_t i = slots[entity];
+    velX[i] = velocity.x;
+    velY[i] = velocity.y;
+    velZ[i] = velocity.z;
+}
+
+void EntitySystem::jump(Entity entity, float speed)
+{
+    uint32_t i = slots[entity];
+    if (grounded[i])
+    {
+        velY[i] = speed;
+        grounded[i] = 0;
+    }
+}
+
+int EntitySystem::getGroundedCount() const
+{
+    int count = 0;
+    for (uint8_t g : grounded)
+        count += g;
+    return count;
+}
+
+void EntitySystem::update(const World& world, float deltaTime, JobSystem* jobs)
+{
+    if (isBroadphaseStale)
+        rebuildBroadphase();
+
+    findPairs(jobs);
+    linkPairs();
+    pushX.resize(posX.size());
+    pushZ.resize(posX.size());
+
+    // Every pass below writes only the entity it is looking at, so each job
+    // takes a run of slots through all of them.
+    auto step = [this, &world, deltaTime](size_t begin, size_t end) {
+        separate(begin, end);
+        moveHorizontal(world, deltaTime, begin, end);
+        landGrounded(world, begin, end);
+        applyGravity(deltaTime, begin, end);
+        moveVertical(deltaTime, begin, end);
+    };
+
+    size_t count = posX.size();
+    if (!jobs || count <= ENTITIES_PER_JOB)
+    {
+        step(0, count);
+    }
+    else
+    {
+        JobCounter done;
+        for (size_t begin = 0; begin < count; begin += ENTITIES_PER_JOB)
+            jobs->submit([&step, begin, end = std::min(begin + ENTITIES_PER_JOB, count)] { step(begin, end); },
+                         JobSystem::HIGH, &done);
+        jobs->wait(done);
+    }
+
+    rebuildBroadphase();
+}
+
+void EntitySystem::rebuildBroadphase()
+{
+    size_t count = posX.size();
+    boxes.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        boxes[i].min = glm::vec3(posX[i] - halfWidths[i], posY[i], posZ[i] - halfWidths[i]);
+        boxes[i].max = glm::vec3(posX[i] + halfWidths[i], posY[i] + heights[i], posZ[i] + halfWidths[i]);
+    }
+
+    broadphase.build(boxes);
+    isBroadphaseStale = false;
+}
+
+// Each job searches its own run of table slots into its own list, and the
+// lists are joined in slot order, which is the order one thread finds them in.
+void EntitySystem::findPairs(JobSystem* jobs)
+{
+    size_t slots = broadphase.getTableSize();
+    if (!jobs || slots <= PAIR_SLOTS_PER_JOB)
+    {
+        broadphase.findPairs(pairs);
+        return;
+    }
+
+    size_t batches = (slots + PAIR_SLOTS_PER_JOB - 1) / PAIR_SLOTS_PER_JOB;
+    if (pairBatches.size() < batches)
+        pairBatches.resize(batches);
+
+    JobCounter done;
+    for (size_t b = 0; b < batches; b++)
+    {
+        jobs->submit([this, b, slots] {
+            size_t first = b * PAIR_SLOTS_PER_JOB;
+            broadphase.findPairs(pairBatches[b], first, std::min(first + PAIR_SLOTS_PER_JOB, slots));
+        }, JobSystem::HIGH, &done);
+    }
+    jobs->wait(done);
+
+    pairs.clear();
+    for (size_t b = 0; b < batches; b++)
+        pairs.insert(pairs.end(), pairBatches[b].begin(), pairBatches[b].end());
+}
+
+// Lists the pairs each entity is in, in pair order.
+void EntitySystem::linkPairs()
+{
+    size_t count = posX.size();
+    pairLinkStarts.assign(count + 1, 0);
+    for (const auto& [a, b] : pairs)
+    {
+        pairLinkStarts[a + 1]++;
+        pairLinkStarts[b + 1]++;
+    }
+    for (size_t i = 0; i < count; i++)
+        pairLinkStarts[i + 1] += pairLinkStarts[i];
+
+    pairLinks.resize(pairs.size() * 2);
+    pairLinkFill.assign(pairLinkStarts.begin(), pairLinkStarts.end() - 1);
+    for (uint32_t p = 0; p < pairs.size(); p++)
+    {
+        pairLinks[pairLinkFill[pairs[p].first]++] = p;
+        pairLinks[pairLinkFill[pairs[p].second]++] = p;
+    }
+}
+
+// Overlapping entities are pushed apart along whichever of x and z overlaps
+// less, half each. Each entity adds up its own share from the boxes as they
+// stood at the start of the update, in pair order, so the result does not
+// depend on how the slots were split between jobs. The push goes through
+// moveHorizontal, so it never moves an entity into a block.
+void EntitySystem::separate(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        pushX[i] = 0.f;
+        pushZ[i] = 0.f;
+
+        for (uint32_t link = pairLinkStarts[i]; link < pairLinkStarts[i + 1]; link++)
+        {
+            const auto& [a, b] = pairs[pairLinks[link]];
+            const Aabb& boxA = boxes[a];
+            const Aabb& boxB = boxes[b];
+            float overlapX = std::min(boxA.max.x, boxB.max.x) - std::max(boxA.min.x, boxB.min.x);
+            float overlapZ = std::min(boxA.max.z, boxB.max.z) - std::max(boxA.min.z, boxB.min.z);
+            float sign = i == a ? 1.f : -1.f;
+
+            if (overlapX < overlapZ)
+            {
+                float side = boxA.min.x + boxA.max.x < boxB.min.x + boxB.max.x ? -0.5f : 0.5f;
+                pushX[i] += sign * side * overlapX;
+            }
+            else
+            {
+                float side = boxA.min.z + boxA.max.z < boxB.min.z + boxB.max.z ? -0.5f : 0.5f;
+                pushZ[i] += sign * side * overlapZ;
+            }
+        }
+    }
+}
+
+bool EntitySystem::coversBlock(uint32_t slot, int x, int y, int z) const
+{
+    return x >= static_cast<int>(round(posX[slot] - halfWidths[slot])) && x <= static_cast<int>(round(posX[slot] + halfWidths[slot])) &&
+           y >= static_cast<int>(round(posY[slot])) && y <= static_cast<int>(round(posY[slot] + heights[slot])) &&
+           z >= static_cast<int>(round(posZ[slot] - halfWidths[slot])) && z <= static_cast<int>(round(posZ[slot] + halfWidths[slot]));
+}
+
+bool EntitySystem::isBlockOccupied(int x, int y, int z) const
+{
+    if (isBroadphaseStale)
+    {
+        for (uint32_t i = 0; i < posX.size(); i++)
+            if (coversBlock(i, x, y, z))
+                return true;
+        return false;
+    }
+
+    // Slightly larger than the cell, as boxes ending exactly on its faces
+    // still round onto it.
+    const float reach = 0.5f + 0.01f;
+    std::vector<uint32_t> candidates;
+    broadphase.queryAabb({ glm::vec3(x, y, z) - reach, glm::vec3(x, y, z) + reach }, candidates);
+    for (uint32_t i : candidates)
+        if (coversBlock(i, x, y, z))
+            return true;
+    return false;
+}
+
+bool EntitySystem::isColliding(const World& world, glm::vec3 position, float halfWidth, float height)
+{
+    int minX = static_cast<int>(round(position.x - halfWidth));
+    int maxX = static_cast<int>(round(position.x + halfWidth));
+    int minY = static_cast<int>(round(position.y));
+    int maxY = static_cast<int>(round(position.y + height));
+    int minZ = static_cast<int>(round(position.z - halfWidth));
+    int maxZ = static_cast<int>(round(position.z + halfWidth));
+
+    for (int x = minX; x <= maxX; x++)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int z = minZ; z <= maxZ; z++)
+            {
+                if (world.isOutOfWorld(x, y, z))
+                    continue;
+
+                if (world.isBlockSolidUnchecked(x, y, z))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool EntitySystem::isOnGround(const World& world, float x, float y, float z, float halfWidth)
+{
+    int xMin = static_cast<int>(round(x - halfWidth));
+    int xMax = static_cast<int>(round(x + halfWidth));
+    int yBelow = static_cast<int>(floor(y));
+    int zMin = static_cast<int>(round(z - halfWidth));
+    int zMax = static_cast<int>(round(z + halfWidth));
+
+    if (world.isOutOfWorld(xMin, yBelow, zMin) || world.isOutOfWorld(xMax, yBelow, zMax))
+        return false;
+
+    return world.isBlockSolid(xMin, yBelow, zMin) || world.isBlockSolid(xMax, yBelow, zMax) ||
+           world.isBlockSolid(xMax, yBelow, zMin) || world.isBlockSolid(xMin, yBelow, zMax);
+}
+
+// Each axis is tried on its own so an entity slides along a wall instead of
+// sticking to it.
+void EntitySystem::moveHorizontal(const World& world, float deltaTime, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        float stepX = velX[i] * deltaTime + pushX[i];
+        float stepZ = velZ[i] * deltaTime + pushZ[i];
+        if (stepX == 0.f && stepZ == 0.f)
+            continue;
+
+        float x = posX[i];
+        float z = posZ[i];
+        float nextX = x + stepX;
+        float nextZ = z + stepZ;
+
+        if (!isColliding(world, glm::vec3(nextX, posY[i], z), halfWidths[i], heights[i]))
+            posX[i] = nextX;
+        if (!isColliding(world, glm::vec3(x, posY[i], nextZ), halfWidths[i], heights[i]))
+            posZ[i] = nextZ;
+    }
+}
+
+void EntitySystem::landGrounded(const World& world, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        grounded[i] = isOnGround(world, posX[i], posY[i], posZ[i], halfWidths[i]);
+        if (grounded[i])
+        {
+            velY[i] = 0.f;
+            posY[i] = floor(posY[i]) + 1.f;
+        }
+    }
+}
+
+// Branch free so the compiler can vectorise it.
+void EntitySystem::applyGravity(float deltaTime, size_t begin, size_t end)
+{
+    float* vy = velY.data();
+    const uint8_t* g = grounded.data();
+    for (size_t i = begin; i < end; i++)
+    {
+        float v = vy[i] + GRAVITY * deltaTime;
+        v = v < TERMINAL_VELOCITY ? TERMINAL_VELOCITY : v;
+        vy[i] = g[i] ? vy[i] : v;
+    }
+}
+
+void EntitySystem::moveVertical(float deltaTime, size_t begin, size_t end)
+{
+    float* y = posY.data();
+    const float* vy = velY.data();
+    for (size_t i = begin; i < end; i++)
+        y[i] += vy[i] * deltaTime;
+}
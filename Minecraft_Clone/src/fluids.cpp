@@ -0,0 +1,264 @@
+#include "fluids.h"
+#include <algorithm>
+
+namespace {
+    bool isInSameSection(glm::ivec3 p, int dx, int dy, int dz)
+    {
+        return World::Section::isInside(World::Section::toLocalX(p.x) + dx, World::Section::toLocalY(p.y) + dy,
+                                        World::Section::toLocalZ(p.z) + dz);
+    }
+
+    // The block DX, DY, DZ away from p, which is in the world at index in
+    // blocks. Outside the world reads as stone: it holds fluid up and in.
+    template<int DX, int DY, int DZ>
+    int readNeighbour(const World& world, const int* blocks, glm::ivec3 p, int index)
+    {
+        glm::ivec3 c = p + glm::ivec3(DX, DY, DZ);
+        if (world.isOutOfWorld(c.x, c.y, c.z))
+            return BLOCK_STONE;
+        if (isInSameSection(p, DX, DY, DZ))
+            return blocks[World::getNeighbourIndex<DX, DY, DZ>(index, world.WORLD_Y)];
+        return world.getBlockUnchecked(c.x, c.y, c.z);
+    }
+}
+
+FluidSimulator::FluidSimulator(int sizeX, int sizeY, int sizeZ)
+    : SIZE_X(sizeX), SIZE_Y(sizeY), SIZE_Z(sizeZ),
+      chunksX((sizeX + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE)
+{
+    int count = chunksX * ((sizeZ + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE);
+    chunks.resize(count);
+    isQueued.resize(count, 0);
+    isFrozen.resize(count, 0);
+}
+
+void FluidSimulator::queue(int chunk, uint32_t cell)
+{
+    if (!isQueued[chunk])
+    {
+        queuedChunks.push_back(chunk);
+        isQueued[chunk] = 1;
+    }
+    chunks[chunk].queued.push_back(cell);
+}
+
+// A cell reads itself, its six neighbours and the cells under its four
+// horizontal neighbours, so a change is seen by the cell, its neighbours and
+// the four cells beside the one above it. Those in p's section are stepped
+// to from p's index.
+template<typename Visit>
+void FluidSimulator::forEachDependent(glm::ivec3 p, Visit visit) const
+{
+    const int size = World::CHUNK_SIZE;
+    auto isInWorld = [this](glm::ivec3 c) {
+        return c.x >= 0 && c.x < SIZE_X && c.y >= 0 && c.y < SIZE_Y && c.z >= 0 && c.z < SIZE_Z;
+    };
+    bool isPInWorld = isInWorld(p);
+    int chunk = isPInWorld ? p.x / size + (p.z / size) * chunksX : -1;
+    int index = isPInWorld ? World::getColumnIndex(p.x, p.y, p.z, SIZE_Y) : 0;
+
+    auto dependent = [&]<int DX, int DY, int DZ>() {
+        glm::ivec3 c = p + glm::ivec3(DX, DY, DZ);
+        if (!isInWorld(c))
+            return;
+
+        if (isPInWorld && isInSameSection(p, DX, DY, DZ))
+            visit(chunk, static_cast<uint32_t>(World::getNeighbourIndex<DX, DY, DZ>(index, SIZE_Y)));
+        else
+            visit(c.x / size + (c.z / size) * chunksX, static_cast<uint32_t>(World::getColumnIndex(c.x, c.y, c.z, SIZE_Y)));
+    };
+
+    dependent.template operator()<0, 0, 0>();
+    dependent.template operator()<1, 0, 0>();
+    dependent.template operator()<-1, 0, 0>();
+    dependent.template operator()<0, 1, 0>();
+    dependent.template operator()<0, -1, 0>();
+    dependent.template operator()<0, 0, 1>();
+    dependent.template operator()<0, 0, -1>();
+    dependent.template operator()<1, 1, 0>();
+    dependent.template operator()<-1, 1, 0>();
+    dependent.template operator()<0, 1, 1>();
+    dependent.template operator()<0, 1, -1>();
+}
+
+void FluidSimulator::activate(int x, int y, int z)
+{
+    forEachDependent(glm::ivec3(x, y, z), [this](int chunk, uint32_t cell) { queue(chunk, cell); });
+}
+
+void FluidSimulator::activateChunk(const World& world, int chunkX, int chunkZ)
+{
+    const int size = World::CHUNK_SIZE;
+    const int* blocks = world.getChunkBlocks(chunkX, chunkZ);
+
+    for (int z = 0; z < size; z++)
+        for (int y = 0; y < SIZE_Y; y++)
+            for (int x = 0; x < size; x++)
+                if (isFluid(blocks[world.getColumnIndex(x, y, z)]) && !world.isOutOfWorld(chunkX * size + x, y, chunkZ * size + z))
+                    activate(chunkX * size + x, y, chunkZ * size + z);
+}
+
+void FluidSimulator::setChunkFrozen(int chunkX, int chunkZ, bool frozen)
+{
+    isFrozen[chunkX + chunkZ * chunksX] = frozen;
+}
+
+size_t FluidSimulator::getQueuedCount() const
+{
+    size_t total = 0;
+    for (int chunk : queuedChunks)
+        total += chunks[chunk].queued.size();
+    return total;
+}
+
+int FluidSimulator::getNextBlock(const World& world, glm::ivec3 p, int block) const
+{
+    if (World::isSolidBlock(block))
+        return block;
+
+    const int* blocks = world.getChunkBlocks(World::Section::toChunkX(p.x), World::Section::toChunkZ(p.z));
+    int index = World::getColumnIndex(p.x, p.y, p.z, SIZE_Y);
+    auto at = [&]<int DX, int DY, int DZ>() { return readNeighbour<DX, DY, DZ>(world, blocks, p, index); };
+
+    auto isWater = [&]<int DX, int DY, int DZ>() { return World::getBlockType(at.template operator()<DX, DY, DZ>()) == BLOCK_WATER; };
+    auto touchesWater = [&]() {
+        return isWater.template operator()<0, 1, 0>() || isWater.template operator()<0, -1, 0>() ||
+               isWater.template operator()<1, 0, 0>() || isWater.template operator()<-1, 0, 0>() ||
+               isWater.template operator()<0, 0, 1>() || isWater.template operator()<0, 0, -1>();
+    };
+
+    int type = World::getBlockType(block);
+    if (isFluid(block) && getLevel(block) == SOURCE_LEVEL)
+        return type == BLOCK_LAVA && touchesWater() ? static_cast<int>(BLOCK_STONE) : block;
+
+    int bestType = BLOCK_AIR;
+    int bestLevel = 0;
+    auto offer = [&](int fluidType, int level) {
+        if (level > bestLevel || (level == bestLevel && fluidType == BLOCK_WATER))
+        {
+            bestType = fluidType;
+            bestLevel = level;
+        }
+    };
+
+    int above = at.template operator()<0, 1, 0>();
+    if (isFluid(above))
+        offer(World::getBlockType(above), FALLING_LEVEL);
+
+    auto spreadFrom = [&]<int DX, int DZ>() {
+        int neighbour = at.template operator()<DX, 0, DZ>();
+        if (!isFluid(neighbour))
+            return;
+
+        // Fluid with open space under it falls instead of spreading.
+        int level = getLevel(neighbour);
+        int support = at.template operator()<DX, -1, DZ>();
+        if (level != SOURCE_LEVEL && !World::isSolidBlock(support) && !isFluid(support))
+            return;
+
+        int fluidType = World::getBlockType(neighbour);
+        offer(fluidType, level - (fluidType == BLOCK_LAVA ? 2 : 1));
+    };
+    spreadFrom.template operator()<1, 0>();
+    spreadFrom.template operator()<-1, 0>();
+    spreadFrom.template operator()<0, 1>();
+    spreadFrom.template operator()<0, -1>();
+
+    if (bestLevel <= 0)
+        return BLOCK_AIR;
+    if (bestType == BLOCK_LAVA && touchesWater())
+        return BLOCK_STONE;
+    return makeFluid(bestType, bestLevel);
+}
+
+void FluidSimulator::stepChunk(World& world, int chunk)
+{
+    const int size = World::CHUNK_SIZE;
+    ChunkCells& cells = chunks[chunk];
+    glm::ivec3 corner((chunk % chunksX) * size, 0, (chunk / chunksX) * size);
+
+    for (uint32_t cell : cells.cells)
+    {
+        int index = static_cast<int>(cell);
+        glm::ivec3 p = corner + glm::ivec3(World::getColumnX(index), World::getColumnY(index, SIZE_Y), World::getColumnZ(index, SIZE_Y));
+        if (world.isOutOfWorld(p.x, p.y, p.z))
+            continue;
+
+        int block = world.getBlockUnchecked(p.x, p.y, p.z);
+        int next = getNextBlock(world, p, block);
+        if (next == block)
+            continue;
+
+        world.setBlock(p.x, p.y, p.z, next);
+        cells.changed++;
+        forEachDependent(p, [&cells](int other, uint32_t dependent) { cells.handOver.emplace_back(other, dependent); });
+    }
+}
+
+void FluidSimulator::step(World& world, JobSystem* jobs)
+{
+    changedChunks.clear();
+    stepped = 0;
+    changed = 0;
+
+    for (std::vector<int>& phase : phaseChunks)
+        phase.clear();
+
+    heldChunks.clear();
+    for (int chunk : queuedChunks)
+    {
+        if (isFrozen[chunk])
+        {
+            heldChunks.push_back(chunk);
+            continue;
+        }
+
+        ChunkCells& cells = chunks[chunk];
+        cells.cells.swap(cells.queued);
+        cells.queued.clear();
+        std::sort(cells.cells.begin(), cells.cells.end());
+        cells.cells.erase(std::unique(cells.cells.begin(), cells.cells.end()), cells.cells.end());
+        cells.changed = 0;
+        stepped += cells.cells.size();
+        isQueued[chunk] = 0;
+
+        int chunkX = chunk % chunksX;
+        int chunkZ = chunk / chunksX;
+        world.makeChunkPrivate(chunkX, chunkZ);
+        phaseChunks[(chunkX & 1) + (chunkZ & 1) * 2].push_back(chunk);
+    }
+    steppedChunks = static_cast<int>(queuedChunks.size() - heldChunks.size());
+    queuedChunks.swap(heldChunks);
+
+    for (const std::vector<int>& phase : phaseChunks)
+    {
+        if (jobs == nullptr || phase.size() < 2)
+        {
+            for (int chunk : phase)
+                stepChunk(world, chunk);
+            continue;
+        }
+
+        JobCounter done;
+        for (int chunk : phase)
+            jobs->submit([this, &world, chunk] { stepChunk(world, chunk); }, JobSystem::HIGH, &done);
+        jobs->wait(done);
+    }
+
+    // Each chunk's queue is sorted before it is stepped, so the order cells
+    // are handed over in makes no difference.
+    for (const std::vector<int>& phase : phaseChunks)
+    {
+        for (int chunk : phase)
+        {
+            ChunkCells& cells = chunks[chunk];
+            if (cells.changed > 0)
+                changedChunks.push_back(glm::ivec2(chunk % chunksX, chunk / chunksX));
+            changed += cells.changed;
+
+            for (const auto& [other, cell] : cells.handOver)
+                queue(other, cell);
+            cells.handOver.clear();
+        }
+    }
+}
@@ -3,26 +3,455 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm.hpp>
+#include <algorithm>
+#include <chrono>
+
+#include "world_snapshot.h"
+
+namespace {
+    double nowSeconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void printHistogram(const char* name, const LatencyHistogram& hist)
+    {
+        std::cout << name << " latency (" << hist.total << " requests, max " << hist.maxMs << " ms):";
+        for (int i = 0; i < LatencyHistogram::BUCKETS; i++)
+        {
+            if (hist.counts[i] == 0)
+                continue;
+
+            if (i == LatencyHistogram::BUCKETS - 1)
+                std::cout << " >=" << (1 << (i - 1)) << "ms:" << hist.counts[i];
+            else
+                std::cout << " <" << (1 << i) << "ms:" << hist.counts[i];
+        }
+        std::cout << std::endl;
+    }
+
+    // Plays straight from the mapped snapshot when one exists; region files
+    // then only hold the chunks edited since it was written.
+    World openWorld(const std::string& snapshotPath)
+    {
+        try {
+            if (auto snapshot = WorldSnapshot::open(snapshotPath))
+                return World(snapshot);
+        }
+        catch (const std::exception& e) {
+            std::cout << "ERROR::WORLD::SNAPSHOT_FAILED\n" << e.what() << std::endl;
+        }
+
+        return World(64, 8, 64);
+    }
+}
 
 Game::Game()
-    : world(64, 8, 64),
-      camera(glm::vec3(32.f, 8.f + PLAYER_HEIGHT, 32.f))
+    : world(openWorld(SNAPSHOT_PATH)),
+      camera(glm::vec3(32.f, 8.f + PLAYER_HEIGHT, 32.f)),
+      blockTicks(world.WORLD_X, world.WORLD_Y, world.WORLD_Z),
+      fluids(world.WORLD_X, world.WORLD_Y, world.WORLD_Z),
+      history(world.WORLD_Y, UNDO_HISTORY_BYTES),
+      chunkIO(SAVE_DIR, world.WORLD_Y),
+      journal(JOURNAL_DIR),
+      renderWorld(world),
+      culler(renderWorld),
+      chunkRenderer(renderWorld, jobs)
 {
     physics.setGame(this);
+    player = entities.create(camera.position - glm::vec3(0.f, PLAYER_HEIGHT, 0.f), PLAYER_RADIUS, PLAYER_HEIGHT);
+    previousPosition = camera.position;
+
+    unsavedChunks.resize(world.getChunksX() * world.getChunksZ(), 0);
+    changedChunks.resize(world.getChunksX() * world.getChunksZ(), 0);
+    recoveredEdits.resize(world.getChunksX() * world.getChunksZ());
+    loadedChunks.resize(world.getChunksX() * world.getChunksZ(), 0);
+    earlyEdits.resize(world.getChunksX() * world.getChunksZ());
+
+    try {
+        ReplayStats stats = journal.replay([this](const BlockEdit& edit) {
+            if (!world.isOutOfWorld(edit.x, edit.y, edit.z))
+                recoveredEdits[edit.x / World::CHUNK_SIZE + (edit.z / World::CHUNK_SIZE) * world.getChunksX()].push_back(edit);
+        });
+        if (stats.segments > 0)
+            std::cout << "recovered " << stats.edits << " edits from " << stats.segments << " journal segments in "
+                      << stats.seconds * 1000.0 << " ms, " << stats.discarded << " torn records dropped" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cout << "ERROR::JOURNAL::REPLAY_FAILED\n" << e.what() << std::endl;
+    }
+
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            fluids.setChunkFrozen(cx, cz, true);
+            chunkIO.requestLoad(cx, cz);
+            pendingLoads++;
+        }
+    }
 }
 
 void Game::setShader(Shader shaderProg) {
     shader = shaderProg;
 }
 
-void Game::setTexture(const unsigned int tex[3])
+void Game::setTexture(const unsigned int tex[FACE_TEXTURE_COUNT])
 {
-    texture[0] = tex[0];
-    texture[1] = tex[1];
-    texture[2] = tex[2];
+    std::copy(tex, tex + FACE_TEXTURE_COUNT, texture);
+}
+
+void Game::setBlock(int x, int y, int z, int value)
+{
+    int oldBlock = world.getBlock(x, y, z);
+    journal.append(x, y, z, oldBlock, value, tick);
+    history.record(x, y, z, oldBlock, value);
+    world.setBlock(x, y, z, value);
+    fluids.activate(x, y, z);
+    markBlockChanged(x, z);
+    recordEarlyEdit(x, y, z, oldBlock, value);
+    unsavedChunks[x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * world.getChunksX()] = 1;
+}
+
+void Game::recordEarlyEdit(int x, int y, int z, int from, int to)
+{
+    int i = x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * world.getChunksX();
+    if (!loadedChunks[i])
+        earlyEdits[i].push_back({ x, y, z, from, to, tick, 0 });
+}
+
+void Game::scheduleBlockTick(int x, int y, int z, uint32_t delay)
+{
+    blockTicks.schedule(x, y, z, delay);
+    unsavedChunks[x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * world.getChunksX()] = 1;
+}
+
+void Game::runBlockTicks()
+{
+    blockTicks.advance(dueTicks);
+    for (const glm::ivec3& cell : dueTicks)
+    {
+        // The saved copy still lists this tick as pending.
+        unsavedChunks[cell.x / World::CHUNK_SIZE + (cell.z / World::CHUNK_SIZE) * world.getChunksX()] = 1;
+        updateBlock(cell.x, cell.y, cell.z);
+    }
+}
+
+void Game::runRandomTicks()
+{
+    double start = nowSeconds();
+    randomTicks.run(world, blockChanges);
+    for (const BlockChange& change : blockChanges)
+    {
+        if (!loadedChunks[change.cell.x / World::CHUNK_SIZE + (change.cell.z / World::CHUNK_SIZE) * world.getChunksX()])
+            continue;
+        if (world.getBlock(change.cell.x, change.cell.y, change.cell.z) != change.value)
+            setBlock(change.cell.x, change.cell.y, change.cell.z, change.value);
+    }
+    randomTickMsTotal += (nowSeconds() - start) * 1000.0;
+}
+
+void Game::runFluids()
+{
+    double start = nowSeconds();
+    fluids.step(world, &jobs);
+    for (const glm::ivec2& chunk : fluids.getChangedChunks())
+    {
+        markChunkChanged(chunk.x, chunk.y);
+        unsavedChunks[chunk.x + chunk.y * world.getChunksX()] = 1;
+    }
+    fluidMsTotal += (nowSeconds() - start) * 1000.0;
+}
+
+void Game::applyHistory(bool isUndo)
+{
+    bool isApplied = isUndo ? history.undo(world, historyChunks) : history.redo(world, historyChunks);
+    if (!isApplied)
+        return;
+
+    history.forEachLastChange([this](int x, int y, int z, int from, int to) {
+        journal.append(x, y, z, from, to, tick);
+        fluids.activate(x, y, z);
+        recordEarlyEdit(x, y, z, from, to);
+    });
+    for (const glm::ivec2& chunk : historyChunks)
+    {
+        markChunkChanged(chunk.x, chunk.y);
+        unsavedChunks[chunk.x + chunk.y * world.getChunksX()] = 1;
+    }
+}
+
+void Game::updateBlock(int, int, int)
+{
+    // No block type reacts to scheduled ticks yet.
+}
+
+void Game::handleIOCompletion(const ChunkIO::Completion& done)
+{
+    int i = done.chunkX + done.chunkZ * world.getChunksX();
+
+    if (!done.error.empty())
+    {
+        std::cout << "ERROR::WORLD::" << (done.type == ChunkIO::LOAD ? "LOAD" : "SAVE") << "_FAILED\n" << done.error << std::endl;
+        // Keep the journal until a later autosave gets the chunk to disk.
+        if (done.type == ChunkIO::SAVE)
+        {
+            unsavedChunks[i] = 1;
+            hasSaveFailed = true;
+        }
+    }
+    else if (done.type == ChunkIO::LOAD)
+    {
+        // Never saved: generated terrain has to be written out once, while a
+        // snapshot chunk is already on disk.
+        if (!done.isFound)
+        {
+            if (!world.hasSnapshot())
+                unsavedChunks[i] = 1;
+        }
+        else
+        {
+            world.setChunk(done.chunkX, done.chunkZ, done.blocks);
+            blockTicks.setPending(done.chunkX, done.chunkZ, done.ticks);
+            markChunkChanged(done.chunkX, done.chunkZ);
+        }
+    }
+
+    if (done.type == ChunkIO::LOAD)
+    {
+        // Edits from the last run come first, then the ones made to the
+        // generated terrain while the saved copy was on its way.
+        applyEdits(recoveredEdits[i], done.chunkX, done.chunkZ);
+        applyEdits(earlyEdits[i], done.chunkX, done.chunkZ);
+        loadedChunks[i] = 1;
+        pendingLoads--;
+        fluids.setChunkFrozen(done.chunkX, done.chunkZ, false);
+        fluids.activateChunk(world, done.chunkX, done.chunkZ);
+    }
+
+    // Pages that failed to sync may be gone even if a later sync succeeds, so
+    // every chunk is written again and the journal stays until then.
+    if (!done.flushError.empty())
+    {
+        std::cout << "ERROR::WORLD::FLUSH_FAILED\n" << done.flushError << std::endl;
+        std::fill(unsavedChunks.begin(), unsavedChunks.end(), 1);
+        hasSaveFailed = true;
+    }
+
+    // Only a completion whose sync covered every save up to the rotation
+    // makes the segment redundant.
+    if (retireSegment >= 0 && done.isFlushed && done.sequence + 1 >= retireAfterRequest)
+    {
+        if (!hasSaveFailed)
+            journal.retire(retireSegment);
+
+        retireSegment = -1;
+        hasSaveFailed = false;
+    }
+}
+
+void Game::applyEdits(std::vector<BlockEdit>& edits, int chunkX, int chunkZ)
+{
+    if (edits.empty())
+        return;
+
+    for (const BlockEdit& edit : edits)
+    {
+        world.setBlock(edit.x, edit.y, edit.z, edit.newId);
+        fluids.activate(edit.x, edit.y, edit.z);
+    }
+
+    edits = {};
+    unsavedChunks[chunkX + chunkZ * world.getChunksX()] = 1;
+    markChunkChanged(chunkX, chunkZ);
+}
+
+void Game::saveUnsavedChunks()
+{
+    // A chunk saved before its load arrived would overwrite the saved copy
+    // with generated terrain.
+    if (pendingLoads > 0 || std::find(unsavedChunks.begin(), unsavedChunks.end(), 1) == unsavedChunks.end())
+        return;
+
+    // Every edit in the closed segment is older than the snapshots queued below,
+    // so the segment can go once they are on disk.
+    int closedSegment = journal.rotate();
+
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            char& isUnsaved = unsavedChunks[cx + cz * world.getChunksX()];
+            if (!isUnsaved)
+                continue;
+
+            blockTicks.getPending(cx, cz, pendingTicks);
+            chunkIO.requestSave(cx, cz, world.snapshotChunk(cx, cz), pendingTicks);
+            isUnsaved = 0;
+        }
+    }
+
+    retireSegment = closedSegment;
+    retireAfterRequest = chunkIO.getRequestCount();
+}
+
+void Game::setProjection(const glm::mat4& proj)
+{
+    projection = proj;
+}
+
+void Game::markBlockChanged(int x, int z)
+{
+    frames.getWriteBuffer().dirtyBlocks.emplace_back(x, z);
+    changedChunks[x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * world.getChunksX()] = 1;
+}
+
+void Game::markChunkChanged(int chunkX, int chunkZ)
+{
+    frames.getWriteBuffer().dirtyChunks.emplace_back(chunkX, chunkZ);
+    changedChunks[chunkX + chunkZ * world.getChunksX()] = 1;
+}
+
+void Game::publishRenderState()
+{
+    RenderState& state = frames.getWriteBuffer();
+    state.tick = tick;
+    state.tickTime = nowSeconds();
+    state.previousPosition = previousPosition;
+    state.position = camera.position;
+    state.front = camera.front;
+    state.up = camera.up;
+    state.hasTarget = physics.hasTarget;
+    state.targetedBlock = physics.targetedBlock;
+
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            char& isChanged = changedChunks[cx + cz * world.getChunksX()];
+            if (isChanged)
+                state.chunkUpdates.push_back({ cx, cz, world.snapshotChunk(cx, cz) });
+            isChanged = 0;
+        }
+    }
+
+    // A state the render thread skipped comes back still holding its
+    // changes, so they ride along with the next one instead of being lost.
+    if (frames.publish())
+    {
+        droppedStates++;
+        return;
+    }
+
+    RenderState& next = frames.getWriteBuffer();
+    next.dirtyBlocks.clear();
+    next.dirtyChunks.clear();
+    next.chunkUpdates.clear();
+}
+
+void Game::tickSimulation(const InputState& in)
+{
+    tick++;
+    previousPosition = camera.position;
+    physics.breakTimer += TICK_SECONDS;
+    physics.placeTimer += TICK_SECONDS;
+
+    chunkIO.drainCompletions([this](const ChunkIO::Completion& done) { handleIOCompletion(done); });
+    autosaveTimer += TICK_SECONDS;
+    if(autosaveTimer >= AUTOSAVE_INTERVAL)
+    {
+        saveUnsavedChunks();
+        autosaveTimer = 0.f;
+    }
+
+    camera.processMouseInput(in.mouseX, in.mouseY);
+    physics.targetBlock(camera.position, camera.front);
+    applyInput(in);
+    runBlockTicks();
+    runRandomTicks();
+    runFluids();
+
+    double entityStart = nowSeconds();
+    entities.update(world, TICK_SECONDS, &jobs);
+    entityMsTotal += (nowSeconds() - entityStart) * 1000.0;
+    camera.position = entities.getPosition(player) + glm::vec3(0.f, PLAYER_HEIGHT, 0.f);
+
+    if (in.isStats)
+        printSimStats();
+
+    publishRenderState();
+}
+
+void Game::runSimulation()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto tickLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(TICK_SECONDS));
+    auto nextTick = Clock::now();
+
+    while (isSimRunning)
+    {
+        InputState in;
+        {
+            std::lock_guard<std::mutex> lock(inputMutex);
+            in = input;
+            input.mouseX = 0.f;
+            input.mouseY = 0.f;
+            input.isStats = false;
+            input.isUndo = false;
+            input.isRedo = false;
+        }
+
+        auto start = Clock::now();
+        tickSimulation(in);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        tickMsTotal += ms;
+        tickMsMax = std::max(tickMsMax, ms);
+        tickCount++;
+
+        // After a long stall, start counting again rather than racing to catch up.
+        nextTick += tickLength;
+        if (Clock::now() - nextTick > tickLength * 4)
+            nextTick = Clock::now();
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Game::startSimulation()
+{
+    // Gives the first frame a camera to draw from.
+    publishRenderState();
+
+    isSimRunning = true;
+    simThread = std::thread(&Game::runSimulation, this);
+}
+
+void Game::stopSimulation()
+{
+    isSimRunning = false;
+    if (simThread.joinable())
+        simThread.join();
+}
+
+void Game::applyRenderState(const RenderState& state)
+{
+    for (const ChunkUpdate& update : state.chunkUpdates)
+        renderWorld.adoptChunk(update.chunkX, update.chunkZ, update.snapshot);
+
+    for (const glm::ivec2& block : state.dirtyBlocks)
+    {
+        culler.markDirty(block.x, block.y);
+        chunkRenderer.markDirty(block.x, block.y);
+    }
+    for (const glm::ivec2& chunk : state.dirtyChunks)
+    {
+        culler.markDirty(chunk.x * World::CHUNK_SIZE, chunk.y * World::CHUNK_SIZE);
+        chunkRenderer.markChunkDirty(chunk.x, chunk.y);
+    }
 }
 
 void Game::run(GLFWwindow *window) {
+    startSimulation();
+
     while(!glfwWindowShouldClose(window))
     {
         glClearColor(1.f, 1.f, 1.f, 1.f);
@@ -31,33 +460,39 @@ void Game::run(GLFWwindow *window) {
         auto currFrame = static_cast<float>(glfwGetTime());
         deltaTime = currFrame - lastFrame;
         lastFrame = currFrame;
-        physics.breakTimer += deltaTime;
-        physics.placeTimer += deltaTime;
+        frameCount++;
+        frameMsTotal += deltaTime * 1000.0;
+        frameMsMax = std::max(frameMsMax, deltaTime * 1000.0);
 
-        physics.targetBlock(camera.position, camera.front);
         processInput(window);
-        camera.position.y += physics.applyGravity(camera.position, PLAYER_RADIUS, PLAYER_HEIGHT, deltaTime);
 
-        shader.use();
-        glm::mat4 view = camera.getViewMatrix();
-        shader.setMat4("view", view);
+        if (frames.consume())
+            applyRenderState(frames.getReadBuffer());
+        const RenderState& state = frames.getReadBuffer();
 
-        for (int x = 0; x < world.WORLD_X; x++) {
-            for (int y = 0; y < world.WORLD_Y; y++) {
-                for (int z = 0; z < world.WORLD_Z; z++) {
-                    if(!world.isBlockSolid(x, y, z))
-                        continue;
+        // The simulation runs at a fixed rate, so draw the camera between its
+        // last two positions according to how far into the tick this frame is.
+        float alpha = std::clamp(static_cast<float>((nowSeconds() - state.tickTime) / TICK_SECONDS), 0.f, 1.f);
+        glm::vec3 eye = glm::mix(state.previousPosition, state.position, alpha);
+        glm::mat4 view = glm::lookAt(eye, eye + state.front, state.up);
 
-                    glm::mat4 model = glm::mat4(1.0f);
-                    model = glm::translate(model, glm::vec3(x, y, z));
-                    shader.setMat4("model", model);
+        // The cull runs on a worker while this thread collects meshes and
+        // uploads them; only draw needs its result. Neither side writes
+        // anything the other reads.
+        culler.updateOccluders();
+        glm::mat4 cullViewProj = projection * view;
+        auto cullTask = jobs.async(JobSystem::HIGH, [this, cullViewProj] { culler.cull(cullViewProj); });
 
-                    renderBlock(x, y, z);
-                }
-            }
-        }
+        shader.use();
+        shader.setMat4("view", view);
 
-        if(physics.hasTarget)
+        chunkRenderer.update(eye);
+        shader.setMat4("model", glm::mat4(1.0f));
+        cullTask.get();
+        chunkRenderer.draw(culler, texture);
+        glBindVertexArray(blockVAO);
+
+        if(state.hasTarget)
         {
             glEnable(GL_POLYGON_OFFSET_LINE);
             glPolygonOffset(-1.0f, -1.0f);
@@ -66,7 +501,7 @@ void Game::run(GLFWwindow *window) {
             glLineWidth(3.0f);
 
             glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(physics.targetedBlock));
+            model = glm::translate(model, glm::vec3(state.targetedBlock));
             model = glm::scale(model, glm::vec3(1.01f));
             shader.setMat4("model", model);
 
@@ -79,53 +514,148 @@ void Game::run(GLFWwindow *window) {
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+
+    stopSimulation();
+    chunkRenderer.release();
+    shutdown();
 }
 
-void Game::renderBlock(int x, int y, int z) const
+void Game::runHeadless(float seconds, float frameMs)
 {
-    if (y == world.WORLD_Y - 1)
     {
-        glBindTexture(GL_TEXTURE_2D, texture[2]);
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.isForward = true;
+    }
 
-        if (x == 0 || !world.isBlockSolid(x-1, y, z))
-            glDrawArrays(GL_TRIANGLES, 12, 6);
-        if (x == world.WORLD_X-1 || !world.isBlockSolid(x+1, y, z))
-            glDrawArrays(GL_TRIANGLES, 18, 6);
-        if (z == 0 || !world.isBlockSolid(x, y, z-1))
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-        if (z == world.WORLD_Z-1 || !world.isBlockSolid(x, y, z+1))
-            glDrawArrays(GL_TRIANGLES, 6, 6);
+    startSimulation();
 
-        if (!world.isBlockSolid(x, y-1, z)) {
-            glBindTexture(GL_TEXTURE_2D, texture[0]);
-            glDrawArrays(GL_TRIANGLES, 24, 6);
-        }
+    glm::mat4 headlessProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.01f, 100.f);
+    double start = nowSeconds();
+    int frameTotal = 0;
+    int consumed = 0;
+    double latencyMs = 0.0;
 
-        glBindTexture(GL_TEXTURE_2D, texture[1]);
-        glDrawArrays(GL_TRIANGLES, 30, 6);
-    }
-    else
+    while (nowSeconds() - start < seconds)
     {
-        glBindTexture(GL_TEXTURE_2D, texture[0]);
+        double frameStart = nowSeconds();
+        if (frames.consume())
+        {
+            applyRenderState(frames.getReadBuffer());
+            latencyMs += (frameStart - frames.getReadBuffer().tickTime) * 1000.0;
+            consumed++;
+        }
 
-        if (x == 0 || !world.isBlockSolid(x-1, y, z))
-            glDrawArrays(GL_TRIANGLES, 12, 6);
+        const RenderState& state = frames.getReadBuffer();
+        culler.updateOccluders();
+        culler.cull(headlessProjection * glm::lookAt(state.position, state.position + state.front, state.up));
 
-        if (x == world.WORLD_X-1 || !world.isBlockSolid(x+1, y, z))
-            glDrawArrays(GL_TRIANGLES, 18, 6);
+        // Stand-in for GL submission and vsync.
+        double remainingMs = frameMs - (nowSeconds() - frameStart) * 1000.0;
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(std::max(remainingMs, 0.0)));
+        frameTotal++;
+    }
 
-        if (y == 0 || !world.isBlockSolid(x, y-1, z))
-            glDrawArrays(GL_TRIANGLES, 24, 6);
+    stopSimulation();
 
-        if (!world.isBlockSolid(x, y+1, z))
-            glDrawArrays(GL_TRIANGLES, 30, 6);
+    double elapsed = nowSeconds() - start;
+    std::cout << "headless " << frameMs << " ms frames: " << frameTotal / elapsed << " frames/s, " << tickCount / elapsed
+              << " ticks/s (target " << TICK_RATE << "), tick avg " << tickMsTotal / std::max(tickCount, 1) << " ms, max "
+              << tickMsMax << " ms, " << consumed << " states consumed, " << droppedStates << " skipped, state age avg "
+              << latencyMs / std::max(consumed, 1) << " ms" << std::endl;
 
-        if (z == 0 || !world.isBlockSolid(x, y, z-1))
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+    shutdown();
+}
 
-        if (z == world.WORLD_Z-1 || !world.isBlockSolid(x, y, z+1))
-            glDrawArrays(GL_TRIANGLES, 6, 6);
+void Game::shutdown()
+{
+    // The last save waits for every load, like autosaves do.
+    while (pendingLoads > 0)
+    {
+        chunkIO.drainCompletions([this](const ChunkIO::Completion& done) { handleIOCompletion(done); });
+        std::this_thread::yield();
     }
+
+    saveUnsavedChunks();
+    chunkIO.shutdown([this](const ChunkIO::Completion& done) { handleIOCompletion(done); });
+    journal.close();
+    printHistogram("save", chunkIO.getSaveLatency());
+}
+
+void Game::printSimStats()
+{
+    std::cout << "simulation: " << tickCount << " ticks, avg " << tickMsTotal / std::max(tickCount, 1) << " ms, max "
+              << tickMsMax << " ms, " << droppedStates << " states skipped by the renderer" << std::endl;
+    std::cout << "entities: " << entities.getCount() << ", " << entities.getGroundedCount() << " grounded, update avg "
+              << entityMsTotal / std::max(tickCount, 1) << " ms" << std::endl;
+    const SpatialHash& broadphase = entities.getBroadphase();
+    std::cout << "broadphase: " << broadphase.getCellCount() << " cells of " << broadphase.getCellSize() << ", max "
+              << broadphase.getMaxCellOccupancy() << " per cell, " << broadphase.getAverageProbes() << " probes per insert, "
+              << entities.getPairCount() << " overlapping pairs" << std::endl;
+    std::cout << "block ticks: " << blockTicks.getPendingCount() << " pending in " << blockTicks.getActiveChunkCount()
+              << " chunks, " << blockTicks.getDispatchedCount() << " run so far" << std::endl;
+    std::cout << "random ticks: avg " << randomTickMsTotal / std::max(tickCount, 1) << " ms, last tick "
+              << randomTicks.getSectionsTicked() << " sections ticked, " << randomTicks.getSectionsSkipped() << " skipped, "
+              << randomTicks.getBlocksTicked() << " blocks ticked" << std::endl;
+    std::cout << "fluids: avg " << fluidMsTotal / std::max(tickCount, 1) << " ms, last tick "
+              << fluids.getSteppedCount() << " cells in " << fluids.getSteppedChunkCount() << " chunks, "
+              << fluids.getChangedCount() << " changed, " << fluids.getChangedChunks().size() << " chunks remeshed, "
+              << fluids.getQueuedCount() << " queued" << std::endl;
+    std::cout << "undo history: " << history.getStepCount() - history.getUndoneCount() << " steps to undo, "
+              << history.getUndoneCount() << " to redo, " << history.getBytes() / 1024.0 << " of "
+              << history.getMaxBytes() / 1024.0 << " KB, " << history.getEvictedCount() << " evicted" << std::endl;
+    tickCount = 0;
+    tickMsTotal = 0.0;
+    tickMsMax = 0.0;
+    entityMsTotal = 0.0;
+    randomTickMsTotal = 0.0;
+    fluidMsTotal = 0.0;
+
+    std::cout << "world: " << world.getPrivateChunkCount() << "/" << world.getChunksX() * world.getChunksZ()
+              << " chunks private" << (world.hasSnapshot() ? ", rest read from the mapped snapshot" : "")
+              << ", " << world.getCopyOnWriteCount() << " copied on write" << std::endl;
+    std::cout << "journal: " << journal.getCommittedEdits() << " edits in " << journal.getCommits() << " commits, largest batch "
+              << journal.getLargestBatch() << std::endl;
+    std::cout << "chunk io: queue depth " << chunkIO.getQueueDepth() << " (max " << chunkIO.getMaxQueueDepth() << "), "
+              << chunkIO.getCoalescedSaves() << " saves coalesced" << std::endl;
+    printHistogram("load", chunkIO.getLoadLatency());
+    printHistogram("save", chunkIO.getSaveLatency());
+}
+
+void Game::printRenderStats()
+{
+    std::cout << "render: " << frameCount << " frames, avg " << frameMsTotal / std::max(frameCount, 1) << " ms, max "
+              << frameMsMax << " ms" << std::endl;
+    frameCount = 0;
+    frameMsTotal = 0.0;
+    frameMsMax = 0.0;
+
+    const auto& triangles = chunkRenderer.getTrianglesPerLod();
+    const auto& chunks = chunkRenderer.getChunksPerLod();
+
+    std::cout << "chunks visible: " << culler.getVisibleCount() << ", occluders: " << culler.getOccluderCount() << std::endl;
+    for (int lod = 0; lod < ChunkRenderer::LOD_LEVELS; lod++)
+        std::cout << "lod " << lod << ": " << chunks[lod] << " chunks, " << triangles[lod] << " triangles" << std::endl;
+
+    const VertexArena& arena = chunkRenderer.getArena();
+    std::cout << "vertex arena: " << arena.getUsed() << "/" << arena.getCapacity() << " vertices, "
+              << arena.getFreeBlockCount() << " free blocks, fragmentation " << arena.getFragmentation() << std::endl;
+
+    const UploadRing& ring = chunkRenderer.getUploadRing();
+    std::cout << "uploads: " << ring.getTotalBytes() << " bytes total, " << ring.getDeferredCount() << " deferred, "
+              << ring.getOrphanCount() << " orphaned, " << ring.getMapFallbackCount() << " map fallbacks" << std::endl;
+
+    const auto workerStats = jobs.getWorkerStats();
+    for (size_t i = 0; i < workerStats.size(); i++)
+        std::cout << "worker " << i << ": " << workerStats[i].jobs << " jobs, " << workerStats[i].steals << " steals, "
+                  << workerStats[i].utilisation * 100.0 << "% busy" << std::endl;
+    jobs.resetStats();
+}
+
+void Game::processMouseInput(float xOffset, float yOffset)
+{
+    std::lock_guard<std::mutex> lock(inputMutex);
+    input.mouseX += xOffset;
+    input.mouseY += yOffset;
 }
 
 void Game::processInput(GLFWwindow *window)
@@ -133,31 +663,71 @@ void Game::processInput(GLFWwindow *window)
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    bool isStatsKey = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    bool isStatsPressed = isStatsKey && !isStatsKeyDown;
+    if(isStatsPressed)
+        printRenderStats();
+    isStatsKeyDown = isStatsKey;
+
+    bool isControl = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS;
+    bool isUndoKey = isControl && glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+    bool isRedoKey = isControl && glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+    bool isUndoPressed = isUndoKey && !isUndoKeyDown;
+    bool isRedoPressed = isRedoKey && !isRedoKeyDown;
+    isUndoKeyDown = isUndoKey;
+    isRedoKeyDown = isRedoKey;
+
+    std::lock_guard<std::mutex> lock(inputMutex);
+    input.isStats = input.isStats || isStatsPressed;
+    input.isUndo = input.isUndo || isUndoPressed;
+    input.isRedo = input.isRedo || isRedoPressed;
+    input.isBreak = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    input.isPlace = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    input.isJump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    input.isForward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.isBackward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.isRight = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    input.isLeft = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+        input.selectedBlock = BLOCK_DIRT;
+    else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+        input.selectedBlock = FluidSimulator::makeFluid(BLOCK_WATER, FluidSimulator::SOURCE_LEVEL);
+    else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+        input.selectedBlock = FluidSimulator::makeFluid(BLOCK_LAVA, FluidSimulator::SOURCE_LEVEL);
+}
+
+void Game::applyInput(const InputState& in)
+{
+    history.beginStep();
+    if(in.isBreak)
         physics.breakBlock();
 
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
-        physics.placeBlock(camera.position, PLAYER_HEIGHT, PLAYER_RADIUS);
+    if(in.isPlace)
+        physics.placeBlock(in.selectedBlock);
+    history.endStep();
 
+    if(in.isUndo)
+        applyHistory(true);
 
-    if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-    {
-        physics.jump();
-    }
+    if(in.isRedo)
+        applyHistory(false);
 
-    glm::vec3 lastPos = camera.position;
+    if(in.isJump)
+        entities.jump(player, PLAYER_JUMP_SPEED);
 
-    if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.processKeyInput(FORWARD, deltaTime, false);
-    if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.processKeyInput(BACKWARD, deltaTime, false);
-    if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.processKeyInput(RIGHT, deltaTime, false);
-    if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.processKeyInput(LEFT, deltaTime, false);
+    glm::vec3 moveFront = glm::normalize(glm::vec3(camera.front.x, 0.f, camera.front.z));
+    glm::vec3 move(0.f);
 
-    if(physics.checkCollision(PLAYER_HEIGHT, PLAYER_RADIUS, glm::vec3(camera.position.x, lastPos.y, lastPos.z)))
-        camera.position.x = lastPos.x;
-    if(physics.checkCollision(PLAYER_HEIGHT, PLAYER_RADIUS, glm::vec3(lastPos.x, lastPos.y, camera.position.z)))
-        camera.position.z = lastPos.z;
-}
\ No newline at end of file
+    if(in.isForward)
+        move += moveFront;
+    if(in.isBackward)
+        move -= moveFront;
+    if(in.isRight)
+        move += camera.right;
+    if(in.isLeft)
+        move -= camera.right;
+
+    move *= camera.moveSpeed;
+    entities.setVelocity(player, glm::vec3(move.x, entities.getVelocity(player).y, move.z));
+}
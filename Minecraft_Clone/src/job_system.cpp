@@ -0,0 +1,230 @@
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    constexpr int SPINS_BEFORE_SLEEP = 64;
+
+    // Identifies the pool and slot of the calling worker thread.
+    thread_local const void* currentPool = nullptr;
+    thread_local int currentIndex = -1;
+    // Jobs run inside JobSystem::wait nest, and only the outermost one counts as busy time.
+    thread_local int jobDepth = 0;
+
+    long long nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+JobSystem::JobSystem(int workerCount)
+{
+    if (workerCount <= 0)
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        auto worker = std::make_unique<Worker>();
+        for (auto& deque : worker->deques)
+            deque = std::make_unique<WorkStealingDeque<Job>>(DEQUE_CAPACITY);
+        workers.push_back(std::move(worker));
+    }
+
+    statsStartNs = nowNs();
+    for (int i = 0; i < workerCount; i++)
+        workers[i]->thread = std::thread(&JobSystem::run, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isStopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+int JobSystem::currentWorker() const
+{
+    return currentPool == this ? currentIndex : -1;
+}
+
+void JobSystem::submit(std::function<void()> task, Priority priority, JobCounter* counter)
+{
+    if (counter != nullptr)
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = new Job{ std::move(task), counter };
+    queued.fetch_add(1);
+
+    int self = currentWorker();
+    if (self < 0 || !workers[self]->deques[priority]->push(job))
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected[priority].push_back(job);
+    }
+
+    if (sleepers.load() > 0)
+    {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+JobSystem::Job* JobSystem::findJob(int self)
+{
+    int count = static_cast<int>(workers.size());
+
+    for (int p = 0; p < PRIORITY_COUNT; p++)
+    {
+        if (self >= 0)
+        {
+            if (Job* job = workers[self]->deques[p]->pop())
+                return job;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(injectMutex);
+            if (!injected[p].empty())
+            {
+                Job* job = injected[p].front();
+                injected[p].pop_front();
+                return job;
+            }
+        }
+
+        // Start at a different victim per thief so they do not all hit the same deque.
+        int start = self >= 0 ? self + 1 : 0;
+        for (int i = 0; i < count; i++)
+        {
+            int victim = (start + i) % count;
+            if (victim == self)
+                continue;
+
+            if (Job* job = workers[victim]->deques[p]->steal())
+            {
+                if (self >= 0)
+                    workers[self]->steals++;
+                return job;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+JobSystem::Job* JobSystem::findInjected(const JobCounter& counter)
+{
+    std::lock_guard<std::mutex> lock(injectMutex);
+    for (auto& queue : injected)
+    {
+        auto it = std::find_if(queue.begin(), queue.end(), [&counter](const Job* job) { return job->counter == &counter; });
+        if (it != queue.end())
+        {
+            Job* job = *it;
+            queue.erase(it);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void JobSystem::execute(Job* job, int self)
+{
+    queued.fetch_sub(1);
+
+    long long start = nowNs();
+    jobDepth++;
+    job->task();
+    jobDepth--;
+
+    if (self >= 0)
+    {
+        if (jobDepth == 0)
+            workers[self]->busyNs += nowNs() - start;
+        workers[self]->jobs++;
+    }
+
+    if (job->counter != nullptr)
+        job->counter->count.fetch_sub(1, std::memory_order_release);
+
+    delete job;
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+    int self = currentWorker();
+    while (!counter.isDone())
+    {
+        if (Job* job = self >= 0 ? findJob(self) : findInjected(counter))
+            execute(job, self);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::run(int self)
+{
+    currentPool = this;
+    currentIndex = self;
+
+    int idleSpins = 0;
+    while (true)
+    {
+        if (Job* job = findJob(self))
+        {
+            execute(job, self);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < SPINS_BEFORE_SLEEP)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        wake.wait(lock, [this] { return isStopping || queued.load() > 0; });
+        sleepers--;
+
+        // Finish everything already queued before shutting down.
+        if (isStopping && queued.load() == 0)
+            break;
+        idleSpins = 0;
+    }
+}
+
+std::vector<WorkerStats> JobSystem::getWorkerStats() const
+{
+    double elapsedNs = static_cast<double>(nowNs() - statsStartNs);
+
+    std::vector<WorkerStats> stats;
+    for (const auto& worker : workers)
+    {
+        WorkerStats s;
+        s.jobs = worker->jobs;
+        s.steals = worker->steals;
+        s.utilisation = elapsedNs > 0.0 ? worker->busyNs / elapsedNs : 0.0;
+        stats.push_back(s);
+    }
+
+    return stats;
+}
+
+void JobSystem::resetStats()
+{
+    for (auto& worker : workers)
+    {
+        worker->jobs = 0;
+        worker->steals = 0;
+        worker->busyNs = 0;
+    }
+
+    statsStartNs = nowNs();
+}
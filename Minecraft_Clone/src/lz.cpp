@@ -0,0 +1,163 @@
+#include "lz.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    constexpr int MIN_MATCH = 4;
+    constexpr int HASH_BITS = 12;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr size_t END_LITERALS = 5;
+
+    uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint32_t hash(uint32_t v)
+    {
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void writeLength(std::vector<uint8_t>& out, size_t len)
+    {
+        while (len >= 255)
+        {
+            out.push_back(255);
+            len -= 255;
+        }
+        out.push_back(static_cast<uint8_t>(len));
+    }
+
+    void emitSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t litLen, size_t offset, size_t matchLen)
+    {
+        size_t m = matchLen - MIN_MATCH;
+        out.push_back(static_cast<uint8_t>(((litLen < 15 ? litLen : 15) << 4) | (m < 15 ? m : 15)));
+        if (litLen >= 15)
+            writeLength(out, litLen - 15);
+
+        out.insert(out.end(), literals, literals + litLen);
+
+        out.push_back(static_cast<uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (m >= 15)
+            writeLength(out, m - 15);
+    }
+
+    void emitLastLiterals(std::vector<uint8_t>& out, const uint8_t* literals, size_t litLen)
+    {
+        out.push_back(static_cast<uint8_t>((litLen < 15 ? litLen : 15) << 4));
+        if (litLen >= 15)
+            writeLength(out, litLen - 15);
+
+        out.insert(out.end(), literals, literals + litLen);
+    }
+
+    size_t readLength(const uint8_t*& ip, const uint8_t* end)
+    {
+        size_t len = 0;
+        uint8_t b;
+        do
+        {
+            if (ip >= end)
+                throw std::runtime_error("Truncated compressed data");
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+
+        return len;
+    }
+}
+
+namespace lz
+{
+    std::vector<uint8_t> compress(const uint8_t* data, size_t size)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(size + size / 255 + 16);
+
+        size_t anchor = 0;
+        size_t ip = 0;
+
+        if (size > MIN_MATCH + END_LITERALS)
+        {
+            std::vector<uint32_t> table(1 << HASH_BITS, 0);
+            size_t matchLimit = size - END_LITERALS;
+
+            while (ip + MIN_MATCH <= matchLimit)
+            {
+                uint32_t seq = read32(data + ip);
+                uint32_t h = hash(seq);
+                size_t ref = table[h];
+                table[h] = static_cast<uint32_t>(ip + 1);
+
+                if (ref == 0 || ip - (ref - 1) > MAX_OFFSET || read32(data + ref - 1) != seq)
+                {
+                    ip++;
+                    continue;
+                }
+
+                ref--;
+                size_t len = MIN_MATCH;
+                while (ip + len < matchLimit && data[ref + len] == data[ip + len])
+                    len++;
+
+                emitSequence(out, data + anchor, ip - anchor, ip - ref, len);
+                ip += len;
+                anchor = ip;
+            }
+        }
+
+        emitLastLiterals(out, data + anchor, size - anchor);
+        return out;
+    }
+
+    std::vector<uint8_t> decompress(const uint8_t* data, size_t size, size_t rawSize)
+    {
+        std::vector<uint8_t> out(rawSize);
+        const uint8_t* ip = data;
+        const uint8_t* end = data + size;
+        size_t op = 0;
+
+        while (ip < end)
+        {
+            uint8_t token = *ip++;
+
+            size_t litLen = token >> 4;
+            if (litLen == 15)
+                litLen += readLength(ip, end);
+
+            if (litLen > static_cast<size_t>(end - ip) || litLen > rawSize - op)
+                throw std::runtime_error("Corrupt compressed literals");
+
+            std::memcpy(out.data() + op, ip, litLen);
+            ip += litLen;
+            op += litLen;
+
+            if (ip == end)
+                break;
+
+            if (end - ip < 2)
+                throw std::runtime_error("Truncated compressed data");
+
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+
+            size_t matchLen = (token & 15) + MIN_MATCH;
+            if ((token & 15) == 15)
+                matchLen += readLength(ip, end);
+
+            if (offset == 0 || offset > op || matchLen > rawSize - op)
+                throw std::runtime_error("Corrupt compressed match");
+
+            for (size_t i = 0; i < matchLen; i++, op++)
+                out[op] = out[op - offset];
+        }
+
+        if (op != rawSize)
+            throw std::runtime_error("Compressed data size mismatch");
+
+        return out;
+    }
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm.hpp>
@@ -10,6 +11,9 @@
 
 #include "shader.h"
 #include "game.h"
+#include "region.h"
+#include "world_snapshot.h"
+#include "benchmarks.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
@@ -21,9 +25,11 @@ float lastX = winWidth / 2.f;
 float lastY = winHeight / 2.f;
 bool isFirstMouse = true;
 
-Game game;
+// Only the windowed run has a game for the callbacks to reach; the other
+// modes never start one.
+Game* game = nullptr;
 
-unsigned int texture[3];
+unsigned int texture[FACE_TEXTURE_COUNT];
 
 float vertices[] = {
     -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
@@ -69,8 +75,126 @@ float vertices[] = {
     -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
 };
 
-int main()
+int main(int argc, char* argv[])
 {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--bench-snapshot")
+    {
+        runSnapshotBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-region")
+    {
+        return runRegionBenchmark() ? 0 : 1;
+    }
+    if (mode == "--headless")
+    {
+        // Simulates without a window; the optional argument is how long each stand-in frame takes.
+        Game headless;
+        headless.runHeadless(5.f, argc > 2 ? std::stof(argv[2]) : 50.f);
+        return 0;
+    }
+    if (mode == "--bench-jobs")
+    {
+        runJobBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-cow")
+    {
+        runCopyOnWriteBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-entities")
+    {
+        runEntityBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-broadphase")
+    {
+        runBroadphaseBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-physics")
+    {
+        runPhysicsBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-raycast")
+    {
+        return runRaycastBenchmark() ? 0 : 1;
+    }
+    if (mode == "--bench-voxel-tree")
+    {
+        runVoxelTreeBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-block-ticks")
+    {
+        runBlockTickBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-random-ticks")
+    {
+        runRandomTickBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-fluids")
+    {
+        runFluidBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-world-edit")
+    {
+        runWorldEditBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-edit-history")
+    {
+        runEditHistoryBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-block-access")
+    {
+        runBlockAccessBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-chunk-layout")
+    {
+        runChunkLayoutBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-journal")
+    {
+        runJournalBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-cull")
+    {
+        return runCullBenchmark() ? 0 : 1;
+    }
+    if (mode == "--bench-upload-ring")
+    {
+        runUploadRingBenchmark();
+        return 0;
+    }
+    if (mode == "--bench-vertex-arena")
+    {
+        runVertexArenaBenchmark();
+        return 0;
+    }
+    if (mode == "--write-snapshot")
+    {
+        // Bakes the current save, edits included, into a snapshot that later runs map instead of load.
+        auto snapshot = WorldSnapshot::open(Game::SNAPSHOT_PATH);
+        World world = snapshot ? World(snapshot) : World(64, 8, 64);
+        WorldStorage(Game::SAVE_DIR).load(world);
+        WorldSnapshot::write(world, Game::SNAPSHOT_PATH);
+        return 0;
+    }
+
+    Game windowed;
+    game = &windowed;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -105,7 +229,7 @@ int main()
     data[1] = stbi_load("../images/grass.jpg", &img_w[1], &img_h[1], &nrChannels[1], 0);
     data[2] = stbi_load("../images/grass_side.jpg", &img_w[2], &img_h[2], &nrChannels[2], 0);
 
-    glGenTextures(3, texture);
+    glGenTextures(FACE_TEXTURE_COUNT, texture);
     glActiveTexture(GL_TEXTURE0);
 
     for(int i = 0; i < 3; i++)
@@ -122,6 +246,20 @@ int main()
         stbi_image_free(data[i]);
     }
 
+    // The rest have no pictures yet, so each is a single flat colour.
+    const unsigned char flatColours[FACE_TEXTURE_COUNT - 3][4] = {
+        { 128, 128, 128, 255 },
+        { 40, 90, 210, 160 },
+        { 230, 90, 20, 255 }
+    };
+    for (int i = 3; i < FACE_TEXTURE_COUNT; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, flatColours[i - 3]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)nullptr);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -136,13 +274,15 @@ int main()
 
     shader.setMat4("projection", projection);
 
-    game.setShader(shader);
-    game.setTexture(texture);
+    game->setShader(shader);
+    game->setTexture(texture);
+    game->setProjection(projection);
+    game->setBlockVAO(VAO);
 
     glEnable(GL_DEPTH_TEST);
     glBindVertexArray(VAO);
 
-    game.run(window);
+    game->run(window);
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -174,5 +314,5 @@ void mouse_callback(GLFWwindow *window, double xPos, double yPos)
     lastX = x;
     lastY = y;
 
-    game.processMouseInput(xOffset, yOffset);
+    game->processMouseInput(xOffset, yOffset);
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "mesher.h"
+#include <algorithm>
+
+#include "world.h"
+
+namespace {
+    const int FACE_DIRS[6][3] = {
+        { -1, 0, 0 }, { 1, 0, 0 },
+        { 0, -1, 0 }, { 0, 1, 0 },
+        { 0, 0, -1 }, { 0, 0, 1 }
+    };
+
+    void emitFace(std::vector<float>& out, int dir, const float lo[3], const float hi[3])
+    {
+        int axis = dir / 2;
+        bool isPositive = dir % 2 == 1;
+        int a = axis == 0 ? 2 : 0;
+        int b = axis == 1 ? 2 : 1;
+
+        float extA = hi[a] - lo[a];
+        float extB = hi[b] - lo[b];
+        const float st[4][2] = { { 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f }, { 0.f, 1.f } };
+        const int order[6] = { 0, 1, 2, 2, 3, 0 };
+
+        for (int i : order)
+        {
+            float p[3];
+            p[axis] = isPositive ? hi[axis] : lo[axis];
+            p[a] = lo[a] + st[i][0] * extA;
+            p[b] = lo[b] + st[i][1] * extB;
+
+            float u = st[i][0] * extA;
+            float v = axis == 1 ? st[i][1] * extB : (1.f - st[i][1]) * extB;
+
+            out.insert(out.end(), { p[0], p[1], p[2], u, v });
+        }
+    }
+
+    int getFaceTexture(int type, int dir)
+    {
+        switch (type)
+        {
+            case BLOCK_GRASS: return dir == 3 ? GRASS_TOP_TEX : dir == 2 ? DIRT_TEX : GRASS_SIDE_TEX;
+            case BLOCK_STONE: return STONE_TEX;
+            case BLOCK_WATER: return WATER_TEX;
+            case BLOCK_LAVA: return LAVA_TEX;
+            default: return DIRT_TEX;
+        }
+    }
+}
+
+int ChunkMesh::triangleCount() const
+{
+    int count = 0;
+    for (int t = 0; t < FACE_TEXTURE_COUNT; t++)
+        count += vertexCount(t) / 3;
+    return count;
+}
+
+ChunkNeighbourhood ChunkMesher::snapshot(const World& world, int chunkX, int chunkZ)
+{
+    ChunkNeighbourhood area;
+    area.chunkX = chunkX;
+    area.chunkZ = chunkZ;
+    area.worldX = world.WORLD_X;
+    area.worldY = world.WORLD_Y;
+    area.worldZ = world.WORLD_Z;
+
+    for (int dz = 0; dz < 3; dz++)
+        for (int dx = 0; dx < 3; dx++)
+            area.chunks[dz][dx] = world.snapshotChunk(chunkX + dx - 1, chunkZ + dz - 1);
+
+    return area;
+}
+
+ChunkVolume ChunkMesher::capture(const ChunkNeighbourhood& area)
+{
+    const int size = World::CHUNK_SIZE;
+
+    ChunkVolume v;
+    v.originX = area.chunkX * size;
+    v.originZ = area.chunkZ * size;
+    v.sizeX = std::min(size, area.worldX - v.originX);
+    v.sizeY = area.worldY;
+    v.sizeZ = std::min(size, area.worldZ - v.originZ);
+    v.types.resize((v.sizeX + 2) * (v.sizeY + 2) * (v.sizeZ + 2), BLOCK_AIR);
+
+    int i = 0;
+    for (int z = -1; z <= v.sizeZ; z++)
+    {
+        int dz = z < 0 ? 0 : (z >= size ? 2 : 1);
+        int lz = z - (dz - 1) * size;
+
+        for (int y = -1; y <= v.sizeY; y++)
+        {
+            for (int x = -1; x <= v.sizeX; x++, i++)
+            {
+                int dx = x < 0 ? 0 : (x >= size ? 2 : 1);
+                const ChunkSnapshot& chunk = area.chunks[dz][dx];
+                if (!chunk.isValid() || y < 0 || y >= v.sizeY)
+                    continue;
+
+                // Cells of edge chunks past the world border are stored as air.
+                int lx = x - (dx - 1) * size;
+                v.types[i] = static_cast<uint8_t>(World::getBlockType(chunk.blocks[World::getColumnIndex(lx, y, lz, area.worldY)]));
+            }
+        }
+    }
+
+    return v;
+}
+
+int ChunkMesher::getCellType(const ChunkVolume& volume, int x0, int y0, int z0, int scale)
+{
+    // The first few distinct types met and how often each came up. Rows are
+    // scanned from the top so a tie goes to the upper block, keeping grass
+    // on distant ground.
+    const int maxTypes = 8;
+    int types[maxTypes];
+    int counts[maxTypes];
+    int distinct = 0;
+    int solid = 0;
+    int filled = 0;
+    int total = 0;
+
+    for (int z = z0; z < std::min(z0 + scale, volume.sizeZ); z++)
+    {
+        for (int y = std::min(y0 + scale, volume.sizeY) - 1; y >= y0; y--)
+        {
+            for (int x = x0; x < std::min(x0 + scale, volume.sizeX); x++)
+            {
+                total++;
+                int type = volume.getType(x, y, z);
+                if (type == BLOCK_AIR)
+                    continue;
+
+                filled++;
+                solid += World::isSolidBlock(type);
+                int k = 0;
+                while (k < distinct && types[k] != type)
+                    k++;
+                if (k == distinct)
+                {
+                    if (distinct == maxTypes)
+                        continue;
+                    types[distinct] = type;
+                    counts[distinct++] = 0;
+                }
+                counts[k]++;
+            }
+        }
+    }
+
+    // Mostly solid cells are solid and otherwise mostly filled ones fluid,
+    // either way of their commonest such type.
+    if (total == 0 || filled * 2 < total)
+        return BLOCK_AIR;
+    bool isSolid = solid * 2 >= total;
+    int best = -1;
+    for (int k = 0; k < distinct; k++)
+        if (World::isSolidBlock(types[k]) == isSolid && (best < 0 || counts[k] > counts[best]))
+            best = k;
+    return best < 0 ? BLOCK_AIR : types[best];
+}
+
+ChunkMesh ChunkMesher::build(const ChunkVolume& volume, int lod)
+{
+    ChunkMesh mesh;
+    mesh.lod = lod;
+
+    int scale = 1 << lod;
+    int cellsX = (volume.sizeX + scale - 1) / scale;
+    int cellsY = (volume.sizeY + scale - 1) / scale;
+    int cellsZ = (volume.sizeZ + scale - 1) / scale;
+
+    int strideY = cellsX + 2;
+    int strideZ = (cellsX + 2) * (cellsY + 2);
+    std::vector<uint8_t> cells(strideZ * (cellsZ + 2), BLOCK_AIR);
+    auto cellIndex = [&](int x, int y, int z) { return (x + 1) + (y + 1) * strideY + (z + 1) * strideZ; };
+
+    for (int z = -1; z <= cellsZ; z++)
+    {
+        for (int y = -1; y <= cellsY; y++)
+        {
+            for (int x = -1; x <= cellsX; x++)
+            {
+                bool isBorder = x < 0 || x >= cellsX || y < 0 || y >= cellsY || z < 0 || z >= cellsZ;
+                if (!isBorder)
+                    cells[cellIndex(x, y, z)] = static_cast<uint8_t>(getCellType(volume, x * scale, y * scale, z * scale, scale));
+                else if (lod == 0)
+                    cells[cellIndex(x, y, z)] = static_cast<uint8_t>(volume.getType(x, y, z));
+            }
+        }
+    }
+
+    for (int z = 0; z < cellsZ; z++)
+    {
+        for (int y = 0; y < cellsY; y++)
+        {
+            for (int x = 0; x < cellsX; x++)
+            {
+                int type = cells[cellIndex(x, y, z)];
+                if (type == BLOCK_AIR)
+                    continue;
+
+                int y1 = std::min((y + 1) * scale, volume.sizeY);
+
+                float lo[3] = {
+                    static_cast<float>(volume.originX + x * scale) - 0.5f,
+                    static_cast<float>(y * scale) - 0.5f,
+                    static_cast<float>(volume.originZ + z * scale) - 0.5f
+                };
+                float hi[3] = {
+                    static_cast<float>(volume.originX + std::min((x + 1) * scale, volume.sizeX)) - 0.5f,
+                    static_cast<float>(y1) - 0.5f,
+                    static_cast<float>(volume.originZ + std::min((z + 1) * scale, volume.sizeZ)) - 0.5f
+                };
+
+                for (int dir = 0; dir < 6; dir++)
+                {
+                    int neighbour = cells[cellIndex(x + FACE_DIRS[dir][0], y + FACE_DIRS[dir][1], z + FACE_DIRS[dir][2])];
+                    if (neighbour == type || World::isSolidBlock(neighbour))
+                        continue;
+
+                    emitFace(mesh.vertices[getFaceTexture(type, dir)], dir, lo, hi);
+                }
+            }
+        }
+    }
+
+    return mesh;
+}
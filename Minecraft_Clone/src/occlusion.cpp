@@ -0,0 +1,642 @@
+#include "occlusion.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "world.h"
+
+namespace {
+    constexpr int LEVELS = 8;
+    constexpr float NEAR_W = 0.01f;
+    constexpr float FIRST_BAND_DEPTH = 16.f;
+
+    // The screen fills the depth buffer but for a band a pixel wide around
+    // it. Occluders just off screen land in the band, so eroding the buffer
+    // leaves the screen's own edge alone; boxes are only tested on screen.
+    glm::vec2 toBuffer(const glm::vec3& ndc)
+    {
+        return glm::vec2((ndc.x * 0.5f + 0.5f) * (OcclusionCuller::DEPTH_W - 2) + 1.f,
+                         (ndc.y * 0.5f + 0.5f) * (OcclusionCuller::DEPTH_H - 2) + 1.f);
+    }
+}
+
+OcclusionCuller::OcclusionCuller(const World& w)
+    : world(w), chunksX(w.getChunksX()), chunksZ(w.getChunksZ()), sectionsY(w.getSectionsY())
+{
+    int sections = chunksX * chunksZ * sectionsY;
+    occluders.resize(sections);
+    dirty.resize(chunksX * chunksZ, 1);
+    isSectionEmpty.resize(sections, 0);
+    sectionDepth.resize(sections, 0.f);
+    visible.resize(sections, 1);
+    visibleColumns.resize(chunksX * chunksZ, 1);
+
+    maxDepth.resize(LEVELS);
+    minDepth.resize(LEVELS);
+    for (int l = 0; l < LEVELS; l++)
+    {
+        maxDepth[l].resize(levelWidth(l) * levelHeight(l), 1.f);
+        minDepth[l].resize(levelWidth(l) * levelHeight(l), 1.f);
+    }
+    rasterDepth.resize(DEPTH_W * DEPTH_H, 1.f);
+    filterScratch.resize(DEPTH_W * DEPTH_H);
+}
+
+void OcclusionCuller::markDirty(int x, int z)
+{
+    if (x < 0 || x >= world.WORLD_X || z < 0 || z >= world.WORLD_Z)
+        return;
+
+    dirty[x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * chunksX] = 1;
+}
+
+void OcclusionCuller::updateOccluders()
+{
+    occluderCount = 0;
+
+    for (int cz = 0; cz < chunksZ; cz++)
+    {
+        for (int cx = 0; cx < chunksX; cx++)
+        {
+            if (dirty[cx + cz * chunksX])
+            {
+                extractOccluders(cx, cz);
+                dirty[cx + cz * chunksX] = 0;
+            }
+            for (int sy = 0; sy < sectionsY; sy++)
+                occluderCount += static_cast<int>(occluders[getSectionIndex(cx, sy, cz)].size());
+        }
+    }
+}
+
+AABB OcclusionCuller::getSectionBounds(int chunkX, int sectionY, int chunkZ) const
+{
+    int x0 = chunkX * World::CHUNK_SIZE;
+    int y0 = sectionY * World::CHUNK_SIZE;
+    int z0 = chunkZ * World::CHUNK_SIZE;
+    int x1 = std::min(x0 + World::CHUNK_SIZE, world.WORLD_X);
+    int y1 = std::min(y0 + World::CHUNK_SIZE, world.WORLD_Y);
+    int z1 = std::min(z0 + World::CHUNK_SIZE, world.WORLD_Z);
+
+    return { glm::vec3(x0 - 0.5f, y0 - 0.5f, z0 - 0.5f),
+             glm::vec3(x1 - 0.5f, y1 - 0.5f, z1 - 0.5f) };
+}
+
+void OcclusionCuller::extractOccluders(int chunkX, int chunkZ)
+{
+    for (int sy = 0; sy < sectionsY; sy++)
+        extractSection(chunkX, sy, chunkZ);
+}
+
+// Every face where a solid block looks out onto air or fluid is an opaque
+// surface. The faces in each layer of a section are merged greedily into
+// rectangles, one occluder each.
+void OcclusionCuller::extractSection(int chunkX, int sectionY, int chunkZ)
+{
+    constexpr int S = World::CHUNK_SIZE;
+    constexpr int PADDED = S + 2;
+    const glm::ivec3 origin(chunkX * S, sectionY * S, chunkZ * S);
+    std::vector<Face>& faces = occluders[getSectionIndex(chunkX, sectionY, chunkZ)];
+    faces.clear();
+
+    // One block of padding on every side; anything outside the world is air.
+    std::vector<char> solid(PADDED * PADDED * PADDED, 0);
+    auto at = [](glm::ivec3 p) { return (p.x + 1) + (p.y + 1) * PADDED + (p.z + 1) * PADDED * PADDED; };
+
+    bool isEmpty = true;
+    for (int z = -1; z <= S; z++)
+    {
+        for (int y = -1; y <= S; y++)
+        {
+            for (int x = -1; x <= S; x++)
+            {
+                glm::ivec3 p = origin + glm::ivec3(x, y, z);
+                if (world.isOutOfWorld(p.x, p.y, p.z))
+                    continue;
+
+                int block = world.getBlockUnchecked(p.x, p.y, p.z);
+                solid[at({ x, y, z })] = World::isSolidBlock(block);
+                if (block != BLOCK_AIR && x >= 0 && x < S && y >= 0 && y < S && z >= 0 && z < S)
+                    isEmpty = false;
+            }
+        }
+    }
+    isSectionEmpty[getSectionIndex(chunkX, sectionY, chunkZ)] = isEmpty;
+
+    const int strides[3] = { 1, PADDED, PADDED * PADDED };
+    bool mask[S * S];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int b = (axis + 1) % 3;
+        int c = (axis + 2) % 3;
+
+        for (int side = -1; side <= 1; side += 2)
+        {
+            int neighbour = side * strides[axis];
+            for (int layer = 0; layer < S; layer++)
+            {
+                for (int v = 0; v < S; v++)
+                {
+                    const char* row = &solid[at({ 0, 0, 0 }) + layer * strides[axis] + v * strides[c]];
+                    for (int u = 0; u < S; u++)
+                        mask[u + v * S] = row[u * strides[b]] && !row[u * strides[b] + neighbour];
+                }
+
+                for (int v = 0; v < S; v++)
+                {
+                    for (int u = 0; u < S; u++)
+                    {
+                        if (!mask[u + v * S])
+                            continue;
+
+                        int w = 1;
+                        while (u + w < S && mask[u + w + v * S])
+                            w++;
+
+                        int h = 1;
+                        while (v + h < S && std::all_of(mask + u + (v + h) * S, mask + u + w + (v + h) * S, [](bool m) { return m; }))
+                            h++;
+
+                        for (int dv = 0; dv < h; dv++)
+                            std::fill_n(mask + u + (v + dv) * S, w, false);
+
+                        Face face{};
+                        face.corner[axis] = static_cast<float>(origin[axis] + layer) + 0.5f * static_cast<float>(side);
+                        face.corner[b] = static_cast<float>(origin[b] + u) - 0.5f;
+                        face.corner[c] = static_cast<float>(origin[c] + v) - 0.5f;
+                        face.axis = static_cast<uint8_t>(axis);
+                        face.side = static_cast<int8_t>(side);
+                        face.sizeB = static_cast<uint8_t>(w);
+                        face.sizeC = static_cast<uint8_t>(h);
+                        faces.push_back(face);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void OcclusionCuller::cull(const glm::mat4& viewProj)
+{
+    cullOrder.clear();
+    for (int cz = 0; cz < chunksZ; cz++)
+    {
+        for (int cx = 0; cx < chunksX; cx++)
+        {
+            for (int sy = 0; sy < sectionsY; sy++)
+            {
+                int i = getSectionIndex(cx, sy, cz);
+                visible[i] = !isSectionEmpty[i] && isBoxInFrustum(getSectionBounds(cx, sy, cz), viewProj, sectionDepth[i]);
+                if (visible[i])
+                    cullOrder.push_back(i);
+            }
+        }
+    }
+
+    if (isTesting)
+    {
+        // The camera is the point the projection takes to x = y = w = 0.
+        glm::mat3 rows(glm::vec3(viewProj[0][0], viewProj[0][1], viewProj[0][3]),
+                       glm::vec3(viewProj[1][0], viewProj[1][1], viewProj[1][3]),
+                       glm::vec3(viewProj[2][0], viewProj[2][1], viewProj[2][3]));
+        glm::vec3 eye = glm::inverse(rows) * -glm::vec3(viewProj[3][0], viewProj[3][1], viewProj[3][3]);
+
+        std::sort(cullOrder.begin(), cullOrder.end(), [this](int a, int b) { return sectionDepth[a] < sectionDepth[b]; });
+        std::fill(rasterDepth.begin(), rasterDepth.end(), 1.f);
+
+        // Sections are drawn nearest first, in bands twice as deep as the
+        // last. Once a band is in the buffer, a farther section already
+        // hidden behind it has nothing to add: its faces lie inside its box.
+        // The sections left are tested again against the finished buffer.
+        float bandEnd = FIRST_BAND_DEPTH;
+        bool hasDepth = false;
+        for (int i : cullOrder)
+        {
+            if (sectionDepth[i] > bandEnd)
+            {
+                while (sectionDepth[i] > bandEnd)
+                    bandEnd *= 2.f;
+                erodeDepth();
+                buildHierarchy();
+                hasDepth = true;
+            }
+
+            int column = i / sectionsY;
+            if (hasDepth && !testBox(getSectionBounds(column % chunksX, i % sectionsY, column / chunksX), viewProj))
+            {
+                visible[i] = 0;
+                continue;
+            }
+
+            for (const Face& face : occluders[i])
+                rasterizeFace(face, viewProj, eye);
+        }
+
+        erodeDepth();
+        buildHierarchy();
+        for (int i : cullOrder)
+        {
+            int column = i / sectionsY;
+            if (visible[i])
+                visible[i] = testBox(getSectionBounds(column % chunksX, i % sectionsY, column / chunksX), viewProj);
+        }
+    }
+
+    visibleCount = 0;
+    visibleSectionCount = 0;
+    for (int column = 0; column < chunksX * chunksZ; column++)
+    {
+        int sections = static_cast<int>(std::count(visible.begin() + column * sectionsY, visible.begin() + (column + 1) * sectionsY, 1));
+        visibleColumns[column] = sections > 0;
+        visibleCount += sections > 0;
+        visibleSectionCount += sections;
+    }
+}
+
+// Sets up a face for rasterizing. Fails for faces outside the frustum, turned
+// away from the camera or edge-on.
+bool OcclusionCuller::projectFace(const Face& face, const glm::mat4& viewProj, ScreenPolygon& polygon)
+{
+    // Faces are axis-aligned, so one corner and two columns of the matrix
+    // give the other three. b, c, axis is right-handed: b then c goes round
+    // counter-clockwise seen from the positive side.
+    int b = (face.axis + 1) % 3;
+    int c = (face.axis + 2) % 3;
+    glm::vec4 corner = viewProj * glm::vec4(face.corner, 1.f);
+    glm::vec4 alongB = viewProj[b] * static_cast<float>(face.sizeB);
+    glm::vec4 alongC = viewProj[c] * static_cast<float>(face.sizeC);
+    glm::vec4 clip[4] = { corner, corner + alongB, corner + alongB + alongC, corner + alongC };
+    if (face.side < 0)
+        std::swap(clip[1], clip[3]);
+
+    auto isAllOutside = [&clip](auto isOutside) {
+        return isOutside(clip[0]) && isOutside(clip[1]) && isOutside(clip[2]) && isOutside(clip[3]);
+    };
+    if (isAllOutside([](const glm::vec4& p) { return p.x < -p.w; }) || isAllOutside([](const glm::vec4& p) { return p.x > p.w; }) ||
+        isAllOutside([](const glm::vec4& p) { return p.y < -p.w; }) || isAllOutside([](const glm::vec4& p) { return p.y > p.w; }) ||
+        isAllOutside([](const glm::vec4& p) { return p.z > p.w; }) || isAllOutside([](const glm::vec4& p) { return p.w < NEAR_W; }))
+        return false;
+
+    // Clipping a face to the near plane leaves at most five corners.
+    glm::vec4 poly[5];
+    int n = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const glm::vec4& a = clip[i];
+        const glm::vec4& b = clip[(i + 1) % 4];
+        if (a.w >= NEAR_W)
+            poly[n++] = a;
+        if ((a.w >= NEAR_W) != (b.w >= NEAR_W))
+            poly[n++] = a + (b - a) * ((NEAR_W - a.w) / (b.w - a.w));
+    }
+
+    glm::vec2 s[5];
+    float z[5];
+    for (int i = 0; i < n; i++)
+    {
+        glm::vec3 ndc = glm::vec3(poly[i]) / poly[i].w;
+        s[i] = toBuffer(ndc);
+        z[i] = ndc.z * 0.5f + 0.5f;
+    }
+
+    // Depth is affine in screen space across a plane; take its gradient from
+    // the largest triangle of the fan, which also tells which way it faces.
+    int best = 0;
+    float bestCross = 0.f;
+    for (int i = 1; i + 1 < n; i++)
+    {
+        glm::vec2 e1 = s[i] - s[0];
+        glm::vec2 e2 = s[i + 1] - s[0];
+        float cross = e1.x * e2.y - e1.y * e2.x;
+        if (cross > bestCross)
+        {
+            bestCross = cross;
+            best = i;
+        }
+    }
+    if (bestCross < 1e-3f)
+        return false;
+
+    glm::vec2 e1 = s[best] - s[0];
+    glm::vec2 e2 = s[best + 1] - s[0];
+    float dz1 = z[best] - z[0];
+    float dz2 = z[best + 1] - z[0];
+    polygon.dzdx = (dz1 * e2.y - dz2 * e1.y) / bestCross;
+    polygon.dzdy = (dz2 * e1.x - dz1 * e2.x) / bestCross;
+    polygon.depthAtOrigin = z[0] - polygon.dzdx * s[0].x - polygon.dzdy * s[0].y;
+
+    polygon.count = n;
+    polygon.minX = polygon.maxX = s[0].x;
+    polygon.minY = polygon.maxY = s[0].y;
+    for (int i = 0; i < n; i++)
+    {
+        const glm::vec2& p0 = s[i];
+        const glm::vec2& p1 = s[(i + 1) % n];
+        polygon.edgeA[i] = -(p1.y - p0.y);
+        polygon.edgeB[i] = p1.x - p0.x;
+        polygon.edgeC[i] = -(polygon.edgeA[i] * p0.x + polygon.edgeB[i] * p0.y);
+
+        polygon.minX = std::min(polygon.minX, p0.x);
+        polygon.maxX = std::max(polygon.maxX, p0.x);
+        polygon.minY = std::min(polygon.minY, p0.y);
+        polygon.maxY = std::max(polygon.maxY, p0.y);
+    }
+    return true;
+}
+
+// Coverage is sampled at pixel centres, with the depth of the face's plane
+// at the farthest point of each pixel, so no pixel claims a surface is
+// nearer than it is. Faces turned away from the camera are skipped before
+// anything is projected: the faces in front of them hide at least as much.
+void OcclusionCuller::rasterizeFace(const Face& face, const glm::mat4& viewProj, const glm::vec3& eye)
+{
+    if ((eye[face.axis] - face.corner[face.axis]) * face.side <= 0.f)
+        return;
+
+    ScreenPolygon polygon;
+    if (!projectFace(face, viewProj, polygon))
+        return;
+
+    const int n = polygon.count;
+    const float* edgeA = polygon.edgeA;
+    const float* edgeB = polygon.edgeB;
+    const float* edgeC = polygon.edgeC;
+    float dzdx = polygon.dzdx;
+    float farthest = polygon.depthAtOrigin + 0.5f * (std::abs(polygon.dzdx) + std::abs(polygon.dzdy));
+
+    int x0 = std::max(0, static_cast<int>(std::floor(std::max(polygon.minX, -1.f)))) & ~3;
+    int x1 = std::min(DEPTH_W - 1, static_cast<int>(std::ceil(std::min(polygon.maxX, static_cast<float>(DEPTH_W)))));
+    int y0 = std::max(0, static_cast<int>(std::floor(std::max(polygon.minY, -1.f))));
+    int y1 = std::min(DEPTH_H - 1, static_cast<int>(std::ceil(std::min(polygon.maxY, static_cast<float>(DEPTH_H)))));
+
+    for (int y = y0; y <= y1; y++)
+    {
+        float py = static_cast<float>(y) + 0.5f;
+        float* row = &rasterDepth[y * DEPTH_W];
+        float rowDepth = farthest + polygon.dzdy * py;
+
+#if defined(__SSE2__)
+        __m128 dx = _mm_set1_ps(dzdx);
+        __m128 rowD = _mm_set1_ps(rowDepth);
+        __m128 a[5], rowE[5];
+        for (int i = 0; i < n; i++)
+        {
+            a[i] = _mm_set1_ps(edgeA[i]);
+            rowE[i] = _mm_set1_ps(edgeB[i] * py + edgeC[i]);
+        }
+
+        for (int x = x0; x <= x1; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+            __m128 mask = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], px), rowE[0]), _mm_setzero_ps());
+            for (int i = 1; i < n; i++)
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[i], px), rowE[i]), _mm_setzero_ps()));
+
+            __m128 d = _mm_add_ps(rowD, _mm_mul_ps(dx, px));
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 res = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(old, d)), _mm_andnot_ps(mask, old));
+            _mm_storeu_ps(row + x, res);
+        }
+#else
+        for (int x = x0; x <= x1; x++)
+        {
+            float px = static_cast<float>(x) + 0.5f;
+            bool inside = true;
+            for (int i = 0; i < n; i++)
+                inside = inside && edgeA[i] * px + edgeB[i] * py + edgeC[i] >= 0.f;
+
+            if (inside)
+                row[x] = std::min(row[x], rowDepth + dzdx * px);
+        }
+#endif
+    }
+}
+
+// A pixel whose centre a face covers can still show what lies behind it at
+// its edges, where the face ends. Taking the farthest depth of each pixel
+// and its eight neighbours pulls every silhouette in by a pixel; inside a
+// surface, where the neighbours are covered too, depth barely changes.
+// Past the edge of the buffer nothing is known, so it counts as uncovered.
+void OcclusionCuller::erodeDepth()
+{
+    std::vector<float>& buffer = maxDepth[0];
+
+    for (int y = 0; y < DEPTH_H; y++)
+    {
+        const float* row = &rasterDepth[y * DEPTH_W];
+        float* out = &filterScratch[y * DEPTH_W];
+        out[0] = 1.f;
+        out[DEPTH_W - 1] = 1.f;
+        for (int x = 1; x < DEPTH_W - 1; x++)
+            out[x] = std::max({ row[x - 1], row[x], row[x + 1] });
+    }
+
+    std::fill_n(buffer.begin(), DEPTH_W, 1.f);
+    std::fill_n(buffer.end() - DEPTH_W, DEPTH_W, 1.f);
+    for (int y = 1; y < DEPTH_H - 1; y++)
+    {
+        const float* above = &filterScratch[(y - 1) * DEPTH_W];
+        const float* row = &filterScratch[y * DEPTH_W];
+        const float* below = &filterScratch[(y + 1) * DEPTH_W];
+        float* out = &buffer[y * DEPTH_W];
+        for (int x = 0; x < DEPTH_W; x++)
+            out[x] = std::max({ above[x], row[x], below[x] });
+    }
+}
+
+void OcclusionCuller::buildHierarchy()
+{
+    minDepth[0] = maxDepth[0];
+
+    for (int l = 1; l < LEVELS; l++)
+    {
+        int w = levelWidth(l);
+        int h = levelHeight(l);
+        int srcW = levelWidth(l - 1);
+        const std::vector<float>& srcMax = maxDepth[l - 1];
+        const std::vector<float>& srcMin = minDepth[l - 1];
+
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                int i0 = 2 * x + 2 * y * srcW;
+                int i1 = i0 + srcW;
+                maxDepth[l][x + y * w] = std::max({ srcMax[i0], srcMax[i0 + 1], srcMax[i1], srcMax[i1 + 1] });
+                minDepth[l][x + y * w] = std::min({ srcMin[i0], srcMin[i0 + 1], srcMin[i1], srcMin[i1 + 1] });
+            }
+        }
+    }
+}
+
+// Out only when all eight corners are beyond the same plane.
+bool OcclusionCuller::isBoxInFrustum(const AABB& box, const glm::mat4& viewProj, float& nearestW) const
+{
+    int outside[6] = {};
+    nearestW = std::numeric_limits<float>::max();
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+
+        glm::vec4 clip = viewProj * glm::vec4(corner, 1.f);
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z > clip.w;
+        outside[5] += clip.w < NEAR_W;
+        nearestW = std::min(nearestW, clip.w);
+    }
+
+    return std::none_of(outside, outside + 6, [](int count) { return count == 8; });
+}
+
+bool OcclusionCuller::testBox(const AABB& box, const glm::mat4& viewProj) const
+{
+    float minX = static_cast<float>(DEPTH_W), maxX = 0.f;
+    float minY = static_cast<float>(DEPTH_H), maxY = 0.f;
+    float boxDepth = 1.f;
+    int behind = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+
+        glm::vec4 clip = viewProj * glm::vec4(corner, 1.f);
+        if (clip.w < NEAR_W)
+        {
+            behind++;
+            continue;
+        }
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen = toBuffer(ndc);
+        float sx = screen.x;
+        float sy = screen.y;
+
+        minX = std::min(minX, sx);
+        maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy);
+        maxY = std::max(maxY, sy);
+        boxDepth = std::min(boxDepth, ndc.z * 0.5f + 0.5f);
+    }
+
+    if (behind == 8)
+        return false;
+    if (behind > 0)
+        return true;
+
+    if (maxX < 1.f || minX >= DEPTH_W - 1 || maxY < 1.f || minY >= DEPTH_H - 1)
+        return false;
+
+    int x0 = std::max(1, static_cast<int>(std::floor(minX)));
+    int x1 = std::min(DEPTH_W - 2, static_cast<int>(std::floor(maxX)));
+    int y0 = std::max(1, static_cast<int>(std::floor(minY)));
+    int y1 = std::min(DEPTH_H - 2, static_cast<int>(std::floor(maxY)));
+
+    int level = 0;
+    while (level < LEVELS - 1 && std::max((x1 >> level) - (x0 >> level), (y1 >> level) - (y0 >> level)) > 1)
+        level++;
+
+    bool isCovered = true;
+    for (int ty = y0 >> level; ty <= y1 >> level && isCovered; ty++)
+        for (int tx = x0 >> level; tx <= x1 >> level && isCovered; tx++)
+            isCovered = !testRegion(level, tx, ty, x0, y0, x1, y1, boxDepth);
+
+    return !isCovered && testFaces(box, viewProj);
+}
+
+bool OcclusionCuller::testRegion(int level, int tx, int ty, int x0, int y0, int x1, int y1, float boxDepth) const
+{
+    int i = tx + ty * levelWidth(level);
+
+    if (boxDepth > maxDepth[level][i])
+        return false;
+    if (boxDepth <= minDepth[level][i] || level == 0)
+        return true;
+
+    int child = level - 1;
+    for (int cy = 2 * ty; cy <= 2 * ty + 1; cy++)
+    {
+        if (cy < y0 >> child || cy > y1 >> child)
+            continue;
+
+        for (int cx = 2 * tx; cx <= 2 * tx + 1; cx++)
+        {
+            if (cx < x0 >> child || cx > x1 >> child)
+                continue;
+
+            if (testRegion(child, cx, cy, x0, y0, x1, y1, boxDepth))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// The hierarchy holds the box's nearest corner against its whole screen
+// rectangle, which keeps most boxes just under a surface. Those get a closer
+// look: each face turned towards the camera touches every pixel it overlaps
+// at the nearest depth it reaches there, and the box is hidden only if all
+// of those pixels hold something nearer. Only called with every corner in
+// front of the near plane.
+bool OcclusionCuller::testFaces(const AABB& box, const glm::mat4& viewProj) const
+{
+    const std::vector<float>& buffer = maxDepth[0];
+    int faces = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int b = (axis + 1) % 3;
+        int c = (axis + 2) % 3;
+
+        for (int side = -1; side <= 1; side += 2)
+        {
+            Face face{ box.min, static_cast<uint8_t>(axis), static_cast<int8_t>(side), static_cast<uint8_t>(box.max[b] - box.min[b]),
+                       static_cast<uint8_t>(box.max[c] - box.min[c]) };
+            face.corner[axis] = side < 0 ? box.min[axis] : box.max[axis];
+            ScreenPolygon polygon;
+            if (!projectFace(face, viewProj, polygon))
+                continue;
+            faces++;
+
+            // Widening each edge by half a pixel takes in every pixel the face touches.
+            float widen[5];
+            for (int i = 0; i < polygon.count; i++)
+                widen[i] = polygon.edgeC[i] + 0.5f * (std::abs(polygon.edgeA[i]) + std::abs(polygon.edgeB[i]));
+            float nearest = polygon.depthAtOrigin - 0.5f * (std::abs(polygon.dzdx) + std::abs(polygon.dzdy));
+
+            int x0 = std::max(1, static_cast<int>(std::floor(polygon.minX)));
+            int x1 = std::min(DEPTH_W - 2, static_cast<int>(std::floor(polygon.maxX)));
+            int y0 = std::max(1, static_cast<int>(std::floor(polygon.minY)));
+            int y1 = std::min(DEPTH_H - 2, static_cast<int>(std::floor(polygon.maxY)));
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = static_cast<float>(y) + 0.5f;
+                const float* row = &buffer[y * DEPTH_W];
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = static_cast<float>(x) + 0.5f;
+                    bool inside = true;
+                    for (int i = 0; i < polygon.count; i++)
+                        inside = inside && polygon.edgeA[i] * px + polygon.edgeB[i] * py + widen[i] >= 0.f;
+
+                    if (inside && nearest + polygon.dzdx * px + polygon.dzdy * py <= row[x])
+                        return true;
+                }
+            }
+        }
+    }
+
+    // A box too small on screen to set up any face is not worth hiding.
+    return faces == 0;
+}
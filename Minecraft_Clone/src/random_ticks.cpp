@@ -0,0 +1,77 @@
+#include "random_ticks.h"
+
+uint32_t RandomTicks::nextRandom()
+{
+    // xorshift32, cheap enough to call for every pick.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void RandomTicks::run(const World& world, std::vector<BlockChange>& changes)
+{
+    changes.clear();
+    sectionsTicked = 0;
+    sectionsSkipped = 0;
+    blocksTicked = 0;
+
+    const int size = World::CHUNK_SIZE;
+    for (int chunkZ = 0; chunkZ < world.getChunksZ(); chunkZ++)
+    {
+        for (int chunkX = 0; chunkX < world.getChunksX(); chunkX++)
+        {
+            const int* blocks = world.getChunkBlocks(chunkX, chunkZ);
+            for (int sectionY = 0; sectionY < world.getSectionsY(); sectionY++)
+            {
+                if (world.getTickableCount(chunkX, sectionY, chunkZ) == 0)
+                {
+                    sectionsSkipped++;
+                    continue;
+                }
+                sectionsTicked++;
+
+                for (int i = 0; i < TICKS_PER_SECTION; i++)
+                {
+                    uint32_t r = nextRandom();
+                    int x = static_cast<int>(r & 15);
+                    int y = sectionY * size + static_cast<int>((r >> 4) & 15);
+                    int z = static_cast<int>((r >> 8) & 15);
+                    glm::ivec3 cell(chunkX * size + x, y, chunkZ * size + z);
+                    if (world.isOutOfWorld(cell.x, cell.y, cell.z))
+                        continue;
+
+                    int block = blocks[world.getColumnIndex(x, y, z)];
+                    if (!World::isTickable(block))
+                        continue;
+
+                    blocksTicked++;
+                    if (block == BLOCK_GRASS)
+                        tickGrass(world, cell, changes);
+                }
+            }
+        }
+    }
+}
+
+void RandomTicks::tickGrass(const World& world, glm::ivec3 cell, std::vector<BlockChange>& changes)
+{
+    auto isCovered = [&world](glm::ivec3 c) {
+        return !world.isOutOfWorld(c.x, c.y + 1, c.z) && world.isBlockSolidUnchecked(c.x, c.y + 1, c.z);
+    };
+
+    if (isCovered(cell))
+    {
+        changes.push_back({ cell, BLOCK_DIRT });
+        return;
+    }
+
+    uint32_t r = nextRandom();
+    glm::ivec3 target = cell + glm::ivec3(static_cast<int>(r % 3) - 1, static_cast<int>((r >> 8) % 5) - 3,
+                                          static_cast<int>((r >> 16) % 3) - 1);
+    if (world.isOutOfWorld(target.x, target.y, target.z) || world.getBlockUnchecked(target.x, target.y, target.z) != BLOCK_DIRT)
+        return;
+
+    if (!isCovered(target))
+        changes.push_back({ target, BLOCK_GRASS });
+}
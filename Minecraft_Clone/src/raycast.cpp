@@ -0,0 +1,320 @@
+#include "raycast.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void RaycastResults::resize(size_t count)
+{
+    isHit.resize(count);
+    cells.resize(count);
+    faces.resize(count);
+    distances.resize(count);
+}
+
+glm::ivec3 VoxelRaycaster::getFaceNormal(int face)
+{
+    switch (face)
+    {
+        case FACE_NEG_X: return glm::ivec3(-1, 0, 0);
+        case FACE_POS_X: return glm::ivec3(1, 0, 0);
+        case FACE_NEG_Y: return glm::ivec3(0, -1, 0);
+        case FACE_POS_Y: return glm::ivec3(0, 1, 0);
+        case FACE_NEG_Z: return glm::ivec3(0, 0, -1);
+        case FACE_POS_Z: return glm::ivec3(0, 0, 1);
+        default: return glm::ivec3(0);
+    }
+}
+
+namespace {
+    // Starting cell, distance to the first cell boundary and distance between
+    // boundaries along one axis, for a run of rays. Written without branches
+    // so the loop vectorises.
+    void setupAxis(size_t count, const float* origin, const float* dir, int* cell, float* next, float* delta)
+    {
+        const float infinity = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < count; i++)
+        {
+            float c = std::floor(origin[i] + 0.5f);
+            float boundary = c + (dir[i] > 0.f ? 0.5f : -0.5f);
+            cell[i] = static_cast<int>(c);
+            next[i] = dir[i] == 0.f ? infinity : (boundary - origin[i]) / dir[i];
+            delta[i] = dir[i] == 0.f ? 0.f : 1.f / std::fabs(dir[i]);
+        }
+    }
+
+    // One ray on its way through the grid. Crossing k along an axis is always
+    // computed as first + k * delta, never by running sums, so jumping over
+    // many cells lands on exactly the times stepping one by one would.
+    struct Walk
+    {
+        int cell[3];
+        int step[3];
+        float first[3];
+        float delta[3];
+        int crossed[3];
+        float next[3];
+
+        float crossing(int axis, int k) const { return first[axis] + static_cast<float>(k) * delta[axis]; }
+
+        // The axis crossed next. Ties go to x, then y, as in the stepping order.
+        int nextAxis() const
+        {
+            int axis = next[1] < next[0] ? 1 : 0;
+            return next[2] < next[axis] ? 2 : axis;
+        }
+
+        void advance(int axis, int crossings)
+        {
+            cell[axis] += step[axis] * crossings;
+            crossed[axis] += crossings;
+            next[axis] = crossing(axis, crossed[axis]);
+        }
+
+        // Moves to the first cell past the box [lo, hi] around the current
+        // cell. Returns the time of the crossing that leaves it, and sets
+        // exitAxis to the axis it leaves through.
+        float leaveBox(const int lo[3], const int hi[3], int& exitAxis)
+        {
+            int inside[3];
+            float exit[3];
+            for (int a = 0; a < 3; a++)
+            {
+                inside[a] = step[a] > 0 ? hi[a] - cell[a] : cell[a] - lo[a];
+                exit[a] = crossing(a, crossed[a] + inside[a]);
+            }
+
+            int axis = exit[1] < exit[0] ? 1 : 0;
+            axis = exit[2] < exit[axis] ? 2 : axis;
+            float t = exit[axis];
+
+            // Every crossing of the other axes that stepping would take before
+            // this one, estimated and then settled against the exact times.
+            for (int a = 0; a < 3; a++)
+            {
+                if (a == axis)
+                    continue;
+
+                auto isBefore = [&](int k) {
+                    float time = crossing(a, k);
+                    return time < t || (time == t && a < axis);
+                };
+                if (!isBefore(crossed[a]))
+                    continue;
+
+                int k = crossed[a] + std::min(inside[a], static_cast<int>((t - next[a]) / delta[a]));
+                while (k < crossed[a] + inside[a] && isBefore(k + 1))
+                    k++;
+                while (k > crossed[a] && !isBefore(k))
+                    k--;
+                advance(a, k + 1 - crossed[a]);
+            }
+
+            advance(axis, inside[axis] + 1);
+            exitAxis = axis;
+            return t;
+        }
+    };
+}
+
+void VoxelRaycaster::setup(size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        float length = std::sqrt(dirX[i] * dirX[i] + dirY[i] * dirY[i] + dirZ[i] * dirZ[i]);
+        float scale = length > 0.f ? 1.f / length : 0.f;
+        dirX[i] *= scale;
+        dirY[i] *= scale;
+        dirZ[i] *= scale;
+    }
+
+    setupAxis(count, originX.data(), dirX.data(), cellX.data(), nextX.data(), deltaX.data());
+    setupAxis(count, originY.data(), dirY.data(), cellY.data(), nextY.data(), deltaY.data());
+    setupAxis(count, originZ.data(), dirZ.data(), cellZ.data(), nextZ.data(), deltaZ.data());
+}
+
+// Counting sort on the chunk each ray starts in. Rays starting outside the
+// world share the last bucket.
+void VoxelRaycaster::sortByChunk(const World& world, const glm::vec3* origins, size_t count)
+{
+    int chunksX = world.getChunksX();
+    int buckets = chunksX * world.getChunksZ() + 1;
+    bucketStarts.assign(buckets + 1, 0);
+
+    auto bucketOf = [&](size_t i) {
+        int x = static_cast<int>(std::floor(origins[i].x + 0.5f));
+        int z = static_cast<int>(std::floor(origins[i].z + 0.5f));
+        if (x < 0 || x >= world.WORLD_X || z < 0 || z >= world.WORLD_Z)
+            return buckets - 1;
+        return x / World::CHUNK_SIZE + (z / World::CHUNK_SIZE) * chunksX;
+    };
+
+    for (size_t i = 0; i < count; i++)
+        bucketStarts[bucketOf(i) + 1]++;
+    for (int b = 0; b < buckets; b++)
+        bucketStarts[b + 1] += bucketStarts[b];
+
+    order.resize(count);
+    for (size_t i = 0; i < count; i++)
+        order[bucketStarts[bucketOf(i)]++] = static_cast<uint32_t>(i);
+}
+
+void VoxelRaycaster::cast(const World& world, const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& directions,
+                          float maxDistance, RaycastResults& out)
+{
+    size_t count = std::min(origins.size(), directions.size());
+    out.resize(count);
+    if (count == 0)
+        return;
+
+    size_t runSize = std::min(count, RUN_SIZE);
+    for (auto* v : { &originX, &originY, &originZ, &dirX, &dirY, &dirZ, &nextX, &nextY, &nextZ, &deltaX, &deltaY, &deltaZ })
+        v->resize(runSize);
+    cellX.resize(runSize);
+    cellY.resize(runSize);
+    cellZ.resize(runSize);
+
+    for (size_t first = 0; first < count; first += RUN_SIZE)
+        castRun(world, origins.data() + first, directions.data() + first, std::min(count - first, RUN_SIZE), maxDistance, out, first);
+
+    rayCount += static_cast<long>(count);
+}
+
+void VoxelRaycaster::castRun(const World& world, const glm::vec3* origins, const glm::vec3* directions, size_t count,
+                             float maxDistance, RaycastResults& out, size_t first)
+{
+    sortByChunk(world, origins, count);
+    for (size_t k = 0; k < count; k++)
+    {
+        const glm::vec3& origin = origins[order[k]];
+        const glm::vec3& direction = directions[order[k]];
+        originX[k] = origin.x;
+        originY[k] = origin.y;
+        originZ[k] = origin.z;
+        dirX[k] = direction.x;
+        dirY[k] = direction.y;
+        dirZ[k] = direction.z;
+    }
+    setup(count);
+
+    const int size[3] = { world.WORLD_X, world.WORLD_Y, world.WORLD_Z };
+    const int facesByAxis[3][2] = { { FACE_POS_X, FACE_NEG_X }, { FACE_POS_Y, FACE_NEG_Y }, { FACE_POS_Z, FACE_NEG_Z } };
+
+    // The chunk the last step was in, and what was read from it.
+    const int* blocks = nullptr;
+    const uint64_t* masks = nullptr;
+    bool isLoadedEmpty = false;
+    int loadedX = -1;
+    int loadedZ = -1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Walk walk{
+            { cellX[i], cellY[i], cellZ[i] },
+            { dirX[i] > 0.f ? 1 : -1, dirY[i] > 0.f ? 1 : -1, dirZ[i] > 0.f ? 1 : -1 },
+            { nextX[i], nextY[i], nextZ[i] },
+            { deltaX[i], deltaY[i], deltaZ[i] },
+            { 0, 0, 0 },
+            { nextX[i], nextY[i], nextZ[i] }
+        };
+
+        int face = FACE_NONE;
+        float t = 0.f;
+        bool isHit = false;
+
+        while (true)
+        {
+            int x = walk.cell[0], y = walk.cell[1], z = walk.cell[2];
+            if (x >= 0 && x < size[0] && y >= 0 && y < size[1] && z >= 0 && z < size[2])
+            {
+                // Non-negative here, so the unsigned forms compile to shifts and masks.
+                int cx = static_cast<unsigned>(x) / World::CHUNK_SIZE;
+                int cz = static_cast<unsigned>(z) / World::CHUNK_SIZE;
+
+                if (cx != loadedX || cz != loadedZ)
+                {
+                    if (isSkipping)
+                    {
+                        isLoadedEmpty = world.isChunkEmpty(cx, cz);
+                        masks = world.getChunkBrickMasks(cx, cz);
+                    }
+                    else
+                    {
+                        blocks = world.getChunkBlocks(cx, cz);
+                    }
+                    loadedX = cx;
+                    loadedZ = cz;
+                    chunkSwitches++;
+                }
+
+                if (isSkipping)
+                {
+                    uint64_t mask = isLoadedEmpty ? 0 : masks[world.getBrickIndexInChunk(x, y, z)];
+                    if (mask == 0)
+                    {
+                        int lo[3], hi[3];
+                        if (isLoadedEmpty)
+                        {
+                            lo[0] = cx * World::CHUNK_SIZE;
+                            lo[1] = 0;
+                            lo[2] = cz * World::CHUNK_SIZE;
+                            hi[0] = lo[0] + World::CHUNK_SIZE - 1;
+                            hi[1] = size[1] - 1;
+                            hi[2] = lo[2] + World::CHUNK_SIZE - 1;
+                            chunkSkips++;
+                        }
+                        else
+                        {
+                            for (int a = 0; a < 3; a++)
+                            {
+                                lo[a] = walk.cell[a] & ~(World::BRICK_SIZE - 1);
+                                hi[a] = lo[a] + World::BRICK_SIZE - 1;
+                            }
+                            brickSkips++;
+                        }
+
+                        int axis;
+                        float exit = walk.leaveBox(lo, hi, axis);
+                        stepCount++;
+                        if (exit > maxDistance)
+                            break;
+                        t = exit;
+                        face = facesByAxis[axis][walk.step[axis] > 0];
+                        continue;
+                    }
+
+                    if (mask & (1ull << World::getBrickBit(x, y, z)))
+                    {
+                        isHit = true;
+                        break;
+                    }
+                }
+                else if (World::isSolidBlock(blocks[world.getColumnIndex(x, y, z)]))
+                {
+                    isHit = true;
+                    break;
+                }
+            }
+            else if ((x < 0 && walk.step[0] < 0) || (x >= size[0] && walk.step[0] > 0) ||
+                     (y < 0 && walk.step[1] < 0) || (y >= size[1] && walk.step[1] > 0) ||
+                     (z < 0 && walk.step[2] < 0) || (z >= size[2] && walk.step[2] > 0))
+            {
+                // Outside and heading further out, so nothing left to hit.
+                break;
+            }
+
+            stepCount++;
+            int axis = walk.nextAxis();
+            if (walk.next[axis] > maxDistance)
+                break;
+            t = walk.next[axis];
+            walk.advance(axis, 1);
+            face = facesByAxis[axis][walk.step[axis] > 0];
+        }
+
+        size_t result = first + order[i];
+        out.isHit[result] = isHit;
+        out.cells[result] = glm::ivec3(walk.cell[0], walk.cell[1], walk.cell[2]);
+        out.faces[result] = static_cast<uint8_t>(face);
+        out.distances[result] = isHit ? t : maxDistance;
+    }
+}
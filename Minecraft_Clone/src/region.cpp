@@ -0,0 +1,373 @@
+#include "region.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lz.h"
+#include "world.h"
+
+namespace {
+    bool readAll(int fd, void* data, size_t size, size_t offset)
+    {
+        auto* p = static_cast<char*>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+            if (n <= 0)
+                return false;
+
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<size_t>(n);
+        }
+
+        return true;
+    }
+
+    bool writeAll(int fd, const void* data, size_t size, size_t offset)
+    {
+        const auto* p = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+            if (n <= 0)
+                return false;
+
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<size_t>(n);
+        }
+
+        return true;
+    }
+}
+
+uint32_t RegionFile::getLayout(int chunkHeight)
+{
+    return static_cast<uint32_t>(chunkHeight) | static_cast<uint32_t>(World::BLOCK_ORDER) << 16;
+}
+
+RegionFile::RegionFile(const std::string& path, int chunkHeight)
+    : table(REGION_SIZE * REGION_SIZE, Entry{})
+{
+    bool isNew = !std::filesystem::exists(path);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Could not open region file " + path);
+
+    // The destructor does not run for a constructor that throws.
+    auto fail = [this](const std::string& message) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error(message);
+    };
+
+    uint32_t header[3] = { MAGIC, VERSION, getLayout(chunkHeight) };
+    if (isNew && (!writeAll(fd, header, sizeof(header), 0) || !writeAll(fd, table.data(), tableBytes(), HEADER_BYTES) ||
+                  fdatasync(fd) != 0))
+        fail("Could not create region file " + path);
+
+    if (!readAll(fd, header, sizeof(header), 0) || !readAll(fd, table.data(), tableBytes(), HEADER_BYTES) ||
+        header[0] != MAGIC || header[1] != VERSION)
+        fail("Invalid region file " + path);
+    if (header[2] != getLayout(chunkHeight))
+        fail("Region file " + path + " was saved with a different world height or block order");
+
+    // Whatever lies between the payloads the table points at is free.
+    std::vector<std::pair<uint32_t, uint32_t>> used;
+    for (const Entry& e : table)
+        if (e.rawSize != 0)
+            used.emplace_back(e.offset, e.capacity);
+    std::sort(used.begin(), used.end());
+
+    endOffset = static_cast<uint32_t>(HEADER_BYTES + tableBytes());
+    for (auto [offset, size] : used)
+    {
+        if (offset > endOffset)
+            freeSpace[endOffset] = offset - endOffset;
+        endOffset = std::max(endOffset, offset + size);
+    }
+}
+
+RegionFile::~RegionFile()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool RegionFile::readChunk(int localX, int localZ, std::vector<int>& blocks)
+{
+    const Entry& e = table[slot(localX, localZ)];
+    if (e.rawSize == 0)
+        return false;
+
+    readBuffer.resize(e.compressedSize);
+    if (!readAll(fd, readBuffer.data(), readBuffer.size(), e.offset))
+        throw std::runtime_error("Could not read chunk from region file");
+
+    std::vector<uint8_t> raw = lz::decompress(readBuffer.data(), readBuffer.size(), e.rawSize);
+    blocks.resize(e.rawSize / sizeof(int));
+    std::memcpy(blocks.data(), raw.data(), blocks.size() * sizeof(int));
+    return true;
+}
+
+size_t RegionFile::writeChunk(int localX, int localZ, const int* blocks, size_t count)
+{
+    std::vector<uint8_t> packed = lz::compress(reinterpret_cast<const uint8_t*>(blocks), count * sizeof(int));
+
+    Entry e;
+    e.compressedSize = static_cast<uint32_t>(packed.size());
+    e.capacity = e.compressedSize;
+    e.offset = allocate(e.capacity);
+    e.rawSize = static_cast<uint32_t>(count * sizeof(int));
+
+    if (!writeAll(fd, packed.data(), packed.size(), e.offset))
+    {
+        release(e.offset, e.capacity);
+        throw std::runtime_error("Could not write chunk to region file");
+    }
+
+    Entry& old = table[slot(localX, localZ)];
+    if (old.rawSize != 0)
+        releasedSpace.emplace_back(old.offset, old.capacity);
+
+    old = e;
+    isTableDirty = true;
+    return packed.size();
+}
+
+uint32_t RegionFile::allocate(uint32_t size)
+{
+    // Best fit, so small payloads do not break up the large gaps.
+    auto best = freeSpace.end();
+    for (auto it = freeSpace.begin(); it != freeSpace.end(); ++it)
+        if (it->second >= size && (best == freeSpace.end() || it->second < best->second))
+            best = it;
+
+    if (best == freeSpace.end())
+    {
+        uint32_t offset = endOffset;
+        endOffset += size;
+        return offset;
+    }
+
+    uint32_t offset = best->first;
+    uint32_t left = best->second - size;
+    freeSpace.erase(best);
+    if (left > 0)
+        freeSpace[offset + size] = left;
+
+    return offset;
+}
+
+void RegionFile::release(uint32_t offset, uint32_t size)
+{
+    auto next = freeSpace.lower_bound(offset);
+    if (next != freeSpace.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = freeSpace.erase(next);
+    }
+    if (next != freeSpace.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            freeSpace.erase(prev);
+        }
+    }
+
+    if (offset + size == endOffset)
+        endOffset = offset;
+    else
+        freeSpace[offset] = size;
+}
+
+size_t RegionFile::getFreeBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& [offset, size] : freeSpace)
+        bytes += size;
+    for (const auto& [offset, size] : releasedSpace)
+        bytes += size;
+
+    return bytes;
+}
+
+void RegionFile::flush()
+{
+    if (!isTableDirty)
+        return;
+
+    // Payloads first, so the table on disk never points at one that is not
+    // there yet.
+    if (fdatasync(fd) != 0)
+        throw std::runtime_error("Could not sync region file");
+    if (!writeAll(fd, table.data(), tableBytes(), HEADER_BYTES) || fdatasync(fd) != 0)
+        throw std::runtime_error("Could not write region file table");
+
+    isTableDirty = false;
+
+    // Nothing on disk points at the old payloads any more.
+    uint32_t previousEnd = endOffset;
+    for (auto [offset, size] : releasedSpace)
+        release(offset, size);
+    releasedSpace.clear();
+
+    // Give back space freed at the end of the file. If that fails the file
+    // just stays longer than it needs to be.
+    if (endOffset < previousEnd && ftruncate(fd, endOffset) != 0)
+        return;
+}
+
+WorldStorage::WorldStorage(std::string dir) : directory(std::move(dir))
+{
+}
+
+RegionFile* WorldStorage::getRegion(int regionX, int regionZ, int chunkHeight, bool create)
+{
+    auto key = std::make_pair(regionX, regionZ);
+    auto it = regions.find(key);
+    if (it != regions.end())
+        return it->second.get();
+
+    std::string path = directory + "/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".mcr";
+    bool isNew = !std::filesystem::exists(path);
+    if (!create && isNew)
+        return nullptr;
+
+    std::filesystem::create_directories(directory);
+    hasNewRegions |= isNew;
+    auto region = std::make_unique<RegionFile>(path, chunkHeight);
+    RegionFile* ptr = region.get();
+    regions.emplace(key, std::move(region));
+    return ptr;
+}
+
+size_t WorldStorage::saveChunkData(int chunkX, int chunkZ, int chunkHeight, const int* blocks,
+                                   const std::vector<PendingTick>& ticks)
+{
+    RegionFile* region = getRegion(chunkX >> 5, chunkZ >> 5, chunkHeight, true);
+    size_t volume = static_cast<size_t>(World::getColumnVolume(chunkHeight));
+    if (ticks.empty())
+        return region->writeChunk(chunkX & (RegionFile::REGION_SIZE - 1), chunkZ & (RegionFile::REGION_SIZE - 1), blocks, volume);
+
+    // Each tick follows the blocks as a cell and a delay.
+    tickBuffer.assign(blocks, blocks + volume);
+    for (const PendingTick& tick : ticks)
+    {
+        tickBuffer.push_back(static_cast<int>(tick.cell));
+        tickBuffer.push_back(static_cast<int>(tick.delay));
+    }
+    return region->writeChunk(chunkX & (RegionFile::REGION_SIZE - 1), chunkZ & (RegionFile::REGION_SIZE - 1),
+                              tickBuffer.data(), tickBuffer.size());
+}
+
+bool WorldStorage::loadChunkData(int chunkX, int chunkZ, int chunkHeight, std::vector<int>& blocks,
+                                 std::vector<PendingTick>* ticks)
+{
+    RegionFile* region = getRegion(chunkX >> 5, chunkZ >> 5, chunkHeight, false);
+    if (region == nullptr)
+        return false;
+
+    if (!region->readChunk(chunkX & (RegionFile::REGION_SIZE - 1), chunkZ & (RegionFile::REGION_SIZE - 1), blocks))
+        return false;
+
+    size_t volume = static_cast<size_t>(World::getColumnVolume(chunkHeight));
+    if (blocks.size() < volume || (blocks.size() - volume) % 2 != 0)
+        throw std::runtime_error("Chunk payload has the wrong size");
+
+    if (ticks)
+    {
+        ticks->clear();
+        for (size_t i = volume; i < blocks.size(); i += 2)
+            ticks->push_back({ static_cast<uint32_t>(blocks[i]), static_cast<uint32_t>(blocks[i + 1]) });
+    }
+    blocks.resize(volume);
+
+    lastChunkCompressed = region->getLastReadSize();
+    return true;
+}
+
+size_t WorldStorage::saveChunk(const World& world, int chunkX, int chunkZ)
+{
+    world.getChunk(chunkX, chunkZ, chunkBuffer);
+    return saveChunkData(chunkX, chunkZ, world.WORLD_Y, chunkBuffer.data());
+}
+
+bool WorldStorage::loadChunk(World& world, int chunkX, int chunkZ)
+{
+    if (!loadChunkData(chunkX, chunkZ, world.WORLD_Y, chunkBuffer))
+        return false;
+
+    world.setChunk(chunkX, chunkZ, chunkBuffer);
+    return true;
+}
+
+void WorldStorage::flush()
+{
+    for (auto& [key, region] : regions)
+        region->flush();
+
+    if (!hasNewRegions)
+        return;
+
+    int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    bool isSynced = dir >= 0 && fsync(dir) == 0;
+    if (dir >= 0)
+        ::close(dir);
+    if (!isSynced)
+        throw std::runtime_error("Could not sync save directory " + directory);
+
+    hasNewRegions = false;
+}
+
+void WorldStorage::save(const World& world)
+{
+    auto start = std::chrono::steady_clock::now();
+    lastSave = StorageStats();
+
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            lastSave.compressedBytes += saveChunk(world, cx, cz);
+            lastSave.rawBytes += world.getChunkVolume() * sizeof(int);
+            lastSave.chunks++;
+        }
+    }
+
+    flush();
+
+    lastSave.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool WorldStorage::load(World& world)
+{
+    auto start = std::chrono::steady_clock::now();
+    lastLoad = StorageStats();
+
+    for (int cz = 0; cz < world.getChunksZ(); cz++)
+    {
+        for (int cx = 0; cx < world.getChunksX(); cx++)
+        {
+            if (!loadChunk(world, cx, cz))
+                continue;
+
+            lastLoad.rawBytes += chunkBuffer.size() * sizeof(int);
+            lastLoad.compressedBytes += lastChunkCompressed;
+            lastLoad.chunks++;
+        }
+    }
+
+    lastLoad.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return lastLoad.chunks > 0;
+}
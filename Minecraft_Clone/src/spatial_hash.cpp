@@ -0,0 +1,206 @@
+#include "spatial_hash.h"
+#include <algorithm>
+#include <cmath>
+
+void SpatialHash::clear()
+{
+    std::fill(keys.begin(), keys.end(), EMPTY_KEY);
+    sorted.clear();
+    sortedBoxes.clear();
+    cellCount = 0;
+    maxOccupancy = 0;
+    averageProbes = 0.f;
+}
+
+glm::ivec3 SpatialHash::getCell(glm::vec3 point) const
+{
+    return glm::ivec3(glm::floor(point * inverseCellSize));
+}
+
+uint64_t SpatialHash::packKey(glm::ivec3 cell)
+{
+    const uint64_t mask = (1ull << KEY_BITS) - 1;
+    const int64_t bias = 1ll << (KEY_BITS - 1);
+    return ((cell.x + bias) & mask) | (((cell.y + bias) & mask) << KEY_BITS) | (((cell.z + bias) & mask) << (KEY_BITS * 2));
+}
+
+uint64_t SpatialHash::findSlot(uint64_t key, int* probes) const
+{
+    uint64_t slot = ((key * 0x9E3779B97F4A7C15ull) >> 32) & tableMask;
+    int count = 1;
+    while (keys[slot] != key && keys[slot] != EMPTY_KEY)
+    {
+        slot = (slot + 1) & tableMask;
+        count++;
+    }
+
+    if (probes)
+        *probes += count;
+    return slot;
+}
+
+void SpatialHash::build(const std::vector<Aabb>& boxes)
+{
+    clear();
+    size_t count = boxes.size();
+    if (count == 0)
+        return;
+
+    float largest = 0.f;
+    for (const Aabb& box : boxes)
+    {
+        glm::vec3 size = box.max - box.min;
+        largest = std::max(largest, std::max(size.x, std::max(size.y, size.z)));
+    }
+    cellSize = largest > 0.f ? largest : 1.f;
+    inverseCellSize = 1.f / cellSize;
+
+    // At most half full so probe runs stay short.
+    size_t capacity = 16;
+    while (capacity < count * 2)
+        capacity *= 2;
+    tableMask = capacity - 1;
+    keys.assign(capacity, EMPTY_KEY);
+    cellSizes.assign(capacity, 0);
+    cellStarts.resize(capacity);
+    boxSlots.resize(count);
+
+    int probes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = packKey(getCell((boxes[i].min + boxes[i].max) * 0.5f));
+        uint64_t slot = findSlot(key, &probes);
+        if (keys[slot] == EMPTY_KEY)
+        {
+            keys[slot] = key;
+            cellCount++;
+        }
+        cellSizes[slot]++;
+        boxSlots[i] = static_cast<uint32_t>(slot);
+    }
+    averageProbes = static_cast<float>(probes) / static_cast<float>(count);
+
+    // Each start begins at its cell's end and is counted back down while the
+    // boxes are placed, which leaves every cell in ascending index order.
+    uint32_t end = 0;
+    for (size_t slot = 0; slot < capacity; slot++)
+    {
+        end += cellSizes[slot];
+        cellStarts[slot] = end;
+        maxOccupancy = std::max(maxOccupancy, static_cast<int>(cellSizes[slot]));
+    }
+
+    sorted.resize(count);
+    sortedBoxes.resize(count);
+    for (size_t i = count; i-- > 0;)
+    {
+        uint32_t k = --cellStarts[boxSlots[i]];
+        sorted[k] = static_cast<uint32_t>(i);
+        sortedBoxes[k] = boxes[i];
+    }
+}
+
+template<typename Visit>
+void SpatialHash::forEachCandidate(const Aabb& box, Visit visit) const
+{
+    if (sorted.empty())
+        return;
+
+    // A box's centre can sit up to half the largest box outside its bounds.
+    glm::vec3 reach(cellSize * 0.5f);
+    glm::ivec3 lo = getCell(box.min - reach);
+    glm::ivec3 hi = getCell(box.max + reach);
+    glm::vec3 span = glm::vec3(hi - lo) + 1.f;
+
+    // Asking the table about more cells than there are boxes costs more than
+    // looking at every box.
+    if (span.x * span.y * span.z > static_cast<float>(sorted.size()))
+    {
+        for (uint32_t k = 0; k < sorted.size(); k++)
+            visit(k);
+        return;
+    }
+
+    for (int z = lo.z; z <= hi.z; z++)
+    {
+        for (int y = lo.y; y <= hi.y; y++)
+        {
+            for (int x = lo.x; x <= hi.x; x++)
+            {
+                uint64_t slot = findSlot(packKey(glm::ivec3(x, y, z)));
+                if (keys[slot] == EMPTY_KEY)
+                    continue;
+
+                uint32_t end = cellStarts[slot] + cellSizes[slot];
+                for (uint32_t k = cellStarts[slot]; k < end; k++)
+                    visit(k);
+            }
+        }
+    }
+}
+
+void SpatialHash::findPairs(std::vector<std::pair<uint32_t, uint32_t>>& out, size_t firstSlot, size_t lastSlot) const
+{
+    out.clear();
+    if (sorted.empty())
+        return;
+
+    auto test = [&](uint32_t a, uint32_t b) {
+        if (sortedBoxes[a].overlaps(sortedBoxes[b]))
+            out.emplace_back(std::min(sorted[a], sorted[b]), std::max(sorted[a], sorted[b]));
+    };
+
+    for (size_t slot = firstSlot; slot < lastSlot; slot++)
+    {
+        if (keys[slot] == EMPTY_KEY)
+            continue;
+
+        uint32_t first = cellStarts[slot];
+        uint32_t last = first + cellSizes[slot];
+        for (uint32_t a = first; a < last; a++)
+            for (uint32_t b = a + 1; b < last; b++)
+                test(a, b);
+
+        // Only the 13 neighbours after this cell in x, y, z order are paired
+        // with it; the other 13 pair with it from their own side.
+        glm::ivec3 cell = getCell((sortedBoxes[first].min + sortedBoxes[first].max) * 0.5f);
+        for (int dz = 0; dz <= 1; dz++)
+        {
+            for (int dy = dz == 0 ? 0 : -1; dy <= 1; dy++)
+            {
+                for (int dx = dz == 0 && dy == 0 ? 1 : -1; dx <= 1; dx++)
+                {
+                    uint64_t other = findSlot(packKey(cell + glm::ivec3(dx, dy, dz)));
+                    if (keys[other] == EMPTY_KEY)
+                        continue;
+
+                    uint32_t otherEnd = cellStarts[other] + cellSizes[other];
+                    for (uint32_t a = first; a < last; a++)
+                        for (uint32_t b = cellStarts[other]; b < otherEnd; b++)
+                            test(a, b);
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::queryAabb(const Aabb& box, std::vector<uint32_t>& out) const
+{
+    out.clear();
+    forEachCandidate(box, [&](uint32_t k) {
+        if (sortedBoxes[k].overlaps(box))
+            out.push_back(sorted[k]);
+    });
+}
+
+void SpatialHash::queryRadius(glm::vec3 centre, float radius, std::vector<uint32_t>& out) const
+{
+    out.clear();
+    Aabb bounds{ centre - glm::vec3(radius), centre + glm::vec3(radius) };
+    forEachCandidate(bounds, [&](uint32_t k) {
+        glm::vec3 nearest = glm::clamp(centre, sortedBoxes[k].min, sortedBoxes[k].max);
+        glm::vec3 d = nearest - centre;
+        if (glm::dot(d, d) <= radius * radius)
+            out.push_back(sorted[k]);
+    });
+}
@@ -0,0 +1,169 @@
+#include "upload_ring.h"
+#include <glad/glad.h>
+#include <cstring>
+#include <stdexcept>
+
+unsigned int GLUploadBackend::createBuffer(size_t size)
+{
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+    return buffer;
+}
+
+void GLUploadBackend::deleteBuffer(unsigned int buffer)
+{
+    glDeleteBuffers(1, &buffer);
+}
+
+void GLUploadBackend::orphan(unsigned int buffer, size_t size)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+}
+
+void* GLUploadBackend::map(unsigned int buffer, size_t offset, size_t size)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    return glMapBufferRange(GL_COPY_READ_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size),
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void GLUploadBackend::unmap(unsigned int buffer)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+}
+
+void GLUploadBackend::write(unsigned int buffer, size_t offset, const void* data, size_t size)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferSubData(GL_COPY_READ_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+}
+
+void GLUploadBackend::copy(unsigned int src, unsigned int dst, size_t srcOffset, size_t dstOffset, size_t size)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, src);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(srcOffset),
+                        static_cast<GLintptr>(dstOffset), static_cast<GLsizeiptr>(size));
+}
+
+void* GLUploadBackend::insertFence()
+{
+    return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GLUploadBackend::isFenceSignaled(void* fence)
+{
+    GLenum status = glClientWaitSync(static_cast<GLsync>(fence), 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void GLUploadBackend::deleteFence(void* fence)
+{
+    glDeleteSync(static_cast<GLsync>(fence));
+}
+
+UploadRing::UploadRing(UploadBackend& b, size_t segBytes, size_t budget)
+    : backend(b), segmentBytes(segBytes), frameBudget(budget)
+{
+}
+
+void UploadRing::beginFrame()
+{
+    current = (current + 1) % FRAMES;
+    cursor = 0;
+    bytesThisFrame = 0;
+
+    Segment& seg = segments[current];
+    if (seg.buffer == 0)
+    {
+        seg.buffer = backend.createBuffer(segmentBytes);
+        seg.capacity = segmentBytes;
+        return;
+    }
+
+    if (seg.fence != nullptr)
+    {
+        // Copies from FRAMES frames ago are still queued: detach the old storage
+        // instead of waiting for them.
+        if (!backend.isFenceSignaled(seg.fence))
+        {
+            backend.orphan(seg.buffer, seg.capacity);
+            orphanCount++;
+        }
+
+        backend.deleteFence(seg.fence);
+        seg.fence = nullptr;
+    }
+}
+
+void UploadRing::endFrame()
+{
+    Segment& seg = segments[current];
+    if (seg.buffer != 0 && bytesThisFrame > 0)
+        seg.fence = backend.insertFence();
+}
+
+bool UploadRing::reserve(size_t size)
+{
+    if (bytesThisFrame == 0)
+        return true;
+
+    if (bytesThisFrame + size > frameBudget || cursor + size > segments[current].capacity)
+    {
+        deferredCount++;
+        return false;
+    }
+
+    return true;
+}
+
+void UploadRing::upload(unsigned int dstBuffer, size_t dstOffset, const void* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    Segment& seg = segments[current];
+    if (cursor != 0 && cursor + size > seg.capacity)
+        throw std::runtime_error("Upload was not reserved");
+
+    if (size > seg.capacity)
+    {
+        backend.orphan(seg.buffer, size);
+        seg.capacity = size;
+    }
+
+    void* dst = backend.map(seg.buffer, cursor, size);
+    if (dst != nullptr)
+    {
+        std::memcpy(dst, data, size);
+        backend.unmap(seg.buffer);
+    }
+    else
+    {
+        backend.write(seg.buffer, cursor, data, size);
+        mapFallbackCount++;
+    }
+
+    backend.copy(seg.buffer, dstBuffer, cursor, dstOffset, size);
+
+    cursor += size;
+    bytesThisFrame += size;
+    totalBytes += size;
+}
+
+void UploadRing::release()
+{
+    for (Segment& seg : segments)
+    {
+        if (seg.fence != nullptr)
+            backend.deleteFence(seg.fence);
+        if (seg.buffer != 0)
+            backend.deleteBuffer(seg.buffer);
+
+        seg = Segment();
+    }
+}
@@ -0,0 +1,139 @@
+#include "vertex_arena.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+VertexArena::VertexArena(int cap) : capacity(cap)
+{
+    if (capacity > 0)
+        freeBlocks[0] = capacity;
+}
+
+int VertexArena::allocate(int size)
+{
+    if (size <= 0)
+        throw std::invalid_argument("Arena allocation size must be positive");
+
+    auto best = freeBlocks.end();
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+    {
+        if (it->second >= size && (best == freeBlocks.end() || it->second < best->second))
+            best = it;
+    }
+
+    if (best == freeBlocks.end())
+        return INVALID_HANDLE;
+
+    int offset = best->first;
+    int remaining = best->second - size;
+    freeBlocks.erase(best);
+    if (remaining > 0)
+        freeBlocks[offset + size] = remaining;
+
+    int handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else
+    {
+        handle = static_cast<int>(allocations.size());
+        allocations.emplace_back();
+    }
+
+    allocations[handle] = { offset, size, true };
+    used += size;
+    return handle;
+}
+
+void VertexArena::release(int handle)
+{
+    if (handle < 0 || handle >= static_cast<int>(allocations.size()) || !allocations[handle].isLive)
+        throw std::invalid_argument("Invalid arena handle");
+
+    Allocation& a = allocations[handle];
+    addFreeBlock(a.offset, a.size);
+    used -= a.size;
+    a.isLive = false;
+    freeHandles.push_back(handle);
+}
+
+void VertexArena::addFreeBlock(int offset, int size)
+{
+    auto next = freeBlocks.lower_bound(offset);
+
+    if (next != freeBlocks.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            freeBlocks.erase(prev);
+        }
+    }
+
+    if (next != freeBlocks.end() && offset + size == next->first)
+    {
+        size += next->second;
+        freeBlocks.erase(next);
+    }
+
+    freeBlocks[offset] = size;
+}
+
+std::vector<VertexArena::Move> VertexArena::defragment()
+{
+    std::vector<int> live;
+    for (int h = 0; h < static_cast<int>(allocations.size()); h++)
+        if (allocations[h].isLive)
+            live.push_back(h);
+
+    std::sort(live.begin(), live.end(), [this](int a, int b) { return allocations[a].offset < allocations[b].offset; });
+
+    std::vector<Move> moves;
+    int cursor = 0;
+    for (int h : live)
+    {
+        Allocation& a = allocations[h];
+        if (a.offset != cursor)
+        {
+            moves.push_back({ a.offset, cursor, a.size });
+            a.offset = cursor;
+        }
+        cursor += a.size;
+    }
+
+    freeBlocks.clear();
+    if (cursor < capacity)
+        freeBlocks[cursor] = capacity - cursor;
+
+    return moves;
+}
+
+void VertexArena::grow(int newCapacity)
+{
+    if (newCapacity <= capacity)
+        return;
+
+    addFreeBlock(capacity, newCapacity - capacity);
+    capacity = newCapacity;
+}
+
+int VertexArena::getLargestFreeBlock() const
+{
+    int largest = 0;
+    for (const auto& [offset, size] : freeBlocks)
+        largest = std::max(largest, size);
+    return largest;
+}
+
+float VertexArena::getFragmentation() const
+{
+    int totalFree = capacity - used;
+    if (totalFree == 0)
+        return 0.f;
+
+    return 1.f - static_cast<float>(getLargestFreeBlock()) / static_cast<float>(totalFree);
+}
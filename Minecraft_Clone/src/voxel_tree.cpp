@@ -0,0 +1,207 @@
+#include "voxel_tree.h"
+#include <stdexcept>
+
+#include "world.h"
+
+VoxelTree::VoxelTree(int sizeX, int sizeY, int sizeZ, int fill)
+    : SIZE_X(sizeX), SIZE_Y(sizeY), SIZE_Z(sizeZ), depth(3)
+{
+    int largest = std::max(sizeX, std::max(sizeY, sizeZ));
+    while (getSize() < largest)
+        depth++;
+
+    allocateNode(0);
+    if (fill == 0)
+        return;
+
+    // Only the extent is filled; the rest of the cube stays air.
+    std::vector<int> column(World::getColumnVolume(SIZE_Y), fill);
+    for (int chunkZ = 0; chunkZ * SECTION_SIZE < SIZE_Z; chunkZ++)
+        for (int chunkX = 0; chunkX * SECTION_SIZE < SIZE_X; chunkX++)
+            setChunk(chunkX, chunkZ, column);
+}
+
+uint32_t VoxelTree::allocateNode(int fill)
+{
+    uint32_t node;
+    if (!freeNodes.empty())
+    {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        node = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    nodes[node].subtrees = 0;
+    std::fill(std::begin(nodes[node].children), std::end(nodes[node].children), fill);
+    return node;
+}
+
+void VoxelTree::freeSubtree(uint32_t node)
+{
+    uint64_t subtrees = nodes[node].subtrees;
+    for (int c = 0; c < CHILDREN; c++)
+        if (subtrees & (1ull << c))
+            freeSubtree(static_cast<uint32_t>(nodes[node].children[c]));
+
+    nodes[node].subtrees = 0;
+    freeNodes.push_back(node);
+}
+
+int VoxelTree::getBlock(int x, int y, int z) const
+{
+    if (isOutOfTree(x, y, z))
+        throw std::out_of_range("Block coordinates out of bounds");
+
+    uint32_t node = 0;
+    for (int shift = 2 * (depth - 1);; shift -= 2)
+    {
+        int c = getChildIndex(x, y, z, shift);
+        if (!(nodes[node].subtrees & (1ull << c)))
+            return nodes[node].children[c];
+        node = static_cast<uint32_t>(nodes[node].children[c]);
+    }
+}
+
+void VoxelTree::setBlock(int x, int y, int z, int value)
+{
+    if (isOutOfTree(x, y, z))
+        throw std::out_of_range("Block coordinates out of bounds");
+
+    replace(glm::ivec3(x, y, z), 0, false, value);
+}
+
+void VoxelTree::replace(glm::ivec3 corner, int shift, bool isNode, int32_t child)
+{
+    // Nodes from the root down to the one holding the target cube.
+    uint32_t path[16];
+    int slots[16];
+    int length = 0;
+
+    uint32_t node = 0;
+    for (int s = 2 * (depth - 1);; s -= 2)
+    {
+        int c = getChildIndex(corner.x, corner.y, corner.z, s);
+        path[length] = node;
+        slots[length] = c;
+        length++;
+
+        bool isSubtree = nodes[node].subtrees & (1ull << c);
+        if (s == shift)
+        {
+            if (isSubtree)
+                freeSubtree(static_cast<uint32_t>(nodes[node].children[c]));
+            nodes[node].children[c] = child;
+            if (isNode)
+                nodes[node].subtrees |= 1ull << c;
+            else
+                nodes[node].subtrees &= ~(1ull << c);
+            break;
+        }
+
+        if (!isSubtree)
+        {
+            int block = nodes[node].children[c];
+            if (!isNode && block == child)
+                return;
+
+            uint32_t split = allocateNode(block);
+            nodes[node].children[c] = static_cast<int32_t>(split);
+            nodes[node].subtrees |= 1ull << c;
+        }
+        node = static_cast<uint32_t>(nodes[node].children[c]);
+    }
+
+    // A node left holding one block everywhere becomes that block in its parent.
+    for (int i = length - 1; i > 0; i--)
+    {
+        const Node& n = nodes[path[i]];
+        if (n.subtrees != 0 || std::count(std::begin(n.children), std::end(n.children), n.children[0]) != CHILDREN)
+            break;
+
+        Node& parent = nodes[path[i - 1]];
+        parent.children[slots[i - 1]] = n.children[0];
+        parent.subtrees &= ~(1ull << slots[i - 1]);
+        freeNodes.push_back(path[i]);
+    }
+}
+
+bool VoxelTree::buildFromChunk(glm::ivec3 corner, int shift, glm::ivec3 chunkCorner, const std::vector<int>& blocks, int32_t& child)
+{
+    int32_t children[CHILDREN];
+    uint64_t subtrees = 0;
+    const int edge = 1 << (shift - 2);
+
+    for (int c = 0; c < CHILDREN; c++)
+    {
+        glm::ivec3 at = corner + glm::ivec3(c & 3, (c >> 2) & 3, c >> 4) * edge;
+        if (shift == 2)
+        {
+            children[c] = isOutOfTree(at.x, at.y, at.z) ? 0 :
+                blocks[World::getColumnIndex(at.x - chunkCorner.x, at.y, at.z - chunkCorner.z, SIZE_Y)];
+        }
+        else if (buildFromChunk(at, shift - 2, chunkCorner, blocks, children[c]))
+        {
+            subtrees |= 1ull << c;
+        }
+    }
+
+    if (subtrees == 0 && std::count(children, children + CHILDREN, children[0]) == CHILDREN)
+    {
+        child = children[0];
+        return false;
+    }
+
+    uint32_t node = allocateNode(0);
+    nodes[node].subtrees = subtrees;
+    std::copy(children, children + CHILDREN, nodes[node].children);
+    child = static_cast<int32_t>(node);
+    return true;
+}
+
+void VoxelTree::setChunk(int chunkX, int chunkZ, const std::vector<int>& blocks)
+{
+    if (static_cast<int>(blocks.size()) != World::getColumnVolume(SIZE_Y))
+        throw std::invalid_argument("Chunk data has the wrong size");
+
+    glm::ivec3 chunkCorner(chunkX * SECTION_SIZE, 0, chunkZ * SECTION_SIZE);
+    for (int y = 0; y < SIZE_Y; y += SECTION_SIZE)
+    {
+        glm::ivec3 corner = chunkCorner + glm::ivec3(0, y, 0);
+        int32_t child;
+        bool isNode = buildFromChunk(corner, 4, chunkCorner, blocks, child);
+        replace(corner, 4, isNode, child);
+    }
+}
+
+void VoxelTree::getChunk(int chunkX, int chunkZ, std::vector<int>& out) const
+{
+    out.assign(World::getColumnVolume(SIZE_Y), 0);
+
+    glm::ivec3 chunkCorner(chunkX * SECTION_SIZE, 0, chunkZ * SECTION_SIZE);
+    glm::ivec3 lo = chunkCorner;
+    glm::ivec3 hi = glm::min(chunkCorner + glm::ivec3(SECTION_SIZE, SIZE_Y, SECTION_SIZE), glm::ivec3(SIZE_X, SIZE_Y, SIZE_Z)) - 1;
+    forEachInBox(lo, hi, [&](glm::ivec3 min, glm::ivec3 max, int block) {
+        if (block == 0)
+            return;
+
+        for (int z = min.z; z <= max.z; z++)
+        {
+            for (int y = min.y; y <= max.y; y++)
+            {
+                if constexpr (World::BLOCK_ORDER == ORDER_MORTON)
+                {
+                    for (int x = min.x; x <= max.x; x++)
+                        out[World::getColumnIndex(x, y, z, SIZE_Y)] = block;
+                    continue;
+                }
+
+                int* row = out.data() + World::getColumnIndex(0, y, z, SIZE_Y) - chunkCorner.x;
+                std::fill(row + min.x, row + max.x + 1, block);
+            }
+        }
+    });
+}
@@ -1,40 +1,248 @@
 #include "world.h"
+#include <algorithm>
 #include <stdexcept>
 
+#include "world_snapshot.h"
+
 World::World(int sizeX, int sizeY, int sizeZ)
-    : WORLD_X(sizeX), WORLD_Y(sizeY), WORLD_Z(sizeZ)
+    : WORLD_X(sizeX), WORLD_Y(sizeY), WORLD_Z(sizeZ),
+      chunksX((sizeX + CHUNK_SIZE - 1) / CHUNK_SIZE), columnStride(CHUNK_SIZE * sizeY)
 {
-    blocks.resize(WORLD_X * WORLD_Y * WORLD_Z, 0);
+    int chunks = getChunksX() * getChunksZ();
+    privateChunks.resize(chunks);
+    adoptedChunks.resize(chunks);
+    chunkData.resize(chunks);
+    versions.resize(chunks, 0);
+    brickMasks.resize(static_cast<size_t>(chunks) * getBricksPerChunk(), 0);
+    occupiedBricks.resize(chunks, 0);
+    tickableCounts.resize(static_cast<size_t>(chunks) * getSectionsY(), 0);
+    for (int c = 0; c < chunks; c++)
+    {
+        privateChunks[c] = std::make_shared<std::vector<int>>(getChunkVolume(), 0);
+        chunkData[c] = privateChunks[c]->data();
+    }
 
+    // Dirt with a layer of grass on top.
     for (int x = 0; x < WORLD_X; x++)
         for (int y = 0; y < WORLD_Y; y++)
             for (int z = 0; z < WORLD_Z; z++)
-                setBlock(x, y, z, 1);
+                setBlock(x, y, z, y == WORLD_Y - 1 ? BLOCK_GRASS : BLOCK_DIRT);
+}
+
+World::World(std::shared_ptr<const WorldSnapshot> snapshot)
+    : WORLD_X(snapshot->getSizeX()), WORLD_Y(snapshot->getSizeY()), WORLD_Z(snapshot->getSizeZ()),
+      chunksX((WORLD_X + CHUNK_SIZE - 1) / CHUNK_SIZE), columnStride(CHUNK_SIZE * WORLD_Y),
+      snapshot(std::move(snapshot))
+{
+    privateChunks.resize(getChunksX() * getChunksZ());
+    adoptedChunks.resize(getChunksX() * getChunksZ());
+    chunkData.resize(getChunksX() * getChunksZ());
+    versions.resize(getChunksX() * getChunksZ(), 0);
+    brickMasks.resize(static_cast<size_t>(getChunksX()) * getChunksZ() * getBricksPerChunk(), 0);
+    occupiedBricks.resize(getChunksX() * getChunksZ(), 0);
+    tickableCounts.resize(static_cast<size_t>(getChunksX()) * getChunksZ() * getSectionsY(), 0);
+    for (int cz = 0; cz < getChunksZ(); cz++)
+        for (int cx = 0; cx < getChunksX(); cx++)
+            chunkData[cx + cz * getChunksX()] = this->snapshot->getChunk(cx, cz);
+
+    // Scanning the blocks here would page in the whole file, so the masks
+    // and counts come from the snapshot when it has them.
+    const uint64_t* masks = this->snapshot->getBrickMasks();
+    if (masks == nullptr)
+    {
+        for (int chunk = 0; chunk < getChunksX() * getChunksZ(); chunk++)
+        {
+            rebuildBricks(chunk);
+            rebuildTickables(chunk);
+        }
+        return;
+    }
+
+    std::copy(masks, masks + brickMasks.size(), brickMasks.begin());
+    std::copy(this->snapshot->getTickableCounts(), this->snapshot->getTickableCounts() + tickableCounts.size(), tickableCounts.begin());
+    for (int chunk = 0; chunk < getChunksX() * getChunksZ(); chunk++)
+    {
+        const uint64_t* chunkMasks = brickMasks.data() + static_cast<size_t>(chunk) * getBricksPerChunk();
+        occupiedBricks[chunk] = static_cast<int>(std::count_if(chunkMasks, chunkMasks + getBricksPerChunk(), [](uint64_t m) { return m != 0; }));
+    }
+}
+
+int* World::getPrivateChunk(int chunk)
+{
+    auto& data = privateChunks[chunk];
+
+    // Snapshots are only taken on this thread, so a count of one means no
+    // reader can be holding the chunk.
+    if (!data || data.use_count() > 1)
+    {
+        if (data)
+            copyOnWrites++;
+
+        data = std::make_shared<std::vector<int>>(chunkData[chunk], chunkData[chunk] + getChunkVolume());
+        chunkData[chunk] = data->data();
+        adoptedChunks[chunk].reset();
+    }
+
+    versions[chunk]++;
+    return data->data();
 }
 
-int World::getIndex(int x, int y, int z) const
+int World::getPrivateChunkCount() const
 {
-    if (x < 0 || x >= WORLD_X ||
-        y < 0 || y >= WORLD_Y ||
-        z < 0 || z >= WORLD_Z)
-        throw std::out_of_range("Block coordinates out of bounds");
+    int count = 0;
+    for (const auto& data : privateChunks)
+        if (data)
+            count++;
 
-    return x + y * WORLD_X + z * WORLD_X * WORLD_Y;
+    return count;
 }
 
-bool World::isBlockSolid(int x, int y, int z) const
+ChunkSnapshot World::snapshotChunk(int chunkX, int chunkZ) const
 {
-    return blocks[getIndex(x, y, z)] != 0;
+    ChunkSnapshot result;
+    if (chunkX < 0 || chunkX >= getChunksX() || chunkZ < 0 || chunkZ >= getChunksZ())
+        return result;
+
+    int chunk = chunkX + chunkZ * getChunksX();
+    if (privateChunks[chunk])
+        result.owner = privateChunks[chunk];
+    else if (adoptedChunks[chunk])
+        result.owner = adoptedChunks[chunk];
+    else
+        result.owner = snapshot;
+
+    result.blocks = chunkData[chunk];
+    result.version = versions[chunk];
+    return result;
 }
 
 void World::setBlock(int x, int y, int z, int value)
 {
-    blocks[getIndex(x, y, z)] = value;
+    int i = getIndex(x, y, z);
+    int chunk = getChunkIndex(x, z);
+    int& block = getPrivateChunk(chunk)[i];
+    if (isTickable(block) != isTickable(value))
+        tickableCounts[chunk * getSectionsY() + y / CHUNK_SIZE] += isTickable(value) ? 1 : -1;
+
+    block = value;
+    setBrickBit(x, y, z, isSolidBlock(value));
+}
+
+void World::setBrickBit(int x, int y, int z, bool isSolid)
+{
+    uint64_t& mask = brickMasks[getBrickIndex(x, y, z)];
+    uint64_t bit = 1ull << getBrickBit(x, y, z);
+    bool wasEmpty = mask == 0;
+
+    mask = isSolid ? mask | bit : mask & ~bit;
+
+    if (wasEmpty != (mask == 0))
+        occupiedBricks[getChunkIndex(x, z)] += wasEmpty ? 1 : -1;
+}
+
+void World::rebuildBricks(int chunk, int minY, int maxY)
+{
+    uint64_t* masks = brickMasks.data() + static_cast<size_t>(chunk) * getBricksPerChunk();
+    const int across = CHUNK_SIZE / BRICK_SIZE;
+
+    // Whole brick rows, since every cell of a cleared brick is scanned again.
+    minY = minY / BRICK_SIZE * BRICK_SIZE;
+    maxY = maxY < 0 ? WORLD_Y - 1 : std::min(maxY / BRICK_SIZE * BRICK_SIZE + BRICK_SIZE - 1, WORLD_Y - 1);
+    for (int bz = 0; bz < across; bz++)
+        for (int by = minY / BRICK_SIZE; by <= maxY / BRICK_SIZE; by++)
+            for (int bx = 0; bx < across; bx++)
+                masks[bx + by * across + bz * across * getBricksY()] = 0;
+
+    const int* data = chunkData[chunk];
+    for (int z = 0; z < CHUNK_SIZE; z++)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            // A row of a brick is BRICK_SIZE consecutive bits of its mask.
+            uint64_t* brickRow = masks + (y / BRICK_SIZE) * across + (z / BRICK_SIZE) * across * getBricksY();
+            for (int bx = 0; bx < across; bx++)
+            {
+                uint64_t bits = 0;
+                for (int x = 0; x < BRICK_SIZE; x++)
+                    bits |= static_cast<uint64_t>(isSolidBlock(data[getColumnIndex(bx * BRICK_SIZE + x, y, z)])) << x;
+                brickRow[bx] |= bits << getBrickBit(0, y, z);
+            }
+        }
+    }
+
+    occupiedBricks[chunk] = static_cast<int>(std::count_if(masks, masks + getBricksPerChunk(), [](uint64_t m) { return m != 0; }));
+}
+
+void World::rebuildTickables(int chunk, int minY, int maxY)
+{
+    int* counts = tickableCounts.data() + static_cast<size_t>(chunk) * getSectionsY();
+
+    minY = minY / CHUNK_SIZE * CHUNK_SIZE;
+    maxY = maxY < 0 ? WORLD_Y - 1 : std::min(maxY / CHUNK_SIZE * CHUNK_SIZE + CHUNK_SIZE - 1, WORLD_Y - 1);
+    std::fill(counts + minY / CHUNK_SIZE, counts + maxY / CHUNK_SIZE + 1, 0);
+
+    const int* data = chunkData[chunk];
+    if constexpr (BLOCK_ORDER == ORDER_MORTON)
+    {
+        // Each section is contiguous, and its padding above the world is air.
+        for (int sectionY = minY / CHUNK_SIZE; sectionY <= maxY / CHUNK_SIZE; sectionY++)
+        {
+            const int* section = data + sectionY * Section::VOLUME;
+            counts[sectionY] = static_cast<int>(std::count_if(section, section + Section::VOLUME, isTickable));
+        }
+        return;
+    }
+
+    for (int z = 0; z < CHUNK_SIZE; z++)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            const int* row = data + getColumnIndex(0, y, z);
+            for (int x = 0; x < CHUNK_SIZE; x++)
+                counts[y / CHUNK_SIZE] += isTickable(row[x]);
+        }
+    }
+}
+
+void World::getChunk(int chunkX, int chunkZ, std::vector<int>& out) const
+{
+    const int* data = chunkData[chunkX + chunkZ * getChunksX()];
+    out.assign(data, data + getChunkVolume());
 }
 
-bool World::isOutOfWorld(int x, int y, int z) const
+void World::setChunk(int chunkX, int chunkZ, const std::vector<int>& data)
 {
-    return x < 0 || x >= WORLD_X ||
-           y < 0 || y >= WORLD_Y ||
-           z < 0 || z >= WORLD_Z;
-}
\ No newline at end of file
+    if (static_cast<int>(data.size()) != getChunkVolume())
+        throw std::invalid_argument("Chunk data has the wrong size");
+
+    int* dst = getPrivateChunk(chunkX + chunkZ * getChunksX());
+
+    for (int z = 0; z < CHUNK_SIZE; z++)
+    {
+        for (int y = 0; y < WORLD_Y; y++)
+        {
+            for (int x = 0; x < CHUNK_SIZE; x++)
+            {
+                int i = getColumnIndex(x, y, z);
+                dst[i] = isOutOfWorld(chunkX * CHUNK_SIZE + x, y, chunkZ * CHUNK_SIZE + z) ? 0 : data[i];
+            }
+        }
+    }
+
+    rebuildBricks(chunkX + chunkZ * getChunksX());
+    rebuildTickables(chunkX + chunkZ * getChunksX());
+}
+
+void World::adoptChunk(int chunkX, int chunkZ, const ChunkSnapshot& chunk)
+{
+    int i = chunkX + chunkZ * getChunksX();
+    if (!chunk.isValid() || chunk.version <= versions[i])
+        return;
+
+    adoptedChunks[i] = chunk.owner;
+    privateChunks[i].reset();
+    chunkData[i] = chunk.blocks;
+    versions[i] = chunk.version;
+    rebuildBricks(i);
+    rebuildTickables(i);
+}
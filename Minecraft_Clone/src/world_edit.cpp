@@ -0,0 +1,236 @@
+#include "world_edit.h"
+#include <algorithm>
+#include <cmath>
+
+WorldEdit::WorldEdit(World& world, EditHistory* history) : world(world), history(history)
+{
+    isTouched.resize(world.getChunksX() * world.getChunksZ(), 0);
+}
+
+void WorldEdit::touch(int chunkX, int chunkZ)
+{
+    char& isChunkTouched = isTouched[chunkX + chunkZ * world.getChunksX()];
+    if (!isChunkTouched)
+    {
+        touched.emplace_back(chunkX, chunkZ);
+        isChunkTouched = 1;
+    }
+}
+
+void WorldEdit::takeTouchedChunks(std::vector<glm::ivec2>& out)
+{
+    out = touched;
+    for (const glm::ivec2& chunk : touched)
+        isTouched[chunk.x + chunk.y * world.getChunksX()] = 0;
+    touched.clear();
+}
+
+template<typename Edit>
+void WorldEdit::editChunks(glm::ivec3 min, glm::ivec3 max, Edit edit)
+{
+    if (history != nullptr)
+        history->beginStep();
+
+    world.editChunks(min.x, min.y, min.z, max.x, max.y, max.z, [&](int* blocks, const ChunkSpan& span) {
+        touch(span.chunkX, span.chunkZ);
+        if (history == nullptr)
+        {
+            edit(blocks, span);
+            return;
+        }
+
+        before.assign(blocks, blocks + world.getChunkVolume());
+        edit(blocks, span);
+        history->recordChunk(span.chunkX, span.chunkZ, before.data(), blocks, span.minY, span.maxY);
+    });
+
+    if (history != nullptr)
+        history->endStep();
+}
+
+template<typename Edit>
+void WorldEdit::editRows(glm::ivec3 min, glm::ivec3 max, Edit edit)
+{
+    const int size = World::CHUNK_SIZE;
+    editChunks(min, max, [&](int* blocks, const ChunkSpan& span) {
+        glm::ivec3 corner(span.chunkX * size, 0, span.chunkZ * size);
+        for (int z = span.minZ; z <= span.maxZ; z++)
+        {
+            for (int y = span.minY; y <= span.maxY; y++)
+            {
+                if constexpr (World::BLOCK_ORDER == ORDER_MORTON)
+                {
+                    // Rows are scattered in Morton order, so edit a copy.
+                    int row[World::CHUNK_SIZE];
+                    for (int x = span.minX; x <= span.maxX; x++)
+                        row[x] = blocks[world.getColumnIndex(x, y, z)];
+                    edit(row, span.minX, span.maxX, corner + glm::ivec3(0, y, z));
+                    for (int x = span.minX; x <= span.maxX; x++)
+                        blocks[world.getColumnIndex(x, y, z)] = row[x];
+                    continue;
+                }
+
+                edit(blocks + world.getColumnIndex(0, y, z), span.minX, span.maxX, corner + glm::ivec3(0, y, z));
+            }
+        }
+    });
+}
+
+void WorldEdit::fill(glm::ivec3 min, glm::ivec3 max, int block)
+{
+    const int size = World::CHUNK_SIZE;
+    const int height = world.WORLD_Y;
+    editChunks(min, max, [&](int* blocks, const ChunkSpan& span) {
+        if constexpr (World::BLOCK_ORDER == ORDER_MORTON)
+        {
+            fillMorton(blocks, span, block);
+            return;
+        }
+
+        int* column = blocks + span.minY * size;
+        int rows = span.maxY - span.minY + 1;
+
+        // Rows of x follow each other up a column, and columns follow each
+        // other along z, so full-width boxes need far fewer, longer fills.
+        if (span.minX == 0 && span.maxX == size - 1)
+        {
+            if (rows == height)
+            {
+                std::fill_n(blocks + span.minZ * size * height, (span.maxZ - span.minZ + 1) * size * height, block);
+                return;
+            }
+
+            for (int z = span.minZ; z <= span.maxZ; z++)
+                std::fill_n(column + z * size * height, rows * size, block);
+            return;
+        }
+
+        for (int z = span.minZ; z <= span.maxZ; z++)
+            for (int y = 0; y < rows; y++)
+                std::fill(column + y * size + z * size * height + span.minX, column + y * size + z * size * height + span.maxX + 1, block);
+    });
+}
+
+// Sections are contiguous in Morton order, so each section the box covers
+// whole is one fill and the rest are written a cell at a time.
+void WorldEdit::fillMorton(int* blocks, const ChunkSpan& span, int block)
+{
+    const int size = World::CHUNK_SIZE;
+    const bool isFullLayer = span.minX == 0 && span.maxX == size - 1 && span.minZ == 0 && span.maxZ == size - 1;
+    for (int sectionY = span.minY / size; sectionY <= span.maxY / size; sectionY++)
+    {
+        int y0 = std::max(span.minY, sectionY * size);
+        int y1 = std::min(span.maxY, sectionY * size + size - 1);
+        if (isFullLayer && y1 - y0 == size - 1)
+        {
+            std::fill_n(blocks + world.getColumnIndex(0, y0, 0), World::Section::VOLUME, block);
+            continue;
+        }
+
+        for (int z = span.minZ; z <= span.maxZ; z++)
+            for (int y = y0; y <= y1; y++)
+                for (int x = span.minX; x <= span.maxX; x++)
+                    blocks[world.getColumnIndex(x, y, z)] = block;
+    }
+}
+
+void WorldEdit::replace(glm::ivec3 min, glm::ivec3 max, int from, int to)
+{
+    editRows(min, max, [&](int* row, int x0, int x1, glm::ivec3) {
+        std::replace(row + x0, row + x1 + 1, from, to);
+    });
+}
+
+void WorldEdit::hollow(glm::ivec3 min, glm::ivec3 max, int block)
+{
+    editRows(min, max, [&](int* row, int x0, int x1, glm::ivec3 start) {
+        bool isWall = start.y == min.y || start.y == max.y || start.z == min.z || start.z == max.z;
+        std::fill(row + x0, row + x1 + 1, isWall ? block : static_cast<int>(BLOCK_AIR));
+        if (start.x + x0 == min.x)
+            row[x0] = block;
+        if (start.x + x1 == max.x)
+            row[x1] = block;
+    });
+}
+
+void WorldEdit::fillSphere(glm::ivec3 centre, int radius, int block)
+{
+    editRows(centre - radius, centre + radius, [&](int* row, int x0, int x1, glm::ivec3 start) {
+        int dy = start.y - centre.y;
+        int dz = start.z - centre.z;
+        int left = radius * radius - dy * dy - dz * dz;
+        if (left < 0)
+            return;
+
+        int dx = static_cast<int>(std::sqrt(static_cast<double>(left)));
+        while (dx * dx > left)
+            dx--;
+        while ((dx + 1) * (dx + 1) <= left)
+            dx++;
+
+        int from = std::max(centre.x - dx - start.x, x0);
+        int to = std::min(centre.x + dx - start.x, x1);
+        if (from <= to)
+            std::fill(row + from, row + to + 1, block);
+    });
+}
+
+void WorldEdit::copy(glm::ivec3 min, glm::ivec3 max, Clipboard& out) const
+{
+    out.size = glm::max(max - min + 1, glm::ivec3(0));
+    out.blocks.assign(static_cast<size_t>(out.size.x) * out.size.y * out.size.z, BLOCK_AIR);
+
+    const int size = World::CHUNK_SIZE;
+    glm::ivec3 lo = glm::max(min, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(max, glm::ivec3(world.WORLD_X, world.WORLD_Y, world.WORLD_Z) - 1);
+    if (glm::any(glm::greaterThan(lo, hi)))
+        return;
+
+    for (int chunkZ = lo.z / size; chunkZ <= hi.z / size; chunkZ++)
+    {
+        for (int chunkX = lo.x / size; chunkX <= hi.x / size; chunkX++)
+        {
+            const int* blocks = world.getChunkBlocks(chunkX, chunkZ);
+            int x0 = std::max(lo.x, chunkX * size);
+            int x1 = std::min(hi.x, chunkX * size + size - 1);
+            for (int z = std::max(lo.z, chunkZ * size); z <= std::min(hi.z, chunkZ * size + size - 1); z++)
+            {
+                for (int y = lo.y; y <= hi.y; y++)
+                {
+                    auto target = out.blocks.begin() + (x0 - min.x) + (y - min.y) * out.size.x + (z - min.z) * out.size.x * out.size.y;
+                    if constexpr (World::BLOCK_ORDER == ORDER_MORTON)
+                    {
+                        for (int x = x0; x <= x1; x++)
+                            target[x - x0] = blocks[world.getColumnIndex(x, y, z)];
+                        continue;
+                    }
+
+                    const int* row = blocks + world.getColumnIndex(0, y, z);
+                    std::copy(row + x0 - chunkX * size, row + x1 - chunkX * size + 1, target);
+                }
+            }
+        }
+    }
+}
+
+void WorldEdit::paste(const Clipboard& clipboard, glm::ivec3 origin, bool isAirSkipped)
+{
+    if (glm::any(glm::lessThanEqual(clipboard.size, glm::ivec3(0))))
+        return;
+
+    const glm::ivec3 size = clipboard.size;
+    editRows(origin, origin + size - 1, [&](int* row, int x0, int x1, glm::ivec3 start) {
+        // The clipboard row from the cell at x0 on.
+        const int* source = clipboard.blocks.data() + (start.x + x0 - origin.x) + (start.y - origin.y) * size.x +
+                            (start.z - origin.z) * size.x * size.y;
+        if (!isAirSkipped)
+        {
+            std::copy(source, source + (x1 - x0 + 1), row + x0);
+            return;
+        }
+
+        for (int x = x0; x <= x1; x++)
+            if (source[x - x0] != BLOCK_AIR)
+                row[x] = source[x - x0];
+    });
+}
@@ -0,0 +1,141 @@
+#include "world_snapshot.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "world.h"
+
+namespace {
+    constexpr int HEADER_FIELDS = 8;
+}
+
+std::shared_ptr<const WorldSnapshot> WorldSnapshot::open(const std::string& path)
+{
+    if (!std::filesystem::exists(path))
+        return nullptr;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open world snapshot " + path);
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_BYTES)
+    {
+        ::close(fd);
+        throw std::runtime_error("Invalid world snapshot " + path);
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Could not map world snapshot " + path);
+
+    std::shared_ptr<WorldSnapshot> snapshot(new WorldSnapshot());
+    snapshot->mapping = mapping;
+    snapshot->mappedBytes = size;
+
+    const auto* header = static_cast<const uint32_t*>(mapping);
+    if (header[0] != MAGIC || header[1] != VERSION || header[5] != static_cast<uint32_t>(World::CHUNK_SIZE))
+        throw std::runtime_error("Invalid world snapshot " + path);
+    // Snapshots from before the field have zero there, which is linear order.
+    if (header[6] != static_cast<uint32_t>(World::BLOCK_ORDER))
+        throw std::runtime_error("World snapshot " + path + " was written with a different block order");
+
+    snapshot->sizeX = static_cast<int>(header[2]);
+    snapshot->sizeY = static_cast<int>(header[3]);
+    snapshot->sizeZ = static_cast<int>(header[4]);
+    snapshot->chunksX = (snapshot->sizeX + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+    snapshot->chunkVolume = World::getColumnVolume(snapshot->sizeY);
+
+    size_t chunks = static_cast<size_t>(snapshot->chunksX) * ((snapshot->sizeZ + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE);
+    size_t blockBytes = HEADER_BYTES + chunks * snapshot->chunkVolume * sizeof(int);
+    if (size < blockBytes)
+        throw std::runtime_error("World snapshot " + path + " is truncated");
+
+    // The brick size the masks were written with, zero in snapshots from
+    // before them.
+    if (header[7] != 0)
+    {
+        if (header[7] != static_cast<uint32_t>(World::BRICK_SIZE))
+            throw std::runtime_error("World snapshot " + path + " was written with a different brick size");
+
+        size_t maskCount = chunks * World::getBricksPerChunk(snapshot->sizeY);
+        size_t countCount = chunks * ((snapshot->sizeY + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE);
+        if (size < blockBytes + maskCount * sizeof(uint64_t) + countCount * sizeof(int32_t))
+            throw std::runtime_error("World snapshot " + path + " is truncated");
+
+        const char* summaries = static_cast<const char*>(mapping) + blockBytes;
+        snapshot->brickMasks = reinterpret_cast<const uint64_t*>(summaries);
+        snapshot->tickableCounts = reinterpret_cast<const int*>(summaries + maskCount * sizeof(uint64_t));
+    }
+
+    // Chunks are read in whatever order the player walks, so read-ahead only wastes I/O.
+    madvise(mapping, size, MADV_RANDOM);
+
+    return snapshot;
+}
+
+void WorldSnapshot::write(const World& world, const std::string& path)
+{
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Could not create world snapshot " + tmpPath);
+
+        std::vector<char> header(HEADER_BYTES, 0);
+        uint32_t fields[HEADER_FIELDS] = { MAGIC, VERSION,
+                                           static_cast<uint32_t>(world.WORLD_X),
+                                           static_cast<uint32_t>(world.WORLD_Y),
+                                           static_cast<uint32_t>(world.WORLD_Z),
+                                           static_cast<uint32_t>(World::CHUNK_SIZE),
+                                           static_cast<uint32_t>(World::BLOCK_ORDER),
+                                           static_cast<uint32_t>(World::BRICK_SIZE) };
+        std::memcpy(header.data(), fields, sizeof(fields));
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+        std::vector<int> chunk;
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+        {
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+            {
+                world.getChunk(cx, cz, chunk);
+                out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(int)));
+            }
+        }
+
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+                out.write(reinterpret_cast<const char*>(world.getChunkBrickMasks(cx, cz)),
+                          static_cast<std::streamsize>(world.getBricksPerChunk() * sizeof(uint64_t)));
+        for (int cz = 0; cz < world.getChunksZ(); cz++)
+            for (int cx = 0; cx < world.getChunksX(); cx++)
+                out.write(reinterpret_cast<const char*>(world.getChunkTickableCounts(cx, cz)),
+                          static_cast<std::streamsize>(world.getSectionsY() * sizeof(int32_t)));
+
+        if (!out)
+            throw std::runtime_error("Could not write world snapshot " + tmpPath);
+    }
+
+    std::filesystem::rename(tmpPath, path);
+}
+
+WorldSnapshot::~WorldSnapshot()
+{
+    if (mapping != nullptr)
+        munmap(mapping, mappedBytes);
+}
+
+const int* WorldSnapshot::getChunk(int chunkX, int chunkZ) const
+{
+    size_t index = static_cast<size_t>(chunkX) + static_cast<size_t>(chunkZ) * chunksX;
+    return reinterpret_cast<const int*>(static_cast<const char*>(mapping) + HEADER_BYTES) + index * chunkVolume;
+}